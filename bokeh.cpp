@@ -32,6 +32,25 @@
 #include <imgui/imgui.h>
 #include <bx/rng.h>
 #include <bx/os.h>
+#include <bx/thread.h>
+#include <bx/mutex.h>
+#include <bx/semaphore.h>
+#include <bx/spscqueue.h>
+#include <bx/file.h>
+#include <bx/commandline.h>
+#include <bimg/bimg.h>
+
+#include "bokeh_dof.h"
+#include "bokeh_cachesim.h"
+#include "bokeh_sequence.h"
+#include "bokeh_sweep.h"
+
+#if BX_PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif // BX_PLATFORM_POSIX
 
 
 namespace {
@@ -58,41 +77,461 @@ static const float s_meshScale[] =
 	0.30f
 };
 
-// Vertex decl for our screen space quad (used in deferred rendering)
-struct PosTexCoord0Vertex
+enum Programs
 {
-	float m_x;
-	float m_y;
-	float m_z;
-	float m_u;
-	float m_v;
+	ProgramForward = 0,
+	ProgramGrid,
+	ProgramCopy,
+	ProgramCopyLinearToGamma,
+	ProgramLinearDepth,
+	ProgramAutofocus,
+	ProgramAutofocusSum,
+
+	// batched multi-view display
+	ProgramMultiviewDisplay,
+
+	// compute programs have no fragment shader
+	ProgramMultiviewLinearDepth,
+	ProgramMultiviewDownsample,
+	ProgramMultiviewGather,
+	ProgramMultiviewCombine,
+	ProgramDepthPyramidInit,
+	ProgramDepthPyramidReduce,
+
+	ProgramCount
+};
+
+// NULL vertex shader for full screen passes, see getScreenTriangleVertexShader
+struct ProgramDesc
+{
+	const char* m_vsName;
+	const char* m_fsName;
+};
+
+static const ProgramDesc s_programs[] =
+{
+	{ "vs_bokeh_forward",			"fs_bokeh_forward"					},
+	{ "vs_bokeh_forward",			"fs_bokeh_forward_grid"				},
+	{ NULL,							"fs_bokeh_copy"						},
+	{ NULL,							"fs_bokeh_copy_linear_to_gamma"		},
+	{ NULL,							"fs_bokeh_linear_depth"				},
+	{ NULL,							"fs_bokeh_autofocus_reduce"			},
+	{ NULL,							"fs_bokeh_autofocus_sum"			},
+	{ NULL,							"fs_bokeh_multiview_display"		},
+	{ "cs_bokeh_multiview_linear_depth",	NULL						},
+	{ "cs_bokeh_multiview_downsample",		NULL						},
+	{ "cs_bokeh_multiview_gather",			NULL						},
+	{ "cs_bokeh_multiview_combine",			NULL						},
+	{ "cs_bokeh_depth_pyramid_init",		NULL						},
+	{ "cs_bokeh_depth_pyramid_reduce",		NULL						},
+};
+BX_STATIC_ASSERT(BX_COUNTOF(s_programs) == ProgramCount);
+
+#define SHADER_BUNDLE_MAGIC		BX_MAKEFOURCC('B', 'K', 'S', 'B')
+#define SHADER_BUNDLE_VERSION	1
+#define SHADER_BUNDLE_NAME_SIZE	56
+
+// File layout written by shader_bundle.sh, see makefile 'bundle' target. Index of
+// fixed size entries follows the header, then shader binaries each followed by at
+// least one zero byte, same as loadShader appends.
+struct ShaderBundleHeader
+{
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_count;
+	uint32_t m_reserved;
+};
+
+struct ShaderBundleEntry
+{
+	char m_name[SHADER_BUNDLE_NAME_SIZE];
+	uint32_t m_offset;
+	uint32_t m_size;
+};
+
+static const char* getShaderBundlePath(bgfx::RendererType::Enum _type)
+{
+	switch (_type)
+	{
+	case bgfx::RendererType::Noop:
+	case bgfx::RendererType::Direct3D9:  return "shaders/dx9/bokeh.bundle";
+	case bgfx::RendererType::Direct3D11:
+	case bgfx::RendererType::Direct3D12: return "shaders/dx11/bokeh.bundle";
+	case bgfx::RendererType::Gnm:        return "shaders/pssl/bokeh.bundle";
+	case bgfx::RendererType::Metal:      return "shaders/metal/bokeh.bundle";
+	case bgfx::RendererType::OpenGL:     return "shaders/glsl/bokeh.bundle";
+	case bgfx::RendererType::OpenGLES:   return "shaders/essl/bokeh.bundle";
+	case bgfx::RendererType::Vulkan:     return "shaders/spirv/bokeh.bundle";
+	default:                             return NULL;
+	}
+}
+
+// All compiled shaders for the current renderer in one file. Memory mapped where
+// available, otherwise read in one go. Shaders are created on first request
+// straight from bundle bytes with bgfx::makeRef, so the bundle has to stay open
+// until bgfx::shutdown returned.
+class ShaderBundle
+{
+public:
+	ShaderBundle()
+		: m_data(NULL)
+		, m_size(0)
+		, m_mapped(false)
+		, m_entries(NULL)
+		, m_shaders(NULL)
+		, m_count(0)
+	{
+	}
+
+	bool open(const char* _filePath)
+	{
+		if (NULL == _filePath)
+		{
+			return false;
+		}
+
+#if BX_PLATFORM_POSIX
+		const int fd = ::open(_filePath, O_RDONLY);
+		if (0 <= fd)
+		{
+			struct stat fileStat;
+			if (0 == fstat(fd, &fileStat)
+			&&  0 < fileStat.st_size)
+			{
+				void* data = mmap(NULL, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (MAP_FAILED != data)
+				{
+					m_data = (uint8_t*)data;
+					m_size = uint32_t(fileStat.st_size);
+					m_mapped = true;
+				}
+			}
+			::close(fd);
+		}
+#endif // BX_PLATFORM_POSIX
+
+		if (NULL == m_data)
+		{
+			m_data = (uint8_t*)load(_filePath, &m_size);
+		}
+
+		if (NULL == m_data)
+		{
+			return false;
+		}
+
+		const ShaderBundleHeader* header = (const ShaderBundleHeader*)m_data;
+		if (m_size < sizeof(ShaderBundleHeader)
+		||  SHADER_BUNDLE_MAGIC != header->m_magic
+		||  SHADER_BUNDLE_VERSION != header->m_version
+		||  m_size < sizeof(ShaderBundleHeader) + header->m_count * sizeof(ShaderBundleEntry) )
+		{
+			DBG("Shader bundle %s is invalid, ignoring it.", _filePath);
+			close();
+			return false;
+		}
+
+		m_entries = (const ShaderBundleEntry*)(m_data + sizeof(ShaderBundleHeader) );
+		m_count = header->m_count;
+
+		m_shaders = (bgfx::ShaderHandle*)BX_ALLOC(entry::getAllocator(), m_count * sizeof(bgfx::ShaderHandle) );
+		for (uint32_t ii = 0; ii < m_count; ++ii)
+		{
+			m_shaders[ii].idx = bgfx::kInvalidHandle;
+		}
+
+		return true;
+	}
+
+	// call before bgfx::shutdown
+	void destroyShaders()
+	{
+		for (uint32_t ii = 0; ii < m_count; ++ii)
+		{
+			if (bgfx::isValid(m_shaders[ii]) )
+			{
+				bgfx::destroy(m_shaders[ii]);
+				m_shaders[ii].idx = bgfx::kInvalidHandle;
+			}
+		}
+	}
+
+	// call after bgfx::shutdown, renderer may read shader bytes until then
+	void close()
+	{
+		if (NULL != m_shaders)
+		{
+			BX_FREE(entry::getAllocator(), m_shaders);
+			m_shaders = NULL;
+		}
+
+		if (NULL != m_data)
+		{
+#if BX_PLATFORM_POSIX
+			if (m_mapped)
+			{
+				munmap(m_data, m_size);
+			}
+			else
+#endif // BX_PLATFORM_POSIX
+			{
+				unload(m_data);
+			}
+		}
+
+		m_data = NULL;
+		m_size = 0;
+		m_mapped = false;
+		m_entries = NULL;
+		m_count = 0;
+	}
+
+	bool isOpen() const
+	{
+		return NULL != m_data;
+	}
+
+	bool isMapped() const
+	{
+		return m_mapped;
+	}
+
+	uint32_t getCount() const
+	{
+		return m_count;
+	}
+
+	// shaders are shared between programs and stay alive until destroyShaders()
+	bgfx::ShaderHandle getShader(const char* _name)
+	{
+		for (uint32_t ii = 0; ii < m_count; ++ii)
+		{
+			const ShaderBundleEntry& bundleEntry = m_entries[ii];
+			if (0 != bx::strCmp(bundleEntry.m_name, _name, SHADER_BUNDLE_NAME_SIZE) )
+			{
+				continue;
+			}
+
+			if (!bgfx::isValid(m_shaders[ii])
+			&&  uint64_t(bundleEntry.m_offset) + bundleEntry.m_size + 1 <= m_size)
+			{
+				m_shaders[ii] = bgfx::createShader(bgfx::makeRef(m_data + bundleEntry.m_offset, bundleEntry.m_size + 1) );
+				bgfx::setName(m_shaders[ii], _name);
+			}
+
+			return m_shaders[ii];
+		}
+
+		bgfx::ShaderHandle invalid = BGFX_INVALID_HANDLE;
+		return invalid;
+	}
+
+private:
+	uint8_t* m_data;
+	uint32_t m_size;
+	bool m_mapped;
+	const ShaderBundleEntry* m_entries;
+	bgfx::ShaderHandle* m_shaders;
+	uint32_t m_count;
+};
+
+// Programs are created on first use. Shaders come from the bundle when one is
+// open and contains them, otherwise from separate files through loadProgram.
+class ProgramCache
+{
+public:
+	void init(ShaderBundle* _bundle)
+	{
+		m_bundle = _bundle;
+		m_loadTimeMs = 0.0f;
+		m_loadedCount = 0;
+		for (uint32_t ii = 0; ii < ProgramCount; ++ii)
+		{
+			m_programs[ii].idx = bgfx::kInvalidHandle;
+		}
+	}
+
+	void destroy()
+	{
+		for (uint32_t ii = 0; ii < ProgramCount; ++ii)
+		{
+			if (bgfx::isValid(m_programs[ii]) )
+			{
+				bgfx::destroy(m_programs[ii]);
+				m_programs[ii].idx = bgfx::kInvalidHandle;
+			}
+		}
+	}
+
+	bgfx::ProgramHandle get(Programs _program)
+	{
+		bgfx::ProgramHandle& program = m_programs[_program];
+		if (!bgfx::isValid(program) )
+		{
+			const ProgramDesc& desc = s_programs[_program];
+			const char* vsName = NULL != desc.m_vsName
+				? desc.m_vsName
+				: getScreenTriangleVertexShader()
+				;
+			program = create(vsName, desc.m_fsName);
+		}
+
+		return program;
+	}
+
+	// uncached, caller owns the program. NULL fragment shader for compute
+	bgfx::ProgramHandle create(const char* _vsName, const char* _fsName)
+	{
+		const int64_t start = bx::getHPCounter();
+		bgfx::ProgramHandle program = BGFX_INVALID_HANDLE;
+
+		if (m_bundle->isOpen() )
+		{
+			bgfx::ShaderHandle vsh = m_bundle->getShader(_vsName);
+			bgfx::ShaderHandle fsh = BGFX_INVALID_HANDLE;
+			if (NULL != _fsName)
+			{
+				fsh = m_bundle->getShader(_fsName);
+			}
+
+			if (bgfx::isValid(vsh)
+			&&  (NULL == _fsName || bgfx::isValid(fsh) ) )
+			{
+				// bundle owns shaders, don't destroy them with program
+				program = NULL == _fsName
+					? bgfx::createProgram(vsh, false)
+					: bgfx::createProgram(vsh, fsh, false)
+					;
+			}
+		}
+
+		if (!bgfx::isValid(program) )
+		{
+			program = loadProgram(_vsName, _fsName);
+		}
 
-	static void init()
+		m_loadTimeMs += float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+		++m_loadedCount;
+		return program;
+	}
+
+	// BokehDofLoadProgramFn, lets the dof component share the bundle
+	static bgfx::ProgramHandle loadDofProgram(const char* _vsName, const char* _fsName, void* _userData)
+	{
+		return ( (ProgramCache*)_userData)->create(_vsName, _fsName);
+	}
+
+	float getLoadTimeMs() const
+	{
+		return m_loadTimeMs;
+	}
+
+	uint32_t getLoadedCount() const
 	{
-		ms_layout
-			.begin()
-			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
-			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
-			.end();
+		return m_loadedCount;
+	}
+
+private:
+	ShaderBundle* m_bundle;
+	bgfx::ProgramHandle m_programs[ProgramCount];
+	float m_loadTimeMs;
+	uint32_t m_loadedCount;
+};
+
+struct ModelUniforms
+{
+	enum { NumVec4 = 2 };
+
+	void init() {
+		u_params = bgfx::createUniform("u_modelParams", bgfx::UniformType::Vec4, NumVec4);
+	};
+
+	void submit() const {
+		bgfx::setUniform(u_params, m_params, NumVec4);
+	};
+
+	void destroy() {
+		bgfx::destroy(u_params);
 	}
 
-	static bgfx::VertexLayout ms_layout;
+	union
+	{
+		struct
+		{
+			/* 0 */ struct { float m_color[3]; float m_unused0; };
+			/* 1 */ struct { float m_lightPosition[3]; float m_unused1; };
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	bgfx::UniformHandle u_params;
 };
 
-bgfx::VertexLayout PosTexCoord0Vertex::ms_layout;
+// same as bokeh_autofocus.sh
+#define AUTOFOCUS_GRID_SIZE		8
+#define AUTOFOCUS_MAX_POINTS	8
+#define AUTOFOCUS_REDUCE_BLOCK	8
+#define READBACK_RING_SIZE		4
+
+struct AutofocusMode
+{
+	enum Enum
+	{
+		Manual,
+		Region,
+		Points,
+
+		Count
+	};
+};
 
-struct PassUniforms
+struct AutofocusUniforms
 {
-	enum { NumVec4 = 4 };
+	enum { NumVec4 = 3 + AUTOFOCUS_MAX_POINTS };
 
 	void init() {
-		u_params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4, NumVec4);
+		u_params = bgfx::createUniform("u_autofocusParams", bgfx::UniformType::Vec4, NumVec4);
 	};
 
 	void submit() const {
 		bgfx::setUniform(u_params, m_params, NumVec4);
+	};
+
+	void destroy() {
+		bgfx::destroy(u_params);
 	}
 
+	union
+	{
+		struct
+		{
+			/* 0    */ struct { float m_regionCenter[2]; float m_regionExtent[2]; };
+			/* 1    */ struct { float m_mode; float m_pointCount; float m_regionFalloff; float m_unused0; };
+			/* 2    */ struct { float m_reduceSourceSize[2]; float m_reduceOutputSize[2]; };
+			/* 3-10 */ struct { float m_points[AUTOFOCUS_MAX_POINTS][4]; }; // uv, radius, weight
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	bgfx::UniformHandle u_params;
+};
+
+#define MULTIVIEW_MAX_LAYERS	8
+
+struct MultiviewUniforms
+{
+	enum { NumVec4 = 1 + MULTIVIEW_MAX_LAYERS };
+
+	void init() {
+		u_params = bgfx::createUniform("u_multiviewParams", bgfx::UniformType::Vec4, NumVec4);
+	};
+
+	void submit() const {
+		bgfx::setUniform(u_params, m_params, NumVec4);
+	};
+
 	void destroy() {
 		bgfx::destroy(u_params);
 	}
@@ -101,10 +540,8 @@ struct PassUniforms
 	{
 		struct
 		{
-			/* 0    */ struct { float m_depthUnpackConsts[2]; float m_frameIdx; float m_lobeRotation; };
-			/* 1    */ struct { float m_ndcToViewMul[2]; float m_ndcToViewAdd[2]; };
-			/* 2    */ struct { float m_blurSteps; float m_lobeCount; float m_lobeRadiusMin; float m_lobeRadiusDelta2x; };
-			/* 3    */ struct { float m_maxBlurSize; float m_focusPoint; float m_focusScale; float m_radiusScale; };
+			/* 0   */ struct { float m_firstLayer; float m_layerCount; float m_gridColumns; float m_gridRows; };
+			/* 1-8 */ struct { float m_layers[MULTIVIEW_MAX_LAYERS][4]; }; // focus point, focus scale, unused
 		};
 
 		float m_params[NumVec4 * 4];
@@ -113,108 +550,1715 @@ struct PassUniforms
 	bgfx::UniformHandle u_params;
 };
 
-struct ModelUniforms
-{
-	enum { NumVec4 = 2 };
+struct RenderTarget
+{
+	void init(uint32_t _width, uint32_t _height, bgfx::TextureFormat::Enum _format, uint64_t _flags)
+	{
+		m_texture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, _format, _flags);
+		const bool destroyTextures = true;
+		m_buffer = bgfx::createFrameBuffer(1, &m_texture, destroyTextures);
+	}
+
+	void destroy()
+	{
+		// also responsible for destroying texture
+		bgfx::destroy(m_buffer);
+	}
+
+	bgfx::TextureHandle m_texture;
+	bgfx::FrameBufferHandle m_buffer;
+};
+
+// Ring of read back textures. Gpu results are copied into the next free slot and
+// picked up several frames later, so reading back never waits on bgfx::frame().
+struct ReadbackRing
+{
+	void init(uint16_t _width, uint16_t _height, bgfx::TextureFormat::Enum _format, uint32_t _bytesPerPixel)
+	{
+		m_width = _width;
+		m_height = _height;
+		m_next = 0;
+
+		const uint64_t readbackFlags = 0
+			| BGFX_TEXTURE_BLIT_DST
+			| BGFX_TEXTURE_READ_BACK
+			| BGFX_SAMPLER_POINT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+
+		for (uint32_t ii = 0; ii < READBACK_RING_SIZE; ++ii)
+		{
+			m_textures[ii] = bgfx::createTexture2D(_width, _height, false, 1, _format, readbackFlags);
+			m_data[ii] = BX_ALLOC(entry::getAllocator(), _width * _height * _bytesPerPixel);
+			m_readyFrame[ii] = 0;
+			m_pending[ii] = false;
+		}
+	}
+
+	void destroy()
+	{
+		for (uint32_t ii = 0; ii < READBACK_RING_SIZE; ++ii)
+		{
+			bgfx::destroy(m_textures[ii]);
+			BX_FREE(entry::getAllocator(), m_data[ii]);
+		}
+	}
+
+	bool canRequest() const
+	{
+		return !m_pending[m_next];
+	}
+
+	// copy mip of source into next slot and queue read back, false if every slot is
+	// still in flight. slot taken is m_next before the call
+	bool request(bgfx::ViewId _view, bgfx::TextureHandle _source, uint8_t _mip = 0)
+	{
+		const uint32_t slot = m_next;
+		if (m_pending[slot])
+		{
+			return false;
+		}
+
+		bgfx::blit(_view, m_textures[slot], 0, 0, 0, 0, _source, _mip, 0, 0, 0, m_width, m_height, 1);
+		m_readyFrame[slot] = bgfx::readTexture(m_textures[slot], m_data[slot]);
+		m_pending[slot] = true;
+		m_next = (slot + 1) % READBACK_RING_SIZE;
+		return true;
+	}
+
+	// newest result that landed by _currFrame, NULL if nothing new. valid until the
+	// slot comes around again in request()
+	const void* poll(uint32_t _currFrame, uint32_t* _slot = NULL)
+	{
+		const void* result = NULL;
+
+		// walk from oldest to newest
+		for (uint32_t ii = 0; ii < READBACK_RING_SIZE; ++ii)
+		{
+			const uint32_t slot = (m_next + ii) % READBACK_RING_SIZE;
+			if (m_pending[slot]
+			&&  m_readyFrame[slot] <= _currFrame)
+			{
+				m_pending[slot] = false;
+				result = m_data[slot];
+				if (NULL != _slot)
+				{
+					*_slot = slot;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	bgfx::TextureHandle m_textures[READBACK_RING_SIZE];
+	void* m_data[READBACK_RING_SIZE];
+	uint32_t m_readyFrame[READBACK_RING_SIZE];
+	bool m_pending[READBACK_RING_SIZE];
+	uint32_t m_next;
+	uint16_t m_width;
+	uint16_t m_height;
+};
+
+// Critically damped spring toward _target, from Game Programming Gems 4, chapter 1.10
+float smoothCriticallyDamped(float _current, float _target, float* _velocity, float _smoothTime, float _deltaTime)
+{
+	const float omega = 2.0f / bx::max(_smoothTime, 0.0001f);
+	const float xx = omega * _deltaTime;
+	const float decay = 1.0f / (1.0f + xx + 0.48f*xx*xx + 0.235f*xx*xx*xx);
+	const float change = _current - _target;
+	const float temp = (*_velocity + omega * change) * _deltaTime;
+	*_velocity = (*_velocity - omega * temp) * decay;
+	return _target + (change + temp) * decay;
+}
+
+#define CAPTURE_READBACK_COUNT	3
+#define CAPTURE_BUFFER_COUNT	6
+
+struct CaptureFormat
+{
+	enum Enum
+	{
+		Png,
+		Raw,
+		Exr,
+
+		Count
+	};
+};
+
+// Frame capture that never stalls the main loop. The final image is blitted into a
+// rotating pool of read back textures, each tagged with the frame bgfx::readTexture
+// says its data lands on. Landed buffers are handed to a worker thread that encodes
+// and writes them. Memory is bounded by a fixed set of cpu buffers, when none is
+// free the capture is dropped and counted instead of waiting.
+class FrameCapture
+{
+public:
+	FrameCapture()
+		: m_width(0)
+		, m_height(0)
+		, m_yflip(false)
+		, m_initialized(false)
+	{
+	}
+
+	void init(uint16_t _width, uint16_t _height, bool _yflip)
+	{
+		m_width = _width;
+		m_height = _height;
+		m_yflip = _yflip;
+		m_nextSlot = 0;
+		m_jobRead = 0;
+		m_jobWrite = 0;
+		m_quit = false;
+		m_requested = 0;
+		m_dropped = 0;
+		m_written = 0;
+		m_failed = 0;
+		m_encodeTimeMs = 0.0f;
+
+		const uint64_t readbackFlags = 0
+			| BGFX_TEXTURE_BLIT_DST
+			| BGFX_TEXTURE_READ_BACK
+			| BGFX_SAMPLER_POINT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+
+		for (uint32_t ii = 0; ii < CAPTURE_READBACK_COUNT; ++ii)
+		{
+			Slot& slot = m_slots[ii];
+			slot.m_texture = bgfx::createTexture2D(_width, _height, false, 1, bgfx::TextureFormat::RGBA8, readbackFlags);
+			slot.m_buffer = -1;
+			slot.m_pending = false;
+		}
+
+		for (uint32_t ii = 0; ii < CAPTURE_BUFFER_COUNT; ++ii)
+		{
+			m_buffers[ii] = BX_ALLOC(entry::getAllocator(), getBufferSize() );
+			m_bufferFree[ii] = true;
+		}
+
+		// half float rgba scratch for exr, only touched by worker
+		m_exrScratch = (uint16_t*)BX_ALLOC(entry::getAllocator(), _width * _height * 4 * sizeof(uint16_t) );
+
+		m_thread.init(workerFunc, this, 0, "capture encoder");
+		m_initialized = true;
+	}
+
+	// stops worker once it drained queued captures and destroys read back textures.
+	// gpu may still write landing read backs until bgfx::shutdown, see releaseMemory()
+	void shutdown()
+	{
+		if (!m_initialized)
+		{
+			return;
+		}
+
+		{
+			bx::MutexScope lock(m_mutex);
+			m_quit = true;
+		}
+		m_jobSemaphore.post();
+		m_thread.shutdown();
+
+		for (uint32_t ii = 0; ii < CAPTURE_READBACK_COUNT; ++ii)
+		{
+			bgfx::destroy(m_slots[ii].m_texture);
+		}
+
+		m_initialized = false;
+	}
+
+	void releaseMemory()
+	{
+		for (uint32_t ii = 0; ii < CAPTURE_BUFFER_COUNT; ++ii)
+		{
+			if (NULL != m_buffers[ii])
+			{
+				BX_FREE(entry::getAllocator(), m_buffers[ii]);
+				m_buffers[ii] = NULL;
+			}
+		}
+
+		if (NULL != m_exrScratch)
+		{
+			BX_FREE(entry::getAllocator(), m_exrScratch);
+			m_exrScratch = NULL;
+		}
+	}
+
+	// nothing in flight on gpu and worker holds no buffers, safe to shutdown and init again
+	bool isIdle()
+	{
+		for (uint32_t ii = 0; ii < CAPTURE_READBACK_COUNT; ++ii)
+		{
+			if (m_slots[ii].m_pending)
+			{
+				return false;
+			}
+		}
+
+		bx::MutexScope lock(m_mutex);
+		for (uint32_t ii = 0; ii < CAPTURE_BUFFER_COUNT; ++ii)
+		{
+			if (!m_bufferFree[ii])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// main thread, copy _source in _view and queue read back. never waits
+	void request(bgfx::ViewId _view, bgfx::TextureHandle _source, CaptureFormat::Enum _format)
+	{
+		const uint32_t index = m_requested++;
+
+		Slot& slot = m_slots[m_nextSlot];
+		const int32_t buffer = slot.m_pending ? -1 : acquireBuffer();
+		if (0 > buffer)
+		{
+			++m_dropped;
+			return;
+		}
+
+		bgfx::blit(_view, slot.m_texture, 0, 0, _source, 0, 0, m_width, m_height);
+		slot.m_readyFrame = bgfx::readTexture(slot.m_texture, m_buffers[buffer]);
+		slot.m_buffer = buffer;
+		slot.m_index = index;
+		slot.m_format = _format;
+		slot.m_pending = true;
+		m_nextSlot = (m_nextSlot + 1) % CAPTURE_READBACK_COUNT;
+	}
+
+	// main thread, hand buffers whose frame fence passed to the worker
+	void update(uint32_t _currFrame)
+	{
+		for (uint32_t ii = 0; ii < CAPTURE_READBACK_COUNT; ++ii)
+		{
+			Slot& slot = m_slots[ii];
+			if (!slot.m_pending
+			||  _currFrame < slot.m_readyFrame)
+			{
+				continue;
+			}
+
+			{
+				bx::MutexScope lock(m_mutex);
+				Job& job = m_jobs[m_jobWrite % CAPTURE_BUFFER_COUNT];
+				job.m_buffer = slot.m_buffer;
+				job.m_index = slot.m_index;
+				job.m_format = slot.m_format;
+				++m_jobWrite;
+			}
+			m_jobSemaphore.post();
+
+			slot.m_pending = false;
+			slot.m_buffer = -1;
+		}
+	}
+
+	uint32_t getBufferSize() const
+	{
+		return uint32_t(m_width) * uint32_t(m_height) * 4;
+	}
+
+	uint32_t getRequested() const { return m_requested; }
+	uint32_t getDropped() const { return m_dropped; }
+
+	uint32_t getWritten()
+	{
+		bx::MutexScope lock(m_mutex);
+		return m_written;
+	}
+
+	uint32_t getFailed()
+	{
+		bx::MutexScope lock(m_mutex);
+		return m_failed;
+	}
+
+	float getEncodeTimeMs()
+	{
+		bx::MutexScope lock(m_mutex);
+		return m_encodeTimeMs;
+	}
+
+	bool isInitialized() const { return m_initialized; }
+	uint16_t getWidth() const { return m_width; }
+	uint16_t getHeight() const { return m_height; }
+
+private:
+	struct Slot
+	{
+		bgfx::TextureHandle m_texture;
+		int32_t m_buffer;
+		uint32_t m_readyFrame;
+		uint32_t m_index;
+		CaptureFormat::Enum m_format;
+		bool m_pending;
+	};
+
+	struct Job
+	{
+		int32_t m_buffer;
+		uint32_t m_index;
+		CaptureFormat::Enum m_format;
+	};
+
+	int32_t acquireBuffer()
+	{
+		bx::MutexScope lock(m_mutex);
+		for (int32_t ii = 0; ii < CAPTURE_BUFFER_COUNT; ++ii)
+		{
+			if (m_bufferFree[ii])
+			{
+				m_bufferFree[ii] = false;
+				return ii;
+			}
+		}
+
+		return -1;
+	}
+
+	static int32_t workerFunc(bx::Thread* _thread, void* _userData)
+	{
+		BX_UNUSED(_thread);
+		return ((FrameCapture*)_userData)->work();
+	}
+
+	int32_t work()
+	{
+		for (;;)
+		{
+			m_jobSemaphore.wait();
+
+			Job job;
+			{
+				bx::MutexScope lock(m_mutex);
+				if (m_jobRead == m_jobWrite)
+				{
+					// woken without work only to quit, queue is drained
+					if (m_quit)
+					{
+						break;
+					}
+					continue;
+				}
+
+				job = m_jobs[m_jobRead % CAPTURE_BUFFER_COUNT];
+				++m_jobRead;
+			}
+
+			const int64_t start = bx::getHPCounter();
+			const bool written = writeCapture(job);
+			const float encodeTimeMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+
+			{
+				bx::MutexScope lock(m_mutex);
+				m_bufferFree[job.m_buffer] = true;
+				m_written += written ? 1 : 0;
+				m_failed += written ? 0 : 1;
+				m_encodeTimeMs = bx::lerp(m_encodeTimeMs, encodeTimeMs, 0.1f);
+			}
+		}
+
+		return 0;
+	}
+
+	bool writeCapture(const Job& _job)
+	{
+		static const char* s_extension[CaptureFormat::Count] = { "png", "rgba", "exr" };
+
+		char filePath[256];
+		bx::snprintf(filePath, sizeof(filePath), "bokeh_capture_%05u_%ux%u.%s"
+			, _job.m_index
+			, m_width
+			, m_height
+			, s_extension[_job.m_format]
+			);
+
+		bx::FileWriter writer;
+		bx::Error err;
+		if (!bx::open(&writer, filePath, false, &err) )
+		{
+			return false;
+		}
+
+		const uint8_t* data = (const uint8_t*)m_buffers[_job.m_buffer];
+		const uint32_t pitch = uint32_t(m_width) * 4;
+
+		switch (_job.m_format)
+		{
+		case CaptureFormat::Png:
+			bimg::imageWritePng(&writer, m_width, m_height, pitch, data, bimg::TextureFormat::RGBA8, m_yflip, &err);
+			break;
+
+		case CaptureFormat::Raw:
+			// rows top to bottom, 8 bits per channel rgba
+			for (uint32_t yy = 0; yy < m_height; ++yy)
+			{
+				const uint32_t row = m_yflip ? m_height - 1 - yy : yy;
+				bx::write(&writer, data + row * pitch, int32_t(pitch), &err);
+			}
+			break;
+
+		case CaptureFormat::Exr:
+			{
+				// back to linear half float, final image was converted to gamma for display
+				const uint32_t numChannels = uint32_t(m_width) * uint32_t(m_height) * 4;
+				for (uint32_t ii = 0; ii < numChannels; ++ii)
+				{
+					const float value = float(data[ii]) / 255.0f;
+					const bool isAlpha = 3 == (ii & 3);
+					m_exrScratch[ii] = bx::halfFromFloat(isAlpha ? value : bx::pow(value, 2.2f) );
+				}
+
+				bimg::imageWriteExr(&writer, m_width, m_height, pitch * 2, m_exrScratch, bimg::TextureFormat::RGBA16F, m_yflip, &err);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		bx::close(&writer);
+		return err.isOk();
+	}
+
+	Slot m_slots[CAPTURE_READBACK_COUNT];
+	void* m_buffers[CAPTURE_BUFFER_COUNT] = {};
+	bool m_bufferFree[CAPTURE_BUFFER_COUNT];
+	Job m_jobs[CAPTURE_BUFFER_COUNT];
+	uint16_t* m_exrScratch = NULL;
+
+	bx::Thread m_thread;
+	bx::Mutex m_mutex;
+	bx::Semaphore m_jobSemaphore;
+
+	uint16_t m_width;
+	uint16_t m_height;
+	bool m_yflip;
+	bool m_initialized;
+	bool m_quit;
+	uint32_t m_nextSlot;
+	uint32_t m_jobRead;
+	uint32_t m_jobWrite;
+
+	// main thread only
+	uint32_t m_requested;
+	uint32_t m_dropped;
+
+	// guarded by m_mutex
+	uint32_t m_written;
+	uint32_t m_failed;
+	float m_encodeTimeMs;
+};
+
+#define ASSET_LOADER_WORKER_COUNT	2
+#define ASSET_LOADER_MAX_ASSETS		8
+
+struct AssetType
+{
+	enum Enum
+	{
+		Mesh,
+		Texture,
+		Quit,
+	};
+};
+
+struct AssetState
+{
+	enum Enum
+	{
+		Loading,
+		Ready,
+		Failed,
+	};
+};
+
+// Resolves paths the same way as the entry file reader, which prepends the current
+// dir it was given. Entry keeps that dir private and its reader is used by the main
+// thread, so each worker owns one of these with the dir the app also gave entry.
+class AssetFileReader : public bx::FileReader
+{
+	typedef bx::FileReader super;
+
+public:
+	AssetFileReader()
+		: m_currentDir("")
+	{
+	}
+
+	virtual bool open(const bx::FilePath& _filePath, bx::Error* _err) override
+	{
+		char filePath[bx::kMaxFilePath];
+		bx::strCopy(filePath, BX_COUNTOF(filePath), m_currentDir);
+		bx::strCat(filePath, BX_COUNTOF(filePath), _filePath.getCPtr() );
+		return super::open(filePath, _err);
+	}
+
+	const char* m_currentDir;
+};
+
+// Loads meshes and textures without blocking the main loop. Workers read files and
+// parse textures, each worker gets jobs round robin and hands results back through
+// its own lock-free single producer single consumer queue. Only the main thread
+// calls bgfx, so gpu resources are created in update(). Meshes are parsed there
+// too, meshLoad creates vertex and index buffers while reading.
+class AssetLoader
+{
+public:
+	AssetLoader()
+		: m_assetCount(0)
+		, m_nextWorker(0)
+		, m_initialized(false)
+	{
+	}
+
+	// current dir must match entry::setCurrentDir, paths are relative to it
+	void init(const char* _currentDir)
+	{
+		m_assetCount = 0;
+		m_nextWorker = 0;
+		m_startTime = bx::getHPCounter();
+		m_allReadyMs = 0.0f;
+		bx::strCopy(m_currentDir, BX_COUNTOF(m_currentDir), _currentDir);
+
+		for (uint32_t ii = 0; ii < ASSET_LOADER_WORKER_COUNT; ++ii)
+		{
+			Worker& worker = m_workers[ii];
+			worker.m_reader.m_currentDir = m_currentDir;
+			worker.m_quit.m_type = AssetType::Quit;
+			worker.m_thread.init(workerFunc, &worker, 0, "asset loader");
+		}
+
+		m_initialized = true;
+	}
+
+	void shutdown()
+	{
+		if (!m_initialized)
+		{
+			return;
+		}
+
+		for (uint32_t ii = 0; ii < ASSET_LOADER_WORKER_COUNT; ++ii)
+		{
+			Worker& worker = m_workers[ii];
+			worker.m_jobs.push(&worker.m_quit);
+			worker.m_thread.shutdown();
+		}
+
+		// workers are gone, finish whatever they handed back so it gets released below
+		update();
+
+		for (uint32_t ii = 0; ii < m_assetCount; ++ii)
+		{
+			Asset& asset = m_assets[ii];
+			if (NULL != asset.m_mesh)
+			{
+				meshUnload(asset.m_mesh);
+				asset.m_mesh = NULL;
+			}
+
+			if (bgfx::isValid(asset.m_texture) )
+			{
+				bgfx::destroy(asset.m_texture);
+				asset.m_texture.idx = bgfx::kInvalidHandle;
+			}
+		}
+
+		m_initialized = false;
+	}
+
+	uint32_t requestMesh(const char* _filePath)
+	{
+		return request(AssetType::Mesh, _filePath, 0);
+	}
+
+	uint32_t requestTexture(const char* _filePath, uint64_t _flags = BGFX_TEXTURE_NONE | BGFX_SAMPLER_NONE)
+	{
+		return request(AssetType::Texture, _filePath, _flags);
+	}
+
+	// create gpu resources for everything workers finished since last call
+	void update()
+	{
+		for (uint32_t ii = 0; ii < ASSET_LOADER_WORKER_COUNT; ++ii)
+		{
+			Asset* asset;
+			while (NULL != (asset = m_workers[ii].m_results.pop() ) )
+			{
+				finish(*asset);
+			}
+		}
+
+		if (0.0f == m_allReadyMs
+		&&  0 < m_assetCount
+		&&  isIdle() )
+		{
+			m_allReadyMs = float(getElapsedMs(m_startTime) );
+			DBG("All %u assets loaded after %.1f ms.", m_assetCount, m_allReadyMs);
+		}
+	}
+
+	// NULL until loaded, callers skip drawing it
+	Mesh* getMesh(uint32_t _asset) const
+	{
+		return m_assets[_asset].m_mesh;
+	}
+
+	bgfx::TextureHandle getTexture(uint32_t _asset, bgfx::TextureHandle _placeholder) const
+	{
+		const bgfx::TextureHandle texture = m_assets[_asset].m_texture;
+		return bgfx::isValid(texture) ? texture : _placeholder;
+	}
+
+	bool isIdle() const
+	{
+		for (uint32_t ii = 0; ii < m_assetCount; ++ii)
+		{
+			if (AssetState::Loading == m_assets[ii].m_state)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	float getAllReadyMs() const
+	{
+		return m_allReadyMs;
+	}
+
+	void showTimings() const
+	{
+		for (uint32_t ii = 0; ii < m_assetCount; ++ii)
+		{
+			const Asset& asset = m_assets[ii];
+			if (AssetState::Loading == asset.m_state)
+			{
+				ImGui::Text("%s: loading", asset.m_filePath);
+			}
+			else if (AssetState::Failed == asset.m_state)
+			{
+				ImGui::Text("%s: failed", asset.m_filePath);
+			}
+			else
+			{
+				ImGui::Text("%s: %.1f ms", asset.m_filePath, asset.m_totalMs);
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::BeginTooltip();
+					ImGui::Text("read %.2f ms, parse %.2f ms on worker", asset.m_readMs, asset.m_parseMs);
+					ImGui::Text("create %.2f ms on main thread", asset.m_createMs);
+					ImGui::EndTooltip();
+				}
+			}
+		}
+	}
+
+private:
+	struct Asset
+	{
+		AssetType::Enum m_type;
+		AssetState::Enum m_state;
+		const char* m_filePath;
+		uint64_t m_textureFlags;
+		int64_t m_requestTime;
+
+		// written by worker, read by main thread after it came back through results
+		void* m_data;
+		uint32_t m_size;
+		bimg::ImageContainer* m_image;
+		float m_readMs;
+		float m_parseMs;
+
+		// main thread only
+		Mesh* m_mesh;
+		bgfx::TextureHandle m_texture;
+		float m_createMs;
+		float m_totalMs;
+	};
+
+	struct Worker
+	{
+		Worker()
+			: m_jobs(entry::getAllocator() )
+			, m_results(entry::getAllocator() )
+		{
+		}
+
+		bx::Thread m_thread;
+		AssetFileReader m_reader;
+		bx::SpScBlockingUnboundedQueueT<Asset> m_jobs;
+		bx::SpScUnboundedQueueT<Asset> m_results;
+		Asset m_quit;
+	};
+
+	static double getElapsedMs(int64_t _start)
+	{
+		return double(bx::getHPCounter() - _start) * 1000.0 / double(bx::getHPFrequency() );
+	}
+
+	uint32_t request(AssetType::Enum _type, const char* _filePath, uint64_t _textureFlags)
+	{
+		BX_ASSERT(m_assetCount < ASSET_LOADER_MAX_ASSETS, "Too many assets, increase ASSET_LOADER_MAX_ASSETS.");
+		const uint32_t index = m_assetCount++;
+
+		Asset& asset = m_assets[index];
+		asset.m_type = _type;
+		asset.m_state = AssetState::Loading;
+		asset.m_filePath = _filePath;
+		asset.m_textureFlags = _textureFlags;
+		asset.m_requestTime = bx::getHPCounter();
+		asset.m_data = NULL;
+		asset.m_size = 0;
+		asset.m_image = NULL;
+		asset.m_readMs = 0.0f;
+		asset.m_parseMs = 0.0f;
+		asset.m_mesh = NULL;
+		asset.m_texture.idx = bgfx::kInvalidHandle;
+		asset.m_createMs = 0.0f;
+		asset.m_totalMs = 0.0f;
+
+		m_workers[m_nextWorker].m_jobs.push(&asset);
+		m_nextWorker = (m_nextWorker + 1) % ASSET_LOADER_WORKER_COUNT;
+		return index;
+	}
+
+	static int32_t workerFunc(bx::Thread* /*_thread*/, void* _userData)
+	{
+		Worker* worker = (Worker*)_userData;
+
+		for (;;)
+		{
+			Asset* asset = worker->m_jobs.pop();
+			if (NULL == asset)
+			{
+				continue;
+			}
+
+			if (AssetType::Quit == asset->m_type)
+			{
+				break;
+			}
+
+			readAsset(worker->m_reader, *asset);
+			worker->m_results.push(asset);
+		}
+
+		return 0;
+	}
+
+	// worker thread, with the worker's own reader
+	static void readAsset(AssetFileReader& _reader, Asset& _asset)
+	{
+		int64_t start = bx::getHPCounter();
+
+		if (bx::open(&_reader, _asset.m_filePath) )
+		{
+			const uint32_t size = uint32_t(bx::getSize(&_reader) );
+			_asset.m_data = BX_ALLOC(entry::getAllocator(), size);
+			_asset.m_size = uint32_t(bx::read(&_reader, _asset.m_data, int32_t(size) ) );
+			bx::close(&_reader);
+		}
+		_asset.m_readMs = float(getElapsedMs(start) );
+
+		if (NULL == _asset.m_data
+		||  AssetType::Texture != _asset.m_type)
+		{
+			return;
+		}
+
+		start = bx::getHPCounter();
+		_asset.m_image = bimg::imageParse(entry::getAllocator(), _asset.m_data, _asset.m_size);
+		BX_FREE(entry::getAllocator(), _asset.m_data);
+		_asset.m_data = NULL;
+		_asset.m_parseMs = float(getElapsedMs(start) );
+	}
+
+	static void releaseImage(void* /*_ptr*/, void* _userData)
+	{
+		bimg::imageFree( (bimg::ImageContainer*)_userData);
+	}
+
+	// main thread, same resource creation as meshLoad/loadTexture in bgfx_utils
+	void finish(Asset& _asset)
+	{
+		const int64_t start = bx::getHPCounter();
+
+		if (AssetType::Mesh == _asset.m_type
+		&&  NULL != _asset.m_data)
+		{
+			bx::MemoryReader reader(_asset.m_data, _asset.m_size);
+			_asset.m_mesh = meshLoad(&reader);
+			BX_FREE(entry::getAllocator(), _asset.m_data);
+			_asset.m_data = NULL;
+		}
+		else if (AssetType::Texture == _asset.m_type
+		&&       NULL != _asset.m_image)
+		{
+			bimg::ImageContainer* image = _asset.m_image;
+			_asset.m_image = NULL;
+
+			// flat 2d textures are created from the parsed image, anything else is
+			// loaded again through loadTexture, which handles cube and volume textures
+			if (image->m_cubeMap
+			||  1 != image->m_depth)
+			{
+				bimg::imageFree(image);
+				_asset.m_texture = loadTexture(_asset.m_filePath, _asset.m_textureFlags);
+			}
+			else if (bgfx::isTextureValid(0, false, image->m_numLayers, bgfx::TextureFormat::Enum(image->m_format), _asset.m_textureFlags) )
+			{
+				const bgfx::Memory* mem = bgfx::makeRef(image->m_data, image->m_size, releaseImage, image);
+				_asset.m_texture = bgfx::createTexture2D(
+					  uint16_t(image->m_width)
+					, uint16_t(image->m_height)
+					, 1 < image->m_numMips
+					, image->m_numLayers
+					, bgfx::TextureFormat::Enum(image->m_format)
+					, _asset.m_textureFlags
+					, mem
+					);
+				bgfx::setName(_asset.m_texture, _asset.m_filePath);
+			}
+			else
+			{
+				bimg::imageFree(image);
+			}
+		}
+
+		_asset.m_createMs = float(getElapsedMs(start) );
+		_asset.m_totalMs = float(getElapsedMs(_asset.m_requestTime) );
+
+		const bool ready = NULL != _asset.m_mesh || bgfx::isValid(_asset.m_texture);
+		_asset.m_state = ready ? AssetState::Ready : AssetState::Failed;
+		DBG("Asset %s %s after %.2f ms (read %.2f, parse %.2f, create %.2f)."
+			, _asset.m_filePath
+			, ready ? "loaded" : "failed"
+			, _asset.m_totalMs
+			, _asset.m_readMs
+			, _asset.m_parseMs
+			, _asset.m_createMs
+			);
+	}
+
+	Worker m_workers[ASSET_LOADER_WORKER_COUNT];
+	Asset m_assets[ASSET_LOADER_MAX_ASSETS];
+	char m_currentDir[bx::kMaxFilePath];
+	uint32_t m_assetCount;
+	uint32_t m_nextWorker;
+	int64_t m_startTime;
+	float m_allReadyMs;
+	bool m_initialized;
+};
+
+// Targets for batched multi-view dof, one layer per camera. Forward pass renders
+// each camera into its own layer through a per layer frame buffer, the rest of the
+// chain runs in compute over all layers at once.
+struct MultiviewTargets
+{
+	MultiviewTargets()
+		: m_width(0)
+		, m_height(0)
+		, m_layerCount(0)
+	{
+	}
+
+	void init(uint16_t _width, uint16_t _height, uint16_t _layerCount)
+	{
+		m_width = _width;
+		m_height = _height;
+		m_layerCount = _layerCount;
+
+		const uint64_t bilinearFlags = 0
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+		const uint64_t computeFlags = bilinearFlags | BGFX_TEXTURE_COMPUTE_WRITE;
+
+		const uint16_t halfWidth = bx::max<uint16_t>(_width/2, 1);
+		const uint16_t halfHeight = bx::max<uint16_t>(_height/2, 1);
+
+		m_color = bgfx::createTexture2D(_width, _height, false, _layerCount, bgfx::TextureFormat::RGBA16F, bilinearFlags | BGFX_TEXTURE_RT);
+		m_depth = bgfx::createTexture2D(_width, _height, false, _layerCount, bgfx::TextureFormat::D32F, bilinearFlags | BGFX_TEXTURE_RT);
+		m_linearDepth = bgfx::createTexture2D(_width, _height, false, _layerCount, bgfx::TextureFormat::R32F, computeFlags);
+		m_downsample = bgfx::createTexture2D(halfWidth, halfHeight, false, _layerCount, bgfx::TextureFormat::RGBA16F, computeFlags);
+		m_gather = bgfx::createTexture2D(halfWidth, halfHeight, false, _layerCount, bgfx::TextureFormat::RGBA16F, computeFlags);
+		m_output = bgfx::createTexture2D(_width, _height, false, _layerCount, bgfx::TextureFormat::RGBA8, computeFlags);
+
+		for (uint16_t ii = 0; ii < _layerCount; ++ii)
+		{
+			bgfx::Attachment attachments[2];
+			attachments[0].init(m_color, bgfx::Access::Write, ii);
+			attachments[1].init(m_depth, bgfx::Access::Write, ii);
+			m_frameBuffers[ii] = bgfx::createFrameBuffer(BX_COUNTOF(attachments), attachments, false);
+		}
+	}
+
+	void destroy()
+	{
+		if (0 == m_layerCount)
+		{
+			return;
+		}
+
+		for (uint16_t ii = 0; ii < m_layerCount; ++ii)
+		{
+			bgfx::destroy(m_frameBuffers[ii]);
+		}
+
+		bgfx::destroy(m_color);
+		bgfx::destroy(m_depth);
+		bgfx::destroy(m_linearDepth);
+		bgfx::destroy(m_downsample);
+		bgfx::destroy(m_gather);
+		bgfx::destroy(m_output);
+
+		m_width = 0;
+		m_height = 0;
+		m_layerCount = 0;
+	}
+
+	uint16_t m_width;
+	uint16_t m_height;
+	uint16_t m_layerCount;
+
+	bgfx::TextureHandle m_color;
+	bgfx::TextureHandle m_depth;
+	bgfx::TextureHandle m_linearDepth;
+	bgfx::TextureHandle m_downsample;
+	bgfx::TextureHandle m_gather;
+	bgfx::TextureHandle m_output;
+	bgfx::FrameBufferHandle m_frameBuffers[MULTIVIEW_MAX_LAYERS];
+};
+
+#define DEPTH_PYRAMID_MAX_LEVELS		16
+#define DEPTH_PYRAMID_READBACK_SIZE		64
+
+struct DepthPyramidUniforms
+{
+	enum { NumVec4 = 2 };
+
+	void init() {
+		u_params = bgfx::createUniform("u_pyramidParams", bgfx::UniformType::Vec4, NumVec4);
+	};
+
+	void submit() const {
+		bgfx::setUniform(u_params, m_params, NumVec4);
+	};
+
+	void destroy() {
+		bgfx::destroy(u_params);
+	}
+
+	union
+	{
+		struct
+		{
+			/* 0 */ struct { float m_sourceSize[2]; float m_outputSize[2]; };
+			/* 1 */ struct { float m_sourceOffset[2]; float m_depthTexelSize[2]; };
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	bgfx::UniformHandle u_params;
+};
+
+// cpu version of cs_bokeh_depth_pyramid_reduce.sc. each output texel takes min and max
+// over every source texel it overlaps, rows of the output are packed
+void reduceDepthBounds(
+	  float* _output
+	, uint32_t _outputWidth
+	, uint32_t _outputHeight
+	, const float* _source
+	, uint32_t _sourceWidth
+	, uint32_t _sourceHeight
+	, uint32_t _sourcePitch
+	)
+{
+	for (uint32_t yy = 0; yy < _outputHeight; ++yy)
+	{
+		const uint32_t y0 = yy * _sourceHeight / _outputHeight;
+		const uint32_t y1 = ( (yy + 1) * _sourceHeight + _outputHeight - 1) / _outputHeight;
+
+		for (uint32_t xx = 0; xx < _outputWidth; ++xx)
+		{
+			const uint32_t x0 = xx * _sourceWidth / _outputWidth;
+			const uint32_t x1 = ( (xx + 1) * _sourceWidth + _outputWidth - 1) / _outputWidth;
+
+			float minDepth = bx::kFloatMax;
+			float maxDepth = 0.0f;
+			for (uint32_t sy = y0; sy < y1; ++sy)
+			{
+				for (uint32_t sx = x0; sx < x1; ++sx)
+				{
+					const float* bounds = &_source[(sy * _sourcePitch + sx) * 2];
+					minDepth = bx::min(minDepth, bounds[0]);
+					maxDepth = bx::max(maxDepth, bounds[1]);
+				}
+			}
+
+			float* result = &_output[(yy * _outputWidth + xx) * 2];
+			result[0] = minDepth;
+			result[1] = maxDepth;
+		}
+	}
+}
+
+// footprints of one axis, as reduceDepthBounds and the shader tile it. each is one to
+// three source texels, the 3x3 the shader reads, and together they cover the source
+bool checkDepthFootprints(uint32_t _sourceSize, uint32_t _outputSize)
+{
+	uint32_t covered = 0;
+	for (uint32_t ii = 0; ii < _outputSize; ++ii)
+	{
+		const uint32_t begin = ii * _sourceSize / _outputSize;
+		const uint32_t end = ( (ii + 1) * _sourceSize + _outputSize - 1) / _outputSize;
+		if (begin > covered
+		||  end <= begin
+		||  end - begin > 3)
+		{
+			return false;
+		}
+		covered = bx::max(covered, end);
+	}
+
+	return covered == _sourceSize;
+}
+
+// Reduces random level 0 depths down to 1x1 with reduceDepthBounds for odd, non-square
+// and 1xN sizes. Each texel of each level must equal a brute force min and max over the
+// level 0 rect its footprints cover, and the last level the bounds of the whole level
+// 0. Logs and returns false on failure.
+bool testDepthPyramidReduction(bx::AllocatorI* _allocator)
+{
+	static const uint16_t s_sizes[][2] =
+	{
+		{    1,   1 }, {    1,   7 }, {    9,   1 }, {    2,   3 },
+		{    3,   3 }, {    5,   2 }, {    7,  13 }, {   33,  17 },
+		{   64,   1 }, {    1,  65 }, {  127,  63 }, {  640, 361 },
+		{ 1023, 577 },
+	};
+
+	uint32_t numFailed = 0;
+	for (uint32_t ss = 0; ss < BX_COUNTOF(s_sizes); ++ss)
+	{
+		const uint32_t width = s_sizes[ss][0];
+		const uint32_t height = s_sizes[ss][1];
+
+		float* level0 = (float*)BX_ALLOC(_allocator, width * height * 2 * sizeof(float) );
+		float* levels[2] =
+		{
+			(float*)BX_ALLOC(_allocator, width * height * 2 * sizeof(float) ),
+			(float*)BX_ALLOC(_allocator, width * height * 2 * sizeof(float) ),
+		};
+
+		// linear depth in [0.1, 100), min and max start out equal like the linearize pass
+		float globalMin = bx::kFloatMax;
+		float globalMax = 0.0f;
+		uint32_t hash = 0x9e3779b9u * (ss + 1);
+		for (uint32_t ii = 0; ii < width * height; ++ii)
+		{
+			hash ^= hash << 13;
+			hash ^= hash >> 17;
+			hash ^= hash << 5;
+			const float depth = 0.1f + 99.9f * float(hash & 0xffffff) / float(0x1000000);
+			level0[ii*2+0] = depth;
+			level0[ii*2+1] = depth;
+			globalMin = bx::min(globalMin, depth);
+			globalMax = bx::max(globalMax, depth);
+		}
+
+		uint32_t levelWidth[DEPTH_PYRAMID_MAX_LEVELS];
+		uint32_t levelHeight[DEPTH_PYRAMID_MAX_LEVELS];
+		levelWidth[0] = width;
+		levelHeight[0] = height;
+
+		bool passed = true;
+		const float* source = level0;
+		uint32_t numLevels = 1;
+		while (passed
+		&&    (levelWidth[numLevels-1] > 1 || levelHeight[numLevels-1] > 1) )
+		{
+			const uint32_t level = numLevels++;
+			const uint32_t sourceWidth = levelWidth[level-1];
+			const uint32_t sourceHeight = levelHeight[level-1];
+			const uint32_t outputWidth = bx::max(sourceWidth / 2, 1u);
+			const uint32_t outputHeight = bx::max(sourceHeight / 2, 1u);
+			levelWidth[level] = outputWidth;
+			levelHeight[level] = outputHeight;
+
+			passed = true
+				&& checkDepthFootprints(sourceWidth, outputWidth)
+				&& checkDepthFootprints(sourceHeight, outputHeight)
+				;
+
+			float* output = levels[level & 1];
+			reduceDepthBounds(output, outputWidth, outputHeight, source, sourceWidth, sourceHeight, sourceWidth);
+			source = output;
+
+			for (uint32_t yy = 0; yy < outputHeight && passed; ++yy)
+			{
+				for (uint32_t xx = 0; xx < outputWidth && passed; ++xx)
+				{
+					// footprints of neighbouring texels are contiguous, so a rect maps
+					// to the rect from its first footprint's begin to its last's end
+					uint32_t x0 = xx, x1 = xx + 1, y0 = yy, y1 = yy + 1;
+					for (uint32_t ll = level; ll > 0; --ll)
+					{
+						x0 = x0 * levelWidth[ll-1] / levelWidth[ll];
+						x1 = (x1 * levelWidth[ll-1] + levelWidth[ll] - 1) / levelWidth[ll];
+						y0 = y0 * levelHeight[ll-1] / levelHeight[ll];
+						y1 = (y1 * levelHeight[ll-1] + levelHeight[ll] - 1) / levelHeight[ll];
+					}
+
+					float minDepth = bx::kFloatMax;
+					float maxDepth = 0.0f;
+					for (uint32_t sy = y0; sy < y1; ++sy)
+					{
+						for (uint32_t sx = x0; sx < x1; ++sx)
+						{
+							minDepth = bx::min(minDepth, level0[(sy * width + sx) * 2 + 0]);
+							maxDepth = bx::max(maxDepth, level0[(sy * width + sx) * 2 + 1]);
+						}
+					}
+
+					const float* bounds = &output[(yy * outputWidth + xx) * 2];
+					passed = bounds[0] == minDepth && bounds[1] == maxDepth;
+				}
+			}
+		}
+
+		if (passed)
+		{
+			passed = source[0] == globalMin && source[1] == globalMax;
+		}
+
+		if (!passed)
+		{
+			DBG("Depth pyramid reduction of %ux%u FAILED at level %u of %ux%u."
+				, width
+				, height
+				, numLevels - 1
+				, levelWidth[numLevels-1]
+				, levelHeight[numLevels-1]
+				);
+			++numFailed;
+		}
+
+		BX_FREE(_allocator, level0);
+		BX_FREE(_allocator, levels[0]);
+		BX_FREE(_allocator, levels[1]);
+	}
+
+	DBG("Depth pyramid reduction: %u of %u sizes failed, %s"
+		, numFailed
+		, uint32_t(BX_COUNTOF(s_sizes) )
+		, 0 == numFailed ? "passed" : "FAILED"
+		);
+
+	return 0 == numFailed;
+}
+
+// Min and max linear depth of the rendered part of the depth buffer, as mips of one
+// RG32F texture, for anything that wants coarse depth bounds. Level 0 linearizes the
+// D32F target, each level after halves in size, rounding down, and reduces every
+// texel of the level below it overlaps, three wide where sizes are odd. Min and max
+// only pick existing values, so a cpu reduction of any level reproduces the ones
+// above it exactly. A level of at most 64x64 is read back for cpu queries, which
+// answer from data a few frames old.
+struct DepthPyramid
+{
+	struct Request
+	{
+		uint32_t m_frame;
+		uint16_t m_width;
+		uint16_t m_height;
+		uint8_t m_level;
+		bool m_originBottomLeft;
+	};
+
+	DepthPyramid()
+		: m_width(0)
+		, m_height(0)
+		, m_levelCount(0)
+		, m_readbackLevel(0)
+		, m_verifyLevel(0)
+		, m_cpuLevelCount(0)
+		, m_cpuData(NULL)
+		, m_verifyData(NULL)
+		, m_cpuFlipY(false)
+		, m_verify(false)
+		, m_verifiedFrames(0)
+		, m_mismatchFrames(0)
+	{
+		m_texture.idx = bgfx::kInvalidHandle;
+	}
+
+	// read back textures and cpu levels, sized for any resolution. the finer level
+	// read back for verifying is at most 4x the size plus rounding
+	void initReadback()
+	{
+		const uint16_t size = DEPTH_PYRAMID_READBACK_SIZE;
+		const uint16_t verifySize = 4*DEPTH_PYRAMID_READBACK_SIZE + 3;
+		m_readback.init(size, size, bgfx::TextureFormat::RG32F, 2*sizeof(float) );
+		m_verifyReadback.init(verifySize, verifySize, bgfx::TextureFormat::RG32F, 2*sizeof(float) );
+
+		// read back level and its reductions down to 1x1, then scratch for reducing
+		// the verify level up to the read back one
+		m_cpuData = (float*)BX_ALLOC(entry::getAllocator(), size * size * 2 * 2 * sizeof(float) );
+		m_verifyData = (float*)BX_ALLOC(entry::getAllocator(), verifySize * verifySize * 2 * sizeof(float) );
+		m_cpuLevelCount = 0;
+
+		for (uint32_t ii = 0; ii < READBACK_RING_SIZE; ++ii)
+		{
+			m_requested[0][ii].m_frame = 0;
+			m_requested[1][ii].m_frame = 0;
+		}
+	}
+
+	void destroyReadback()
+	{
+		m_readback.destroy();
+		m_verifyReadback.destroy();
+		BX_FREE(entry::getAllocator(), m_cpuData);
+		BX_FREE(entry::getAllocator(), m_verifyData);
+		m_cpuData = NULL;
+		m_verifyData = NULL;
+		m_cpuLevelCount = 0;
+	}
+
+	// full size of the depth target, pyramid covers it down to 1x1
+	void init(uint16_t _width, uint16_t _height)
+	{
+		m_width = _width;
+		m_height = _height;
+		m_levelCount = 1;
+		while (m_levelCount < DEPTH_PYRAMID_MAX_LEVELS
+		&&     ( (_width >> m_levelCount) > 0 || (_height >> m_levelCount) > 0) )
+		{
+			++m_levelCount;
+		}
+
+		const uint64_t flags = 0
+			| BGFX_TEXTURE_COMPUTE_WRITE
+			| BGFX_SAMPLER_POINT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+		m_texture = bgfx::createTexture2D(_width, _height, true, 1, bgfx::TextureFormat::RG32F, flags);
+		setRenderSize(_width, _height, false);
+
+		// first level small enough to read back, verify against one two levels finer
+		m_readbackLevel = 0;
+		while (getMipWidth(m_readbackLevel) > DEPTH_PYRAMID_READBACK_SIZE
+		||     getMipHeight(m_readbackLevel) > DEPTH_PYRAMID_READBACK_SIZE)
+		{
+			++m_readbackLevel;
+		}
+		m_verifyLevel = m_readbackLevel > 2 ? m_readbackLevel - 2 : 0;
+	}
+
+	void destroy()
+	{
+		if (bgfx::isValid(m_texture) )
+		{
+			bgfx::destroy(m_texture);
+			m_texture.idx = bgfx::kInvalidHandle;
+		}
+	}
+
+	uint16_t getMipWidth(uint32_t _level) const
+	{
+		return bx::max<uint16_t>(m_width >> _level, 1);
+	}
+
+	uint16_t getMipHeight(uint32_t _level) const
+	{
+		return bx::max<uint16_t>(m_height >> _level, 1);
+	}
+
+	// part of each level covering the rendered area, starts at texel 0, 0
+	void setRenderSize(uint16_t _width, uint16_t _height, bool _originBottomLeft)
+	{
+		m_levelWidth[0] = _width;
+		m_levelHeight[0] = _height;
+		for (uint32_t ii = 1; ii < m_levelCount; ++ii)
+		{
+			m_levelWidth[ii] = bx::max<uint16_t>(m_levelWidth[ii-1] / 2, 1);
+			m_levelHeight[ii] = bx::max<uint16_t>(m_levelHeight[ii-1] / 2, 1);
+		}
+		m_originBottomLeft = _originBottomLeft;
+	}
+
+	// needs a level at least two finer than the read back one
+	bool isVerifying() const
+	{
+		return m_verify && m_verifyLevel < m_readbackLevel;
+	}
+
+	// after submitting the pyramid this frame, copies go in _view
+	void requestReadback(bgfx::ViewId _view, uint32_t _currFrame)
+	{
+		// both levels come from the same frame when verifying
+		if (!m_readback.canRequest()
+		||  (isVerifying() && !m_verifyReadback.canRequest() ) )
+		{
+			return;
+		}
+
+		queueLevel(m_readback, m_requested[0][m_readback.m_next], _view, m_readbackLevel, _currFrame);
+		if (isVerifying() )
+		{
+			queueLevel(m_verifyReadback, m_requested[1][m_verifyReadback.m_next], _view, m_verifyLevel, _currFrame);
+		}
+	}
+
+	void queueLevel(ReadbackRing& _ring, Request& _request, bgfx::ViewId _view, uint32_t _level, uint32_t _currFrame)
+	{
+		_request.m_frame = _currFrame;
+		_request.m_width = m_levelWidth[_level];
+		_request.m_height = m_levelHeight[_level];
+		_request.m_level = uint8_t(_level);
+		_request.m_originBottomLeft = m_originBottomLeft;
+
+		// ring textures are larger than any level read, blit clamps to the mip size
+		_ring.request(_view, m_texture, uint8_t(_level) );
+	}
+
+	// picks up landed read backs, builds the cpu levels and checks them when verifying
+	void update(uint32_t _currFrame)
+	{
+		uint32_t slot = 0;
+		const float* data = (const float*)m_readback.poll(_currFrame, &slot);
+		if (NULL == data)
+		{
+			return;
+		}
+
+		const Request& request = m_requested[0][slot];
+		m_cpuFlipY = request.m_originBottomLeft;
+		m_cpuLevelCount = 0;
+		for (uint32_t yy = 0; yy < request.m_height; ++yy)
+		{
+			bx::memCopy(&m_cpuData[yy * request.m_width * 2], &data[yy * m_readback.m_width * 2], request.m_width * 2 * sizeof(float) );
+		}
+
+		uint32_t offset = 0;
+		uint16_t width = request.m_width;
+		uint16_t height = request.m_height;
+		for (;;)
+		{
+			if (0 != m_cpuLevelCount)
+			{
+				const uint32_t prev = m_cpuLevelCount - 1;
+				width = bx::max<uint16_t>(m_cpuWidth[prev] / 2, 1);
+				height = bx::max<uint16_t>(m_cpuHeight[prev] / 2, 1);
+				reduceDepthBounds(&m_cpuData[offset], width, height, &m_cpuData[m_cpuOffset[prev] ], m_cpuWidth[prev], m_cpuHeight[prev], m_cpuWidth[prev]);
+			}
+
+			m_cpuOffset[m_cpuLevelCount] = offset;
+			m_cpuWidth[m_cpuLevelCount] = width;
+			m_cpuHeight[m_cpuLevelCount] = height;
+			++m_cpuLevelCount;
+			offset += width * height * 2;
+
+			if (1 == width && 1 == height)
+			{
+				break;
+			}
+		}
+
+		if (isVerifying() )
+		{
+			uint32_t verifySlot = 0;
+			const float* verifyData = (const float*)m_verifyReadback.poll(_currFrame, &verifySlot);
+			if (NULL != verifyData
+			&&  m_requested[1][verifySlot].m_frame == request.m_frame
+			&&  m_requested[1][verifySlot].m_level < request.m_level)
+			{
+				verifyLevels(verifyData, m_requested[1][verifySlot], request);
+			}
+		}
+	}
+
+	// reduce the finer read back level on cpu up to the coarser one, must match exactly
+	void verifyLevels(const float* _data, const Request& _finer, const Request& _coarser)
+	{
+		uint16_t width = _finer.m_width;
+		uint16_t height = _finer.m_height;
+		const float* source = _data;
+		uint32_t pitch = m_verifyReadback.m_width;
+
+		for (uint32_t ii = _finer.m_level; ii < _coarser.m_level; ++ii)
+		{
+			const uint16_t outputWidth = bx::max<uint16_t>(width / 2, 1);
+			const uint16_t outputHeight = bx::max<uint16_t>(height / 2, 1);
+
+			// fine in place, each output texel only reads source texels at or after it
+			reduceDepthBounds(m_verifyData, outputWidth, outputHeight, source, width, height, pitch);
+
+			source = m_verifyData;
+			pitch = outputWidth;
+			width = outputWidth;
+			height = outputHeight;
+		}
+
+		const bool match = true
+			&& width == m_cpuWidth[0]
+			&& height == m_cpuHeight[0]
+			&& 0 == bx::memCmp(source, m_cpuData, width * height * 2 * sizeof(float) )
+			;
+
+		++m_verifiedFrames;
+		if (!match)
+		{
+			++m_mismatchFrames;
+			DBG("Depth pyramid level %u differs from cpu reduction of level %u.", _coarser.m_level, _finer.m_level);
+		}
+	}
+
+	// conservative min and max linear depth over a screen rect, uv with origin top
+	// left. false until the first read back lands
+	bool queryBounds(float* _min, float* _max, float _u0, float _v0, float _u1, float _v1) const
+	{
+		if (0 == m_cpuLevelCount)
+		{
+			return false;
+		}
+
+		if (m_cpuFlipY)
+		{
+			const float v0 = 1.0f - _v1;
+			_v1 = 1.0f - _v0;
+			_v0 = v0;
+		}
+
+		// finest level where the rect covers at most 4x4 texels
+		uint32_t level = 0;
+		uint32_t x0, x1, y0, y1;
+		for (;; ++level)
+		{
+			const float width = float(m_cpuWidth[level]);
+			const float height = float(m_cpuHeight[level]);
+			x0 = uint32_t(bx::clamp(bx::floor(_u0 * width),  0.0f, width  - 1.0f) );
+			y0 = uint32_t(bx::clamp(bx::floor(_v0 * height), 0.0f, height - 1.0f) );
+			x1 = uint32_t(bx::clamp(bx::ceil(_u1 * width),   float(x0 + 1), width) );
+			y1 = uint32_t(bx::clamp(bx::ceil(_v1 * height),  float(y0 + 1), height) );
+
+			if ( (x1 - x0 <= 4 && y1 - y0 <= 4)
+			||  level + 1 == m_cpuLevelCount)
+			{
+				break;
+			}
+		}
+
+		const float* data = &m_cpuData[m_cpuOffset[level] ];
+		float minDepth = bx::kFloatMax;
+		float maxDepth = 0.0f;
+		for (uint32_t yy = y0; yy < y1; ++yy)
+		{
+			for (uint32_t xx = x0; xx < x1; ++xx)
+			{
+				const float* bounds = &data[(yy * m_cpuWidth[level] + xx) * 2];
+				minDepth = bx::min(minDepth, bounds[0]);
+				maxDepth = bx::max(maxDepth, bounds[1]);
+			}
+		}
+
+		*_min = minDepth;
+		*_max = maxDepth;
+		return true;
+	}
 
-	void init() {
-		u_params = bgfx::createUniform("u_modelParams", bgfx::UniformType::Vec4, NumVec4);
-	};
+	uint16_t m_width;
+	uint16_t m_height;
+	uint32_t m_levelCount;
+	uint16_t m_levelWidth[DEPTH_PYRAMID_MAX_LEVELS];
+	uint16_t m_levelHeight[DEPTH_PYRAMID_MAX_LEVELS];
+	bool m_originBottomLeft;
+	bgfx::TextureHandle m_texture;
 
-	void submit() const {
-		bgfx::setUniform(u_params, m_params, NumVec4);
-	};
+	uint32_t m_readbackLevel;
+	uint32_t m_verifyLevel;
+	ReadbackRing m_readback;
+	ReadbackRing m_verifyReadback;
+	Request m_requested[2][READBACK_RING_SIZE];
+
+	uint32_t m_cpuLevelCount;
+	uint32_t m_cpuOffset[DEPTH_PYRAMID_MAX_LEVELS];
+	uint16_t m_cpuWidth[DEPTH_PYRAMID_MAX_LEVELS];
+	uint16_t m_cpuHeight[DEPTH_PYRAMID_MAX_LEVELS];
+	float* m_cpuData;
+	float* m_verifyData;
+	bool m_cpuFlipY;
+
+	bool m_verify;
+	uint32_t m_verifiedFrames;
+	uint32_t m_mismatchFrames;
+};
 
-	void destroy() {
-		bgfx::destroy(u_params);
-	}
+// CPU side mirror of EncodeBlurSize/DecodeBlurSize in bokeh_dof.sh. Signed blur size
+// in [-maxBlurSize, maxBlurSize] maps to [0, 254/255] so zero lands exactly on code 127
+// of an 8 bit unorm target.
+static const float kBlurSizeEncodeZero = 127.0f/255.0f;
 
-	union
-	{
-		struct
-		{
-			/* 0 */ struct { float m_color[3]; float m_unused0; };
-			/* 1 */ struct { float m_lightPosition[3]; float m_unused1; };
-		};
+// range of the max blur size slider, blur size encoding has to hold over all of it
+static const float kMaxBlurSizeMin = 10.0f;
+static const float kMaxBlurSizeMax = 50.0f;
 
-		float m_params[NumVec4 * 4];
-	};
+float encodeBlurSize(float _blurSize, float _maxBlurSize)
+{
+	return bx::clamp(_blurSize / _maxBlurSize * kBlurSizeEncodeZero + kBlurSizeEncodeZero, 0.0f, 1.0f);
+}
 
-	bgfx::UniformHandle u_params;
-};
+float decodeBlurSize(float _encoded, float _maxBlurSize)
+{
+	return (_encoded - kBlurSizeEncodeZero) * (_maxBlurSize / kBlurSizeEncodeZero);
+}
 
-struct RenderTarget
+// average sample size is never negative, use full range
+float encodeSampleSize(float _sampleSize, float _maxBlurSize)
 {
-	void init(uint32_t _width, uint32_t _height, bgfx::TextureFormat::Enum _format, uint64_t _flags)
-	{
-		m_texture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, _format, _flags);
-		const bool destroyTextures = true;
-		m_buffer = bgfx::createFrameBuffer(1, &m_texture, destroyTextures);
-	}
+	return bx::clamp(_sampleSize / _maxBlurSize, 0.0f, 1.0f);
+}
 
-	void destroy()
+float decodeSampleSize(float _encoded, float _maxBlurSize)
+{
+	return _encoded * _maxBlurSize;
+}
+
+// emulate what storing to the given single channel target does to a [0,1] value
+float quantizeToFormat(float _value, bgfx::TextureFormat::Enum _format)
+{
+	switch (_format)
 	{
-		// also responsible for destroying texture
-		bgfx::destroy(m_buffer);
+	case bgfx::TextureFormat::R8:   return bx::floor(_value * 255.0f + 0.5f) / 255.0f;
+	case bgfx::TextureFormat::R16F: return bx::halfToFloat(bx::halfFromFloat(_value) );
+	default: break;
 	}
 
-	bgfx::TextureHandle m_texture;
-	bgfx::FrameBufferHandle m_buffer;
-};
+	return _value;
+}
 
-void screenSpaceQuad(float _textureWidth, float _textureHeight, float _texelHalf, bool _originBottomLeft, float _width = 1.0f, float _height = 1.0f)
+// Round trip signed blur size and sample size through each compact format. Checks
+// that error stays within half a quantization step, that in focus stays in
+// focus, and that foreground/background sign survives. Logs and returns false on failure.
+bool testBlurSizeEncoding(float _maxBlurSize)
 {
-	if (3 == bgfx::getAvailTransientVertexBuffer(3, PosTexCoord0Vertex::ms_layout))
+	bool result = true;
+
+	for (uint32_t ii = 0; ii < IntermediateFormat::Count; ++ii)
 	{
-		bgfx::TransientVertexBuffer vb;
-		bgfx::allocTransientVertexBuffer(&vb, 3, PosTexCoord0Vertex::ms_layout);
-		PosTexCoord0Vertex* vertex = (PosTexCoord0Vertex*)vb.data;
+		const bgfx::TextureFormat::Enum format = getIntermediateFormatInfo(IntermediateFormat::Enum(ii) ).m_blurSize;
+		if (bgfx::TextureFormat::Count == format)
+		{
+			continue;
+		}
 
-		const float minx = -_width;
-		const float maxx =  _width;
-		const float miny = 0.0f;
-		const float maxy =  _height * 2.0f;
+		// unorm8 steps evenly, half float step is largest just below 1.0
+		const float encodedStep = (bgfx::TextureFormat::R8 == format) ? (1.0f/255.0f) : (1.0f/2048.0f);
+		const float blurSizeTolerance = 0.5f * encodedStep * (_maxBlurSize / kBlurSizeEncodeZero) + 1e-5f;
+		const float sampleSizeTolerance = 0.5f * encodedStep * _maxBlurSize + 1e-5f;
 
-		const float texelHalfW = _texelHalf / _textureWidth;
-		const float texelHalfH = _texelHalf / _textureHeight;
-		const float minu = -1.0f + texelHalfW;
-		const float maxu =  1.0f + texelHalfW;
+		float maxBlurSizeError = 0.0f;
+		float maxSampleSizeError = 0.0f;
+		bool signPreserved = true;
 
-		const float zz = 0.0f;
+		const int32_t numSteps = 4096;
+		for (int32_t jj = -numSteps; jj <= numSteps; ++jj)
+		{
+			const float blurSize = _maxBlurSize * float(jj) / float(numSteps);
+			const float decoded = decodeBlurSize(quantizeToFormat(encodeBlurSize(blurSize, _maxBlurSize), format), _maxBlurSize);
+			maxBlurSizeError = bx::max(maxBlurSizeError, bx::abs(decoded - blurSize) );
 
-		float minv = texelHalfH;
-		float maxv = 2.0f + texelHalfH;
+			if (bx::abs(blurSize) > blurSizeTolerance
+			&&  (0.0f < blurSize) != (0.0f < decoded) )
+			{
+				signPreserved = false;
+			}
 
-		if (_originBottomLeft)
-		{
-			float temp = minv;
-			minv = maxv;
-			maxv = temp;
+			const float sampleSize = bx::abs(blurSize);
+			const float decodedSampleSize = decodeSampleSize(quantizeToFormat(encodeSampleSize(sampleSize, _maxBlurSize), format), _maxBlurSize);
+			maxSampleSizeError = bx::max(maxSampleSizeError, bx::abs(decodedSampleSize - sampleSize) );
+		}
+
+		const float inFocus = decodeBlurSize(quantizeToFormat(encodeBlurSize(0.0f, _maxBlurSize), format), _maxBlurSize);
+		const bool passed = true
+			&& maxBlurSizeError <= blurSizeTolerance
+			&& maxSampleSizeError <= sampleSizeTolerance
+			&& signPreserved
+			&& bx::abs(inFocus) <= blurSizeTolerance
+			;
 
-			minv -= 1.0f;
-			maxv -= 1.0f;
+		if (!passed)
+		{
+			DBG("blur size encoding %s FAILED at max blur size %.2f: max error %f (tolerance %f), sample size max error %f (tolerance %f), in focus %f, sign %s"
+				, getIntermediateFormatInfo(IntermediateFormat::Enum(ii) ).m_name
+				, _maxBlurSize
+				, maxBlurSizeError
+				, blurSizeTolerance
+				, maxSampleSizeError
+				, sampleSizeTolerance
+				, inFocus
+				, signPreserved ? "preserved" : "flipped"
+				);
 		}
 
-		vertex[0].m_x = minx;
-		vertex[0].m_y = miny;
-		vertex[0].m_z = zz;
-		vertex[0].m_u = minu;
-		vertex[0].m_v = minv;
+		result &= passed;
+	}
+
+	return result;
+}
+
+// testBlurSizeEncoding over the whole max blur size slider range, in quarter pixel
+// steps. Returns false if any max blur size fails.
+bool testBlurSizeEncodingRange()
+{
+	const float step = 0.25f;
+	const uint32_t numSteps = uint32_t( (kMaxBlurSizeMax - kMaxBlurSizeMin) / step);
+
+	uint32_t numFailed = 0;
+	for (uint32_t ii = 0; ii <= numSteps; ++ii)
+	{
+		numFailed += testBlurSizeEncoding(kMaxBlurSizeMin + float(ii) * step) ? 0 : 1;
+	}
 
-		vertex[1].m_x = maxx;
-		vertex[1].m_y = miny;
-		vertex[1].m_z = zz;
-		vertex[1].m_u = maxu;
-		vertex[1].m_v = minv;
+	DBG("blur size encoding: %u of %u max blur sizes from %.0f to %.0f failed, %s"
+		, numFailed
+		, numSteps + 1
+		, kMaxBlurSizeMin
+		, kMaxBlurSizeMax
+		, 0 == numFailed ? "passed" : "FAILED"
+		);
 
-		vertex[2].m_x = maxx;
-		vertex[2].m_y = maxy;
-		vertex[2].m_z = zz;
-		vertex[2].m_u = maxu;
-		vertex[2].m_v = maxv;
+	return 0 == numFailed;
+}
 
-		bgfx::setVertexBuffer(0, &vb);
+// gpu time of a view from the previous profiled frame, needs BGFX_DEBUG_PROFILER
+float getViewGpuTimeMs(const bgfx::Stats* _stats, bgfx::ViewId _view)
+{
+	for (uint16_t ii = 0; ii < _stats->numViews; ++ii)
+	{
+		const bgfx::ViewStats& viewStats = _stats->viewStats[ii];
+		if (viewStats.view == _view)
+		{
+			return float(double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * 1000.0 / double(_stats->gpuTimerFreq) );
+		}
 	}
+
+	return 0.0f;
 }
 
 void vec2Set(float* _v, float _x, float _y)
@@ -229,7 +2273,6 @@ public:
 	ExampleBokeh(const char* _name, const char* _description)
 		: entry::AppI(_name, _description)
 		, m_currFrame(UINT32_MAX)
-		, m_texelHalf(0.0f)
 	{
 	}
 
@@ -237,6 +2280,71 @@ public:
 	{
 		Args args(_argc, _argv);
 
+		m_startupTime = bx::getHPCounter();
+
+		// offline tools run before anything is created, the app then exits on first update
+		bx::CommandLine cmdLine(_argc, _argv);
+		if (cmdLine.hasArg("pareto-sweep") )
+		{
+			ParetoSweepConfig config;
+			config.m_outputPath = cmdLine.findOption("sweep-output", config.m_outputPath);
+			bx::fromString(&config.m_width, cmdLine.findOption("sweep-width", "320") );
+			bx::fromString(&config.m_height, cmdLine.findOption("sweep-height", "180") );
+			runParetoSweep(entry::getAllocator(), config);
+			m_exitAfterInit = true;
+		}
+
+		if (cmdLine.hasArg("sequence-dof") )
+		{
+			SequenceDofConfig config;
+			bx::fromString(&config.m_frameCount, cmdLine.findOption("sequence-frames", "48") );
+			bx::fromString(&config.m_width, cmdLine.findOption("sequence-width", "320") );
+			bx::fromString(&config.m_height, cmdLine.findOption("sequence-height", "180") );
+			config.m_mode = cmdLine.hasArg("sequence-multi-pass") ? BokehDofMode::MultiPass : BokehDofMode::SinglePass;
+			config.m_verify = cmdLine.hasArg("sequence-verify");
+			runSequenceDof(entry::getAllocator(), config);
+			m_exitAfterInit = true;
+		}
+
+		if (cmdLine.hasArg("cache-sim") )
+		{
+			CacheSimConfig config;
+			uint32_t cacheKb = config.m_cacheSize / 1024;
+			uint32_t format = config.m_format;
+			config.m_outputPath = cmdLine.findOption("cache-output", config.m_outputPath);
+			bx::fromString(&config.m_width, cmdLine.findOption("cache-width", "0") );
+			bx::fromString(&config.m_height, cmdLine.findOption("cache-height", "0") );
+			bx::fromString(&cacheKb, cmdLine.findOption("cache-kb", "16") );
+			bx::fromString(&config.m_lineSize, cmdLine.findOption("cache-line", "64") );
+			bx::fromString(&config.m_ways, cmdLine.findOption("cache-ways", "4") );
+			bx::fromString(&config.m_tileSize, cmdLine.findOption("cache-tile", "8") );
+			bx::fromString(&format, cmdLine.findOption("cache-format", "0") );
+			config.m_cacheSize = cacheKb * 1024;
+			config.m_format = IntermediateFormat::Enum(bx::min(format, uint32_t(IntermediateFormat::Count - 1) ) );
+			config.m_blockLayout = !cmdLine.hasArg("cache-linear");
+			runCacheSim(entry::getAllocator(), config);
+			m_exitAfterInit = true;
+		}
+
+		if (cmdLine.hasArg("test-encoding") )
+		{
+			m_exitCode = testBlurSizeEncodingRange() ? 0 : 1;
+			m_exitAfterInit = true;
+		}
+
+		if (cmdLine.hasArg("test-depth-pyramid") )
+		{
+			m_exitCode = testDepthPyramidReduction(entry::getAllocator() ) ? 0 : 1;
+			m_exitAfterInit = true;
+		}
+
+		// gpu check renders, checked once device caps are known
+		if (cmdLine.hasArg("verify-depth-pyramid") )
+		{
+			bx::fromString(&m_verifyDepthPyramidFrames, cmdLine.findOption("verify-frames", "120") );
+			m_verifyDepthPyramidFrames = bx::max(m_verifyDepthPyramidFrames, 1u);
+		}
+
 		m_width = _width;
 		m_height = _height;
 		m_debug = BGFX_DEBUG_NONE;
@@ -257,6 +2365,9 @@ public:
 		// Create uniforms for screen passes and models
 		m_uniforms.init();
 		m_modelUniforms.init();
+		m_autofocusUniforms.init();
+		m_multiviewUniforms.init();
+		m_depthPyramidUniforms.init();
 
 		// Create texture sampler uniforms (used when we bind textures)
 		s_albedo = bgfx::createUniform("s_albedo", bgfx::UniformType::Sampler);
@@ -264,27 +2375,138 @@ public:
 		s_normal = bgfx::createUniform("s_normal", bgfx::UniformType::Sampler);
 		s_depth = bgfx::createUniform("s_depth", bgfx::UniformType::Sampler);
 		s_blurredColor = bgfx::createUniform("s_blurredColor", bgfx::UniformType::Sampler);
+		s_blurSize = bgfx::createUniform("s_blurSize", bgfx::UniformType::Sampler);
+
+		// Shaders come from one bundle file when present, programs are created on first use
+		{
+			const int64_t bundleStart = bx::getHPCounter();
+			const char* bundlePath = getShaderBundlePath(bgfx::getRendererType() );
+			if (m_shaderBundle.open(bundlePath) )
+			{
+				DBG("Shader bundle %s: %u shaders, %s, %.2f ms."
+					, bundlePath
+					, m_shaderBundle.getCount()
+					, m_shaderBundle.isMapped() ? "mapped" : "read"
+					, double(bx::getHPCounter() - bundleStart) * 1000.0 / double(bx::getHPFrequency() )
+					);
+			}
+			else
+			{
+				DBG("No shader bundle, loading shaders from separate files.");
+			}
+			m_programs.init(&m_shaderBundle);
+		}
+
+		// Compute version of the lower res gather caches tiles in groupshared memory.
+		// Only usable when blur size is packed in alpha of an image writable format.
+		const bgfx::Caps* caps = bgfx::getCaps();
+		m_computeGatherSupported = true
+			&& 0 != (caps->supported & BGFX_CAPS_COMPUTE)
+			&& 0 != (caps->formats[bgfx::TextureFormat::RGBA16F] & BGFX_CAPS_FORMAT_TEXTURE_IMAGE_WRITE)
+			;
+		m_useComputeGather = m_computeGatherSupported;
+
+		// Multi-view runs the dof chain over layers of array targets in compute
+		const uint16_t imageWrite = BGFX_CAPS_FORMAT_TEXTURE_IMAGE_WRITE;
+		m_multiviewSupported = m_computeGatherSupported
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_2D_ARRAY)
+			&& 0 != (caps->formats[bgfx::TextureFormat::R32F] & imageWrite)
+			&& 0 != (caps->formats[bgfx::TextureFormat::RGBA8] & imageWrite)
+			&& MULTIVIEW_MAX_LAYERS <= caps->limits.maxTextureLayers
+			;
+
+		// Depth pyramid reduces in compute and reads back a small level for cpu queries
+		const uint16_t imageRead = BGFX_CAPS_FORMAT_TEXTURE_IMAGE_READ;
+		m_depthPyramidSupported = true
+			&& 0 != (caps->supported & BGFX_CAPS_COMPUTE)
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_BLIT)
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+			&& 0 != (caps->formats[bgfx::TextureFormat::RG32F] & imageRead)
+			&& 0 != (caps->formats[bgfx::TextureFormat::RG32F] & imageWrite)
+			;
+		if (m_depthPyramidSupported)
+		{
+			m_depthPyramid.initReadback();
+		}
+
+		if (0 != m_verifyDepthPyramidFrames)
+		{
+			m_useDepthPyramid = true;
+			m_depthPyramid.m_verify = true;
+			if (!m_depthPyramidSupported)
+			{
+				DBG("Depth pyramid verify: not supported by renderer, FAILED");
+				m_exitCode = 1;
+				m_exitAfterInit = true;
+			}
+		}
+
+		// Autofocus reduces depth on gpu and reads back the result a few frames later
+		m_autofocusSupported = 0 != (caps->supported & BGFX_CAPS_TEXTURE_BLIT)
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+			&& 0 != (caps->formats[bgfx::TextureFormat::RG32F] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER)
+			;
+		if (m_autofocusSupported)
+		{
+			const uint64_t pointFlags = 0
+				| BGFX_TEXTURE_RT
+				| BGFX_SAMPLER_POINT
+				| BGFX_SAMPLER_U_CLAMP
+				| BGFX_SAMPLER_V_CLAMP
+				;
+			m_autofocusReduce.init(AUTOFOCUS_GRID_SIZE, AUTOFOCUS_GRID_SIZE, bgfx::TextureFormat::RG32F, pointFlags);
+			m_autofocusReadback.init(AUTOFOCUS_GRID_SIZE, AUTOFOCUS_GRID_SIZE, bgfx::TextureFormat::RG32F, 2*sizeof(float) );
+		}
+		m_autofocusPoint = m_focusPoint;
+
+		// Tap count debug views sum counts on gpu, totals are read back the same way
+		m_tapCountReadbackSupported = 0 != (caps->supported & BGFX_CAPS_TEXTURE_BLIT)
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+			;
+		if (m_tapCountReadbackSupported)
+		{
+			m_tapCountReadback.init(BokehDof::TapCountTotalsSize, BokehDof::TapCountTotalsSize, bgfx::TextureFormat::RGBA32F, 4*sizeof(float) );
+		}
+
+		// Capture copies final image to read back textures, same requirements
+		m_captureSupported = 0 != (caps->supported & BGFX_CAPS_TEXTURE_BLIT)
+			&& 0 != (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+			;
+		m_outputFrameBuffer.idx = bgfx::kInvalidHandle;
+
+		// Verify low precision blur size encoding before any format set can be picked,
+		// failures are logged per format and max blur size
+		if (!m_exitAfterInit)
+		{
+			testBlurSizeEncodingRange();
+		}
 
-		// Create program from shaders.
-		m_forwardProgram			= loadProgram("vs_bokeh_forward",		"fs_bokeh_forward");
-		m_gridProgram				= loadProgram("vs_bokeh_forward",		"fs_bokeh_forward_grid");
-		m_copyProgram				= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_copy");
-		m_copyLinearToGammaProgram	= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_copy_linear_to_gamma");
-		m_linearDepthProgram		= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_linear_depth");
-		m_dofSinglePassProgram		= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_dof_single_pass");
-		m_dofDownsampleProgram		= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_dof_downsample");
-		m_dofQuarterProgram			= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_dof_second_pass");
-		m_dofCombineProgram			= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_dof_combine");
-		m_dofDebugProgram			= loadProgram("vs_bokeh_screenquad",	"fs_bokeh_dof_debug");
-
-		// Load some meshes
+		// Load meshes and textures in the background, scene draws with placeholders
+		// until they land
+		// files are relative to the entry current dir, workers need the same one
+		const char* assetDir = cmdLine.findOption("asset-dir", "");
+		if ('\0' != assetDir[0])
+		{
+			entry::setCurrentDir(assetDir);
+		}
+		m_assetLoader.init(assetDir);
 		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
 		{
-			m_meshes[ii] = meshLoad(s_meshPaths[ii]);
+			m_meshAssets[ii] = m_assetLoader.requestMesh(s_meshPaths[ii]);
+			m_meshes[ii] = NULL;
 		}
 
-		m_groundTexture = loadTexture("textures/fieldstone-rgba.dds");
-		m_normalTexture = loadTexture("textures/fieldstone-n.dds");
+		m_groundTextureAsset = m_assetLoader.requestTexture("textures/fieldstone-rgba.dds");
+		m_normalTextureAsset = m_assetLoader.requestTexture("textures/fieldstone-n.dds");
+
+		{
+			const uint32_t grey = 0xff808080;
+			const uint32_t flatNormal = 0xffff8080;
+			m_groundPlaceholder = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, 0, bgfx::copy(&grey, sizeof(grey) ) );
+			m_normalPlaceholder = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, 0, bgfx::copy(&flatNormal, sizeof(flatNormal) ) );
+			m_groundTexture = m_groundPlaceholder;
+			m_normalTexture = m_normalPlaceholder;
+		}
 
 		m_recreateFrameBuffers = false;
 		createFramebuffers();
@@ -302,10 +2524,6 @@ public:
 		cameraGetViewMtx(m_view);
 		bx::mtxProj(m_proj, m_fovY, float(m_size[0]) / float(m_size[1]), 0.01f, 100.0f,  bgfx::getCaps()->homogeneousDepth);
 
-		// Get renderer capabilities info.
-		const bgfx::RendererType::Enum renderer = bgfx::getRendererType();
-		m_texelHalf = bgfx::RendererType::Direct3D9 == renderer ? 0.5f : 0.0f;
-
 		m_bokehTexture.idx = bgfx::kInvalidHandle;
 		updateDisplayBokehTexture(m_radiusScale, m_maxBlurSize, m_lobeCount, (1.0f-m_lobePinch), 1.0f, m_lobeRotation);
 
@@ -314,48 +2532,70 @@ public:
 
 	int32_t shutdown() override
 	{
-		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+		// owns loaded meshes and textures
+		m_assetLoader.shutdown();
+
+		bgfx::destroy(m_normalPlaceholder);
+		bgfx::destroy(m_groundPlaceholder);
+		bgfx::destroy(m_bokehTexture);
+
+		m_programs.destroy();
+		m_shaderBundle.destroyShaders();
+		if (m_autofocusSupported)
 		{
-			meshUnload(m_meshes[ii]);
+			m_autofocusReduce.destroy();
+			m_autofocusReadback.destroy();
 		}
 
-		bgfx::destroy(m_normalTexture);
-		bgfx::destroy(m_groundTexture);
-		bgfx::destroy(m_bokehTexture);
+		if (m_depthPyramidSupported)
+		{
+			m_depthPyramid.destroyReadback();
+		}
 
-		bgfx::destroy(m_forwardProgram);
-		bgfx::destroy(m_gridProgram);
-		bgfx::destroy(m_copyProgram);
-		bgfx::destroy(m_copyLinearToGammaProgram);
-		bgfx::destroy(m_linearDepthProgram);
-		bgfx::destroy(m_dofSinglePassProgram);
-		bgfx::destroy(m_dofDownsampleProgram);
-		bgfx::destroy(m_dofQuarterProgram);
-		bgfx::destroy(m_dofCombineProgram);
-		bgfx::destroy(m_dofDebugProgram);
+		if (m_tapCountReadbackSupported)
+		{
+			m_tapCountReadback.destroy();
+		}
 
 		m_uniforms.destroy();
 		m_modelUniforms.destroy();
+		m_autofocusUniforms.destroy();
+		m_multiviewUniforms.destroy();
+		m_depthPyramidUniforms.destroy();
+		m_multiviewTargets.destroy();
 
 		bgfx::destroy(s_albedo);
 		bgfx::destroy(s_color);
 		bgfx::destroy(s_normal);
 		bgfx::destroy(s_depth);
 		bgfx::destroy(s_blurredColor);
+		bgfx::destroy(s_blurSize);
 
 		destroyFramebuffers();
+		m_bokehDof.destroy();
 
 		cameraDestroy();
 
 		imguiDestroy();
 
+		shutdownCapture();
+
 		bgfx::shutdown();
 
-		return 0;
+		// read backs still in flight land before bgfx::shutdown returns
+		m_capture.releaseMemory();
+		m_shaderBundle.close();
+
+		return m_exitCode;
 	}
 
 	bool update() override
 	{
+		if (m_exitAfterInit)
+		{
+			return false;
+		}
+
 		if (!entry::processEvents(m_width, m_height, m_debug, m_reset, &m_mouseState))
 		{
 			// skip processing when minimized, otherwise crashing
@@ -393,6 +2633,24 @@ public:
 			// Update camera
 			cameraUpdate(deltaTime*0.15f, m_mouseState);
 
+			// middle click adds a point of interest for autofocus
+			const bool middleButton = 0 != m_mouseState.m_buttons[entry::MouseButton::Middle];
+			if (middleButton
+			&&  !m_middleButtonDown
+			&&  m_autofocusPointCount < AUTOFOCUS_MAX_POINTS)
+			{
+				AutofocusPoint& point = m_autofocusPoints[m_autofocusPointCount++];
+				point.m_uv[0] = float(m_mouseState.m_mx) / float(m_width);
+				point.m_uv[1] = float(m_mouseState.m_my) / float(m_height);
+				point.m_radius = 0.02f;
+				point.m_weight = 1.0f;
+			}
+			m_middleButtonDown = middleButton;
+
+			updateAutofocus(deltaTime);
+			updateRenderScale(deltaTime);
+			updateAssets();
+
 			cameraGetViewMtx(m_view);
 
 			updateUniforms();
@@ -402,7 +2660,11 @@ public:
 
 			bgfx::ViewId view = 0;
 
+			// multi-view renders its own cameras into array targets, see drawMultiview()
+			const bool multiview = m_multiviewSupported && m_useMultiview;
+
 			// Draw models into scene
+			if (!multiview)
 			{
 				bgfx::setViewName(view, "forward scene");
 				bgfx::setViewClear(view
@@ -412,7 +2674,8 @@ public:
 					, 0
 				);
 
-				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+				// render scale only shrinks the viewport, targets keep their max size
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_renderSize[0]), uint16_t(m_renderSize[1]));
 				bgfx::setViewTransform(view, m_view, m_proj);
 				bgfx::setViewFrameBuffer(view, m_frameBuffer);
 
@@ -423,7 +2686,7 @@ public:
 					| BGFX_STATE_DEPTH_TEST_LESS
 					);
 
-				drawAllModels(view, m_forwardProgram, m_modelUniforms);
+				drawAllModels(view, m_programs.get(ProgramForward), m_modelUniforms);
 
 				++view;
 			}
@@ -438,9 +2701,10 @@ public:
 			}
 
 			// Convert depth to linear depth for shadow depth compare
+			if (!multiview)
 			{
 				bgfx::setViewName(view, "linear depth");
-				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_renderSize[0]), uint16_t(m_renderSize[1]));
 				bgfx::setViewTransform(view, NULL, orthoProj);
 				bgfx::setViewFrameBuffer(view, m_linearDepth.m_buffer);
 				bgfx::setState(0
@@ -449,17 +2713,70 @@ public:
 					| BGFX_STATE_DEPTH_TEST_ALWAYS
 					);
 				bgfx::setTexture(0, s_depth, m_frameBufferTex[FRAMEBUFFER_RT_DEPTH]);
-				m_uniforms.submit();
-				screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, caps->originBottomLeft);
-				bgfx::submit(view, m_linearDepthProgram);
+				m_uniforms.submitChanged();
+				setScreenTriangle(float(m_renderSize[0]), float(m_renderSize[1]), caps->originBottomLeft);
+				bgfx::submit(view, m_programs.get(ProgramLinearDepth));
 				++view;
 			}
 
+			// Min and max depth pyramid from the depth target, read back for cpu queries
+			if (m_depthPyramidSupported
+			&&  m_useDepthPyramid
+			&&  !multiview)
+			{
+				view = submitDepthPyramid(view);
+			}
+
+			// Reduce depth over focus region and queue read back, never waits
+			if (m_autofocusSupported
+			&&  AutofocusMode::Manual != m_autofocusMode
+			&&  !multiview)
+			{
+				view = submitAutofocus(view, orthoProj);
+			}
+
+			// when capturing, final passes render offscreen so the image can be copied
+			const bool capture = m_captureSupported
+				&& (m_captureContinuous || m_captureSingle)
+				&& m_capture.isInitialized()
+				&& m_capture.getWidth()  == m_size[0]
+				&& m_capture.getHeight() == m_size[1]
+				;
+			m_outputFrameBuffer.idx = bgfx::kInvalidHandle;
+			if (capture)
+			{
+				m_outputFrameBuffer = m_captureTarget.m_buffer;
+			}
+
 			// optionally, apply dof
 			const bool useOrDebugDof = m_useBokehDof || m_showDebugVisualization;
-			if (useOrDebugDof)
+			if (multiview)
 			{
-				view = drawDepthOfField(view, m_frameBufferTex[FRAMEBUFFER_RT_COLOR], orthoProj, caps->originBottomLeft);
+				view = drawMultiview(view, orthoProj, caps->originBottomLeft);
+			}
+			else if (useOrDebugDof)
+			{
+				// view setup is cheap and follows the capture target switching output
+				m_dofViewBegin = view;
+				m_bokehDof.setupViews(view, m_outputFrameBuffer);
+
+				bgfx::Encoder* encoder = bgfx::begin();
+				m_bokehDof.submit(encoder, view, m_frameBufferTex[FRAMEBUFFER_RT_COLOR], m_linearDepth.m_texture, m_dofParams);
+				bgfx::end(encoder);
+
+				view += BokehDof::ViewCount;
+				m_dofViewEnd = view;
+
+				// totals of the tap count debug views, blitted in a view after they're written
+				if (isTapCountViewActive() )
+				{
+					bgfx::setViewName(view, "dof tap count read back");
+					if (!m_tapCountReadback.request(view, m_bokehDof.getTapCountTotals() ) )
+					{
+						++m_tapCountSkipped;
+					}
+					++view;
+				}
 			}
 			else
 			{
@@ -473,15 +2790,38 @@ public:
 
 				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
 				bgfx::setViewTransform(view, NULL, orthoProj);
-				bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
+				bgfx::setViewFrameBuffer(view, m_outputFrameBuffer);
 				bgfx::setState(0
 					| BGFX_STATE_WRITE_RGB
 					| BGFX_STATE_WRITE_A
 					);
 				bgfx::setTexture(0, s_color, m_frameBufferTex[FRAMEBUFFER_RT_COLOR]);
-				screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, caps->originBottomLeft);
-				bgfx::submit(view, m_copyLinearToGammaProgram);
+				setScreenTriangle(float(m_width), float(m_height), caps->originBottomLeft);
+				bgfx::submit(view, m_programs.get(ProgramCopyLinearToGamma));
+				++view;
+			}
+
+			if (capture)
+			{
+				bgfx::setViewName(view, "capture display");
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+				bgfx::setViewTransform(view, NULL, orthoProj);
+				bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
+				bgfx::setState(0
+					| BGFX_STATE_WRITE_RGB
+					| BGFX_STATE_WRITE_A
+					);
+				bgfx::setTexture(0, s_color, m_captureTarget.m_texture);
+				setScreenTriangle(float(m_width), float(m_height), caps->originBottomLeft);
+				bgfx::submit(view, m_programs.get(ProgramCopy));
+				++view;
+
+				// blits happen before draws within a view, copy in the next one
+				bgfx::setViewName(view, "capture read back");
+				m_capture.request(view, m_captureTarget.m_texture, CaptureFormat::Enum(m_captureFormat) );
 				++view;
+
+				m_captureSingle = false;
 			}
 
 			// Draw UI
@@ -526,6 +2866,47 @@ public:
 					ImGui::EndTooltip();
 				}
 
+				if (m_bokehDof.isMixedResolutionSupported() )
+				{
+					ImGui::Checkbox("use mixed resolution", &m_useMixedResolution);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("pick full, half or quarter res per 16x16 tile from the");
+						ImGui::Text("largest blur size reaching it, crossfading between levels");
+						ImGui::EndTooltip();
+					}
+
+					if (m_useMixedResolution)
+					{
+						ImGui::SliderFloat("half res above", &m_mixedHalfThreshold, 0.0f, 10.0f);
+						ImGui::SliderFloat("quarter res above", &m_mixedQuarterThreshold, m_mixedHalfThreshold + m_mixedBlendWidth, 40.0f);
+						ImGui::SliderFloat("level blend width", &m_mixedBlendWidth, 0.5f, 8.0f);
+						if (ImGui::IsItemHovered())
+							ImGui::SetTooltip("tile max blur size, in pixels, over which levels crossfade");
+					}
+				}
+				else
+				{
+					ImGui::Text("mixed resolution needs rgba16f format set");
+				}
+
+				if (m_computeGatherSupported)
+				{
+					ImGui::Checkbox("use compute gather", &m_useComputeGather);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("lower res gather in a compute shader, caching each tile");
+						ImGui::Text("plus halo in groupshared memory. needs rgba16f format set");
+						ImGui::EndTooltip();
+					}
+				}
+				else
+				{
+					ImGui::Text("compute gather not supported");
+				}
+
 				ImGui::Checkbox("show debug vis", &m_showDebugVisualization);
 				if (ImGui::IsItemHovered())
 				{
@@ -534,50 +2915,356 @@ public:
 					ImGui::Text("increasing foreground blur. from grey to blue in background");
 					ImGui::EndTooltip();
 				}
+
+				if (m_showDebugVisualization)
+				{
+					if (m_bokehDof.isTapCountSupported() )
+					{
+						const char* debugViews[BokehDofDebugView::Count] = { "circle of confusion", "executed taps", "contributing taps", "wasted taps" };
+						ImGui::Combo("debug view", &m_debugView, debugViews, BokehDofDebugView::Count);
+						if (ImGui::IsItemHovered())
+						{
+							ImGui::BeginTooltip();
+							ImGui::Text("heatmap of taps per pixel of the selected gather mode, up to");
+							ImGui::Text("the full single pass spiral. lower res taps are shared by the");
+							ImGui::Text("pixels they cover. contributing taps have weight, wasted taps");
+							ImGui::Text("lie past the largest blur size among the texel's own samples");
+							ImGui::EndTooltip();
+						}
+
+						if (BokehDofDebugView::CircleOfConfusion != m_debugView)
+						{
+							if (m_tapCountReadbackSupported)
+							{
+								const float* totals = m_tapCountTotals;
+								const float pixels = bx::max(totals[3], 1.0f);
+								const float executed = bx::max(totals[0], 1.0f);
+								ImGui::Text("executed taps: %.2f M, %.1f per pixel", totals[0] / 1000000.0f, totals[0] / pixels);
+								ImGui::Text("contributing taps: %.1f per pixel, %.1f%%", totals[1] / pixels, 100.0f * totals[1] / executed);
+								ImGui::Text("wasted taps: %.1f per pixel, %.1f%%", totals[2] / pixels, 100.0f * totals[2] / executed);
+								ImGui::Text("read backs skipped: %u", m_tapCountSkipped);
+							}
+							else
+							{
+								ImGui::Text("totals need blit and read back");
+							}
+						}
+					}
+					else
+					{
+						ImGui::Text("tap count views need float render targets");
+					}
+				}
 				ImGui::Separator();
 
 				bool isChanged = false;
 
 				ImGui::Text("blur controls:");
-				isChanged |= ImGui::SliderFloat("max blur size", &m_maxBlurSize, 10.0f, 50.0f);
+				isChanged |= ImGui::SliderFloat("max blur size", &m_maxBlurSize, kMaxBlurSizeMin, kMaxBlurSizeMax);
 				if (ImGui::IsItemHovered())
 					ImGui::SetTooltip("maximum blur size in screen pixels");
 
 				ImGui::SliderFloat("focusPoint", &m_focusPoint, 1.0f, 20.0f);
 				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("distance to focus plane");
+					ImGui::SetTooltip("distance to focus plane, when autofocus is off");
+
+				ImGui::SliderFloat("focusScale", &m_focusScale, 0.0f, 10.0f);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("multiply focus calculation, larger=tighter focus");
+				ImGui::Separator();
+
+				ImGui::Text("autofocus:");
+				if (m_autofocusSupported)
+				{
+					const char* autofocusModes[AutofocusMode::Count] = { "manual", "center region", "points of interest" };
+					ImGui::Combo("mode", &m_autofocusMode, autofocusModes, AutofocusMode::Count);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("reduce depth on gpu and read back a few frames later.");
+						ImGui::Text("middle click to add a point of interest");
+						ImGui::EndTooltip();
+					}
+
+					ImGui::SliderFloat("region size", &m_autofocusRegionSize, 0.05f, 1.0f);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("fraction of screen covered by center region");
+
+					ImGui::SliderFloat("focus smoothing", &m_autofocusSmoothTime, 0.01f, 2.0f);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("critically damped spring time, in seconds");
+
+					ImGui::Text("points of interest: %d", m_autofocusPointCount);
+					ImGui::SameLine();
+					if (ImGui::Button("clear") )
+					{
+						m_autofocusPointCount = 0;
+					}
+
+					ImGui::Text("focus distance: %.2f (target %.2f)", m_autofocusPoint, m_autofocusTarget);
+					ImGui::Text("read backs skipped: %u", m_autofocusSkipped);
+				}
+				else
+				{
+					ImGui::Text("not supported, needs blit and read back");
+				}
+				ImGui::Separator();
+
+				ImGui::Text("depth pyramid:");
+				if (m_depthPyramidSupported)
+				{
+					ImGui::Checkbox("build depth pyramid", &m_useDepthPyramid);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("min and max linear depth mips from the depth target.");
+						ImGui::Text("a small level is read back for cpu queries");
+						ImGui::EndTooltip();
+					}
+
+					float minDepth;
+					float maxDepth;
+					if (m_depthPyramid.queryBounds(&minDepth, &maxDepth, 0.0f, 0.0f, 1.0f, 1.0f) )
+					{
+						ImGui::Text("frame depth: %.2f to %.2f", minDepth, maxDepth);
+
+						const float halfSize = 0.5f * m_autofocusRegionSize;
+						m_depthPyramid.queryBounds(&minDepth, &maxDepth, 0.5f - halfSize, 0.5f - halfSize, 0.5f + halfSize, 0.5f + halfSize);
+						ImGui::Text("center region: %.2f to %.2f", minDepth, maxDepth);
+					}
+
+					ImGui::Text("levels: %u, read back level %u", m_depthPyramid.m_levelCount, m_depthPyramid.m_readbackLevel);
+
+					ImGui::Checkbox("verify against cpu", &m_depthPyramid.m_verify);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("also read back a level two finer, reduce it on cpu");
+						ImGui::Text("and compare with the gpu level exactly");
+						ImGui::EndTooltip();
+					}
+
+					if (m_depthPyramid.isVerifying() )
+					{
+						ImGui::Text("verified frames: %u, mismatches: %u", m_depthPyramid.m_verifiedFrames, m_depthPyramid.m_mismatchFrames);
+					}
+				}
+				else
+				{
+					ImGui::Text("not supported, needs compute, rg32f images and read back");
+				}
+				ImGui::Separator();
+
+				ImGui::Text("bokeh shape and sample controls:");
+				isChanged |= ImGui::SliderFloat("radiusScale", &m_radiusScale, 0.5f, 4.0f);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("controls number of samples taken");
+
+				isChanged |= ImGui::SliderInt("lobe count", &m_lobeCount, 1, 8);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("using triangle lobes to emulate aperture blades");
+
+				isChanged |= ImGui::SliderFloat("lobe pinch", &m_lobePinch, 0.0f, 1.0f);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("adjust lobe shape, 0=round, 1=starry");
+
+				isChanged |= ImGui::SliderFloat("lobe rotation", &m_lobeRotation, -1.0f, 1.0f);
+
+				if (isChanged)
+				{
+					updateDisplayBokehTexture(m_radiusScale, m_maxBlurSize, m_lobeCount, (1.0f-m_lobePinch), 1.0f, m_lobeRotation);
+				}
+
+				ImGui::Text("number of samples taken: %d", m_sampleCount);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("number of sample taps as determined by radiusScale and maxBlurSize");
+
+
+				ImGui::Image(m_bokehTexture, ImVec2(128.0f, 128.0f) );
+				ImGui::Separator();
+
+				ImGui::Text("intermediate formats:");
+				const char* formatNames[IntermediateFormat::Count];
+				for (uint32_t ii = 0; ii < IntermediateFormat::Count; ++ii)
+				{
+					formatNames[ii] = getIntermediateFormatInfo(IntermediateFormat::Enum(ii) ).m_name;
+				}
+
+				if (ImGui::Combo("format set", &m_intermediateFormat, formatNames, IntermediateFormat::Count) )
+				{
+					m_recreateFrameBuffers = true;
+				}
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::BeginTooltip();
+					ImGui::Text("formats for scene color and lower res dof targets. compact");
+					ImGui::Text("color formats store signed blur size in a separate target");
+					ImGui::EndTooltip();
+				}
+
+				if (m_activeIntermediateFormat != m_intermediateFormat)
+				{
+					ImGui::Text("not supported, using %s", getIntermediateFormatInfo(IntermediateFormat::Enum(m_activeIntermediateFormat) ).m_name);
+				}
 
-				ImGui::SliderFloat("focusScale", &m_focusScale, 0.0f, 10.0f);
-				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("multiply focus calculation, larger=tighter focus");
-				ImGui::Separator();
+				{
+					const IntermediateFormatInfo& formats = getIntermediateFormatInfo(IntermediateFormat::Enum(m_activeIntermediateFormat) );
+					const uint32_t dofBytes = formats.m_colorBytes + formats.m_blurSizeBytes;
 
-				ImGui::Text("bokeh shape and sample controls:");
-				isChanged |= ImGui::SliderFloat("radiusScale", &m_radiusScale, 0.5f, 4.0f);
-				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("controls number of samples taken");
+					ImGui::Text("bytes per pixel: scene %u, dof %u", formats.m_colorBytes, dofBytes);
+					ImGui::Text("dof gpu memory: %.2f MB", float(m_bokehDof.getGpuMemorySize() ) / (1024.0f*1024.0f) );
+				}
 
-				isChanged |= ImGui::SliderInt("lobe count", &m_lobeCount, 1, 8);
-				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("using triangle lobes to emulate aperture blades");
+				ImGui::Separator();
+				ImGui::Text("multi-view:");
+				if (m_multiviewSupported)
+				{
+					ImGui::Checkbox("render several cameras", &m_useMultiview);
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("render cameras into layers of array targets, then run");
+						ImGui::Text("each dof pass over all layers in a single dispatch");
+						ImGui::EndTooltip();
+					}
+
+					if (m_useMultiview)
+					{
+						ImGui::SliderInt("cameras", &m_multiviewLayerCount, 1, MULTIVIEW_MAX_LAYERS);
+						ImGui::SliderFloat("camera spacing", &m_multiviewCameraSpacing, 0.0f, 4.0f);
+						ImGui::SliderFloat("focus spread", &m_multiviewFocusSpread, 0.0f, 4.0f);
+						if (ImGui::IsItemHovered())
+							ImGui::SetTooltip("offset focus distance of each camera, from uniform array");
+
+						ImGui::Checkbox("run as independent copies", &m_multiviewIndependent);
+						if (ImGui::IsItemHovered())
+						{
+							ImGui::BeginTooltip();
+							ImGui::Text("dispatch the chain once per camera instead of once for");
+							ImGui::Text("all, to measure scaling against separate runs");
+							ImGui::EndTooltip();
+						}
+
+						ImGui::Text("dof views %d, submit %.3f ms", int32_t(m_dofViewEnd - m_dofViewBegin), m_multiviewSubmitMs);
+						if (m_profilePasses)
+						{
+							ImGui::Text("gpu batched %.3f ms", m_multiviewGpuMs[0]);
+							ImGui::Text("gpu independent %.3f ms", m_multiviewGpuMs[1]);
+						}
+						else
+						{
+							ImGui::Text("enable profile passes for gpu times");
+						}
+					}
+				}
+				else
+				{
+					ImGui::Text("not supported, needs compute and texture arrays");
+				}
 
-				isChanged |= ImGui::SliderFloat("lobe pinch", &m_lobePinch, 0.0f, 1.0f);
+				ImGui::Separator();
+				ImGui::Text("render scale:");
+				ImGui::Checkbox("dynamic resolution", &m_dynamicResolution);
 				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("adjust lobe shape, 0=round, 1=starry");
+				{
+					ImGui::BeginTooltip();
+					ImGui::Text("scale scene rendering to meet frame time target. dof");
+					ImGui::Text("combine pass upscales the sharp layer, depth aware");
+					ImGui::EndTooltip();
+				}
 
-				isChanged |= ImGui::SliderFloat("lobe rotation", &m_lobeRotation, -1.0f, 1.0f);
+				if (m_dynamicResolution)
+				{
+					ImGui::SliderFloat("frame time target", &m_targetFrameTimeMs, 2.0f, 33.0f, "%.1f ms");
+					ImGui::SliderFloat("min scale", &m_minRenderScale, 0.25f, 1.0f);
+					ImGui::Text("frame time %.2f ms", m_frameTimeMs);
+				}
+				else
+				{
+					ImGui::SliderFloat("scale", &m_renderScale, m_minRenderScale, 1.0f);
+				}
+				ImGui::Text("rendering %dx%d (%.0f%%)", m_renderSize[0], m_renderSize[1], m_renderScale * 100.0f);
 
-				if (isChanged)
+				ImGui::Separator();
+				ImGui::Text("capture:");
+				if (m_captureSupported)
 				{
-					updateDisplayBokehTexture(m_radiusScale, m_maxBlurSize, m_lobeCount, (1.0f-m_lobePinch), 1.0f, m_lobeRotation);
+					ImGui::Checkbox("capture frames", &m_captureContinuous);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("write every frame to disk from a background thread");
+
+					ImGui::SameLine();
+					if (ImGui::Button("single") )
+					{
+						m_captureSingle = true;
+					}
+
+					const char* captureFormats[CaptureFormat::Count] = { "png", "raw rgba8", "exr half" };
+					ImGui::Combo("capture format", &m_captureFormat, captureFormats, CaptureFormat::Count);
+
+					ImGui::Text("requested %u, written %u", m_capture.getRequested(), m_capture.getWritten() );
+					ImGui::Text("dropped %u, failed %u", m_capture.getDropped(), m_capture.getFailed() );
+					ImGui::Text("encode: %.1f ms, buffers %.1f MB"
+						, m_capture.getEncodeTimeMs()
+						, m_capture.isInitialized() ? float(CAPTURE_BUFFER_COUNT * m_capture.getBufferSize() ) / (1024.0f*1024.0f) : 0.0f
+						);
+				}
+				else
+				{
+					ImGui::Text("not supported, needs blit and read back");
 				}
+				ImGui::Separator();
 
-				ImGui::Text("number of samples taken: %d", m_sampleCount);
+				if (ImGui::Checkbox("profile passes", &m_profilePasses) )
+				{
+					m_debug = m_profilePasses
+						? (m_debug |  BGFX_DEBUG_PROFILER)
+						: (m_debug & ~BGFX_DEBUG_PROFILER)
+						;
+					bgfx::setDebug(m_debug);
+				}
 				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("number of sample taps as determined by radiusScale and maxBlurSize");
+					ImGui::SetTooltip("measure gpu time of each dof pass");
 
+				if (m_profilePasses)
+				{
+					const bgfx::Stats* stats = bgfx::getStats();
+					float totalMs = 0.0f;
+
+					for (bgfx::ViewId ii = m_dofViewBegin; ii < m_dofViewEnd; ++ii)
+					{
+						const float passMs = getViewGpuTimeMs(stats, ii);
+						totalMs += passMs;
+
+						for (uint16_t jj = 0; jj < stats->numViews; ++jj)
+						{
+							if (stats->viewStats[jj].view == ii)
+							{
+								ImGui::Text("%s: %.3f ms", stats->viewStats[jj].name, passMs);
+								break;
+							}
+						}
+					}
+
+					ImGui::Text("dof total: %.3f ms", totalMs);
+				}
+			}
 
-				ImGui::Image(m_bokehTexture, ImVec2(128.0f, 128.0f) );
+			ImGui::Separator();
+			ImGui::Text("assets:");
+			m_assetLoader.showTimings();
+			if (0.0f < m_assetLoader.getAllReadyMs() )
+			{
+				ImGui::Text("all loaded after %.1f ms", m_assetLoader.getAllReadyMs() );
+			}
+			ImGui::Text("startup to first frame: %.1f ms", m_startupTimeMs);
+			ImGui::Text("%u programs created in %.2f ms", m_programs.getLoadedCount(), m_programs.getLoadTimeMs() );
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::BeginTooltip();
+				ImGui::Text("programs are created on first use, shaders come");
+				ImGui::Text("from %s", m_shaderBundle.isOpen() ? "the shader bundle" : "separate files");
+				ImGui::EndTooltip();
 			}
 
 			ImGui::End();
@@ -588,6 +3275,73 @@ public:
 			// process submitted rendering primitives.
 			m_currFrame = bgfx::frame();
 
+			// includes programs created lazily while recording the first frame
+			if (0.0f == m_startupTimeMs)
+			{
+				m_startupTimeMs = float(double(bx::getHPCounter() - m_startupTime) * 1000.0 / double(bx::getHPFrequency() ) );
+				DBG("Startup to first frame: %.1f ms, %u programs created in %.2f ms from %s."
+					, m_startupTimeMs
+					, m_programs.getLoadedCount()
+					, m_programs.getLoadTimeMs()
+					, m_shaderBundle.isOpen() ? "shader bundle" : "separate files"
+					);
+			}
+
+			// landed depth pyramid read backs become the data for cpu queries
+			if (m_depthPyramidSupported)
+			{
+				m_depthPyramid.update(m_currFrame);
+			}
+
+			// read backs still in flight are dropped, only landed frames count
+			if (0 != m_verifyDepthPyramidFrames
+			&&  0 == --m_verifyDepthPyramidFrames)
+			{
+				const bool passed = true
+					&& 0 != m_depthPyramid.m_verifiedFrames
+					&& 0 == m_depthPyramid.m_mismatchFrames
+					;
+				DBG("Depth pyramid verify: %u frames checked, %u mismatches, %s"
+					, m_depthPyramid.m_verifiedFrames
+					, m_depthPyramid.m_mismatchFrames
+					, passed ? "passed" : "FAILED"
+					);
+				m_exitCode = passed ? 0 : 1;
+				return false;
+			}
+
+			if (m_tapCountReadbackSupported)
+			{
+				updateTapCountTotals();
+			}
+
+			// hand landed captures to encoder thread. read backs, buffers and encoder
+			// thread only exist while a capture is wanted, recreated at new size once idle
+			if (m_captureSupported)
+			{
+				m_capture.update(m_currFrame);
+
+				if (m_captureContinuous || m_captureSingle)
+				{
+					if (!m_capture.isInitialized() )
+					{
+						initCapture(caps->originBottomLeft);
+					}
+					else if ( (m_capture.getWidth() != m_size[0] || m_capture.getHeight() != m_size[1])
+						 &&  m_capture.isIdle() )
+					{
+						shutdownCapture();
+					}
+				}
+				else if (m_capture.isInitialized()
+					 &&  m_capture.isIdle() )
+				{
+					// nothing pending on gpu once idle, memory can go right away
+					shutdownCapture();
+					m_capture.releaseMemory();
+				}
+			}
+
 			return true;
 		}
 
@@ -650,7 +3404,10 @@ public:
 				_uniforms.m_color[2] = b;
 				_uniforms.submit();
 
-				meshSubmit(m_meshes[MeshHollowCube], _pass, _program, mtx);
+				if (NULL != m_meshes[MeshHollowCube])
+				{
+					meshSubmit(m_meshes[MeshHollowCube], _pass, _program, mtx);
+				}
 			}
 		}
 
@@ -676,120 +3433,424 @@ public:
 			_uniforms.m_color[2] = 0.5f;
 			_uniforms.submit();
 
-			meshSubmit(m_meshes[MeshCube], _pass, m_gridProgram, mtx);
+			if (NULL != m_meshes[MeshCube])
+			{
+				meshSubmit(m_meshes[MeshCube], _pass, m_programs.get(ProgramGrid), mtx);
+			}
 		}
 	}
 
-	bgfx::ViewId drawDepthOfField(bgfx::ViewId _pass, bgfx::TextureHandle _colorTexture, float* _orthoProj, bool _originBottomLeft)
+	// Render several cameras into layers of array targets and apply dof to all of them.
+	// Batched, each pass is a single dispatch over all layers. As independent copies,
+	// each camera runs its own chain of views and dispatches, for comparison.
+	bgfx::ViewId drawMultiview(bgfx::ViewId _pass, float* _orthoProj, bool _originBottomLeft)
 	{
 		bgfx::ViewId view = _pass;
-		bgfx::TextureHandle lastTex = _colorTexture;
 
-		if (m_showDebugVisualization)
+		// gpu stats are from previous frame, credit them to the mode that ran then
+		if (m_profilePasses
+		&&  m_dofViewBegin < m_dofViewEnd)
 		{
-			bgfx::setViewName(view, "bokeh dof debug pass");
-			bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
-			bgfx::setViewTransform(view, NULL, _orthoProj);
-			bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_DEPTH_TEST_ALWAYS
-				);
-			bgfx::setTexture(0, s_color, lastTex);
-			bgfx::setTexture(1, s_depth, m_linearDepth.m_texture);
-			m_uniforms.submit();
-			screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, _originBottomLeft);
-			bgfx::submit(view, m_dofDebugProgram);
-			++view;
+			const bgfx::Stats* stats = bgfx::getStats();
+			float totalMs = 0.0f;
+			for (bgfx::ViewId ii = m_dofViewBegin; ii < m_dofViewEnd; ++ii)
+			{
+				totalMs += getViewGpuTimeMs(stats, ii);
+			}
+
+			float& smoothedMs = m_multiviewGpuMs[m_multiviewRanIndependent ? 1 : 0];
+			smoothedMs = bx::lerp(smoothedMs, totalMs, 0.1f);
 		}
-		else if (m_useSinglePassBokehDof)
+
+		const uint16_t layerCount = uint16_t(m_multiviewLayerCount);
+		const uint16_t gridColumns = uint16_t(bx::ceil(bx::sqrt(float(layerCount) ) ) );
+		const uint16_t gridRows = (layerCount + gridColumns - 1) / gridColumns;
+		const uint16_t width = uint16_t(bx::max(m_size[0] / gridColumns, 8) );
+		const uint16_t height = uint16_t(bx::max(m_size[1] / gridRows, 8) );
+
+		if (m_multiviewTargets.m_width != width
+		||  m_multiviewTargets.m_height != height
+		||  m_multiviewTargets.m_layerCount != layerCount)
 		{
-			bgfx::setViewName(view, "bokeh dof single pass");
-			bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
-			bgfx::setViewTransform(view, NULL, _orthoProj);
-			bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
+			m_multiviewTargets.destroy();
+			m_multiviewTargets.init(width, height, layerCount);
+		}
+
+		m_multiviewUniforms.m_layerCount = float(layerCount);
+		m_multiviewUniforms.m_gridColumns = float(gridColumns);
+		m_multiviewUniforms.m_gridRows = float(gridRows);
+
+		// each cell of the grid is one camera, same near and far so depth unpack is shared
+		float proj[16];
+		bx::mtxProj(proj, m_fovY, float(width) / float(height), 0.01f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+
+		for (uint16_t ii = 0; ii < layerCount; ++ii)
+		{
+			// cameras side by side along view space x, like a stereo pair or camera rig
+			const float offset = float(ii) - 0.5f * float(layerCount - 1);
+			float shift[16];
+			bx::mtxTranslate(shift, -offset * m_multiviewCameraSpacing, 0.0f, 0.0f);
+			float layerView[16];
+			bx::mtxMul(layerView, m_view, shift);
+
+			bgfx::setViewName(view, "multi-view forward");
+			bgfx::setViewClear(view
+				, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH
+				, 0x7fb8ffff // clear to a sky blue
+				, 1.0f
+				, 0
+			);
+			bgfx::setViewRect(view, 0, 0, width, height);
+			bgfx::setViewTransform(view, layerView, proj);
+			bgfx::setViewFrameBuffer(view, m_multiviewTargets.m_frameBuffers[ii]);
 			bgfx::setState(0
 				| BGFX_STATE_WRITE_RGB
 				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_DEPTH_TEST_ALWAYS
+				| BGFX_STATE_WRITE_Z
+				| BGFX_STATE_DEPTH_TEST_LESS
 				);
-			bgfx::setTexture(0, s_color, lastTex);
-			bgfx::setTexture(1, s_depth, m_linearDepth.m_texture);
-			m_uniforms.submit();
-			screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, _originBottomLeft);
-			bgfx::submit(view, m_dofSinglePassProgram);
+			drawAllModels(view, m_programs.get(ProgramForward), m_modelUniforms);
 			++view;
+
+			// per layer focus, spread around the shared focus point
+			float* layer = m_multiviewUniforms.m_layers[ii];
+			layer[0] = bx::max(m_uniforms.m_focusPoint + offset * m_multiviewFocusSpread, 0.5f);
+			layer[1] = m_uniforms.m_focusScale;
+			layer[2] = 0.0f;
+			layer[3] = 0.0f;
+		}
+
+		const int64_t submitStart = bx::getHPCounter();
+		m_dofViewBegin = view;
+
+		if (m_multiviewIndependent)
+		{
+			for (uint16_t ii = 0; ii < layerCount; ++ii)
+			{
+				view = submitMultiviewDof(view, ii, 1);
+			}
 		}
 		else
 		{
-			unsigned halfWidth = (m_width/2);
-			unsigned halfHeight = (m_height/2);
+			view = submitMultiviewDof(view, 0, layerCount);
+		}
 
-			bgfx::setViewName(view, "bokeh dof downsample");
-			bgfx::setViewRect(view, 0, 0, uint16_t(halfWidth), uint16_t(halfHeight));
-			bgfx::setViewTransform(view, NULL, _orthoProj);
-			bgfx::setViewFrameBuffer(view, m_dofQuarterInput.m_buffer);
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_DEPTH_TEST_ALWAYS
-				);
-			bgfx::setTexture(0, s_color, lastTex);
-			bgfx::setTexture(1, s_depth, m_linearDepth.m_texture);
-			m_uniforms.submit();
-			screenSpaceQuad(float(halfWidth), float(halfHeight), m_texelHalf, _originBottomLeft);
-			bgfx::submit(view, m_dofDownsampleProgram);
-			++view;
-			lastTex = m_dofQuarterInput.m_texture;
+		m_dofViewEnd = view;
+		m_multiviewRanIndependent = m_multiviewIndependent;
+		const float submitMs = float(double(bx::getHPCounter() - submitStart) * 1000.0 / double(bx::getHPFrequency() ) );
+		m_multiviewSubmitMs = bx::lerp(m_multiviewSubmitMs, submitMs, 0.1f);
+
+		bgfx::setViewName(view, "multi-view display");
+		bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+		bgfx::setViewTransform(view, NULL, _orthoProj);
+		bgfx::setViewFrameBuffer(view, m_outputFrameBuffer);
+		bgfx::setState(0
+			| BGFX_STATE_WRITE_RGB
+			| BGFX_STATE_WRITE_A
+			);
+		bgfx::setTexture(0, s_color, m_multiviewTargets.m_output);
+		m_multiviewUniforms.submit();
+		setScreenTriangle(float(m_width), float(m_height), _originBottomLeft);
+		bgfx::submit(view, m_programs.get(ProgramMultiviewDisplay));
+		++view;
 
-			/*
-				replace the copy with bokeh dof combine
-				able to read circle of confusion and color from downsample pass
-				along with full res color and depth?
-				do we need half res depth? i'm confused about that...
-			*/
+		return view;
+	}
 
-			bgfx::setViewName(view, "bokeh dof quarter");
-			bgfx::setViewRect(view, 0, 0, uint16_t(halfWidth), uint16_t(halfHeight));
-			bgfx::setViewTransform(view, NULL, _orthoProj);
-			bgfx::setViewFrameBuffer(view, m_dofQuarterOutput.m_buffer);
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_DEPTH_TEST_ALWAYS
-				);
-			bgfx::setTexture(0, s_color, lastTex);
-			m_uniforms.submit();
-			screenSpaceQuad(float(halfWidth), float(halfHeight), m_texelHalf, _originBottomLeft);
-			bgfx::submit(view, m_dofQuarterProgram);
-			++view;
-			lastTex = m_dofQuarterOutput.m_texture;
+	// min and max depth of what was rendered this frame, every level in one view
+	// as compute runs in submission order, then copy the read back level
+	bgfx::ViewId submitDepthPyramid(bgfx::ViewId _pass)
+	{
+		bgfx::ViewId view = _pass;
+		DepthPyramid& pyramid = m_depthPyramid;
+		DepthPyramidUniforms& uniforms = m_depthPyramidUniforms;
+		const bool originBottomLeft = bgfx::getCaps()->originBottomLeft;
+		pyramid.setRenderSize(uint16_t(m_renderSize[0]), uint16_t(m_renderSize[1]), originBottomLeft);
+
+		// rendered part is at the top of texture space when origin is bottom left
+		vec2Set(uniforms.m_sourceSize, float(pyramid.m_levelWidth[0]), float(pyramid.m_levelHeight[0]) );
+		vec2Set(uniforms.m_outputSize, float(pyramid.m_levelWidth[0]), float(pyramid.m_levelHeight[0]) );
+		vec2Set(uniforms.m_sourceOffset, 0.0f, originBottomLeft ? float(m_size[1] - m_renderSize[1]) : 0.0f);
+		vec2Set(uniforms.m_depthTexelSize, 1.0f / float(m_size[0]), 1.0f / float(m_size[1]) );
+
+		const uint32_t pointFlags = 0
+			| BGFX_SAMPLER_POINT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+
+		bgfx::setViewName(view, "depth pyramid");
+		bgfx::setTexture(0, s_depth, m_frameBufferTex[FRAMEBUFFER_RT_DEPTH], pointFlags);
+		bgfx::setImage(1, pyramid.m_texture, 0, bgfx::Access::Write, bgfx::TextureFormat::RG32F);
+		m_uniforms.submitChanged();
+		uniforms.submit();
+		bgfx::dispatch(view
+			, m_programs.get(ProgramDepthPyramidInit)
+			, (pyramid.m_levelWidth[0] + 7) / 8
+			, (pyramid.m_levelHeight[0] + 7) / 8
+			);
 
-			bgfx::setViewName(view, "bokeh dof combine");
-			bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+		const bgfx::ProgramHandle reduce = m_programs.get(ProgramDepthPyramidReduce);
+		for (uint32_t ii = 1; ii < pyramid.m_levelCount; ++ii)
+		{
+			vec2Set(uniforms.m_sourceSize, float(pyramid.m_levelWidth[ii-1]), float(pyramid.m_levelHeight[ii-1]) );
+			vec2Set(uniforms.m_outputSize, float(pyramid.m_levelWidth[ii]), float(pyramid.m_levelHeight[ii]) );
+
+			bgfx::setImage(0, pyramid.m_texture, uint8_t(ii-1), bgfx::Access::Read, bgfx::TextureFormat::RG32F);
+			bgfx::setImage(1, pyramid.m_texture, uint8_t(ii), bgfx::Access::Write, bgfx::TextureFormat::RG32F);
+			uniforms.submit();
+			bgfx::dispatch(view, reduce, (pyramid.m_levelWidth[ii] + 7) / 8, (pyramid.m_levelHeight[ii] + 7) / 8);
+		}
+		++view;
+
+		// blits happen before compute within a view, copy in the next one
+		bgfx::setViewName(view, "depth pyramid read back");
+		pyramid.requestReadback(view, m_currFrame);
+		++view;
+
+		return view;
+	}
+
+	// weighted inverse depth of every texel of linear depth, summed in blocks over
+	// three passes down to the grid that is read back. the first pass weights by the
+	// focus region or points of interest, see fs_bokeh_autofocus_reduce.sc
+	bgfx::ViewId submitAutofocus(bgfx::ViewId _view, const float* _orthoProj)
+	{
+		bgfx::ViewId view = _view;
+		const bool originBottomLeft = bgfx::getCaps()->originBottomLeft;
+
+		struct Pass
+		{
+			const char* m_name;
+			bgfx::TextureHandle m_source;
+			uint32_t m_sourceSize[2];
+			bgfx::FrameBufferHandle m_output;
+			uint32_t m_outputSize[2];
+			Programs m_program;
+		};
+
+		const uint32_t (&level)[2][2] = m_autofocusLevelSize;
+		const Pass passes[] =
+		{
+			{ "autofocus reduce",	m_linearDepth.m_texture,		{ uint32_t(m_size[0]), uint32_t(m_size[1]) },	m_autofocusLevels[0].m_buffer,	{ level[0][0], level[0][1] },							ProgramAutofocus	},
+			{ "autofocus sum",		m_autofocusLevels[0].m_texture,	{ level[0][0], level[0][1] },					m_autofocusLevels[1].m_buffer,	{ level[1][0], level[1][1] },							ProgramAutofocusSum	},
+			{ "autofocus grid",		m_autofocusLevels[1].m_texture,	{ level[1][0], level[1][1] },					m_autofocusReduce.m_buffer,		{ AUTOFOCUS_GRID_SIZE, AUTOFOCUS_GRID_SIZE },	ProgramAutofocusSum	},
+		};
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(passes); ++ii)
+		{
+			const Pass& pass = passes[ii];
+			bgfx::setViewName(view, pass.m_name);
+			bgfx::setViewRect(view, 0, 0, uint16_t(pass.m_outputSize[0]), uint16_t(pass.m_outputSize[1]) );
 			bgfx::setViewTransform(view, NULL, _orthoProj);
-			bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
+			bgfx::setViewFrameBuffer(view, pass.m_output);
 			bgfx::setState(0
 				| BGFX_STATE_WRITE_RGB
 				| BGFX_STATE_WRITE_A
 				| BGFX_STATE_DEPTH_TEST_ALWAYS
 				);
-			bgfx::setTexture(0, s_color, _colorTexture);
-			bgfx::setTexture(1, s_blurredColor, lastTex);
-			m_uniforms.submit();
-			screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, _originBottomLeft);
-			bgfx::submit(view, m_dofCombineProgram);
+			bgfx::setTexture(0, s_depth, pass.m_source);
+			vec2Set(m_autofocusUniforms.m_reduceSourceSize, float(pass.m_sourceSize[0]), float(pass.m_sourceSize[1]) );
+			vec2Set(m_autofocusUniforms.m_reduceOutputSize, float(pass.m_outputSize[0]), float(pass.m_outputSize[1]) );
+			m_uniforms.submitChanged();
+			m_autofocusUniforms.submit();
+			setScreenTriangle(float(pass.m_outputSize[0]), float(pass.m_outputSize[1]), originBottomLeft);
+			bgfx::submit(view, m_programs.get(pass.m_program) );
 			++view;
 		}
 
+		// blits happen before draws within a view, copy in the next one
+		bgfx::setViewName(view, "autofocus read back");
+		if (!m_autofocusReadback.request(view, m_autofocusReduce.m_texture) )
+		{
+			++m_autofocusSkipped;
+		}
+		++view;
+
+		return view;
+	}
+
+	// linear depth, downsample, gather and combine over a range of layers, one
+	// dispatch per pass with the layer range in z
+	bgfx::ViewId submitMultiviewDof(bgfx::ViewId _pass, uint16_t _firstLayer, uint16_t _layerCount)
+	{
+		bgfx::ViewId view = _pass;
+		const MultiviewTargets& targets = m_multiviewTargets;
+
+		const uint32_t fullGroupsX = (targets.m_width + 7) / 8;
+		const uint32_t fullGroupsY = (targets.m_height + 7) / 8;
+		const uint32_t halfGroupsX = (bx::max(targets.m_width/2, 1) + 7) / 8;
+		const uint32_t halfGroupsY = (bx::max(targets.m_height/2, 1) + 7) / 8;
+
+		m_multiviewUniforms.m_firstLayer = float(_firstLayer);
+
+		bgfx::setViewName(view, "multi-view linear depth");
+		bgfx::setTexture(0, s_depth, targets.m_depth);
+		bgfx::setImage(1, targets.m_linearDepth, 0, bgfx::Access::Write, bgfx::TextureFormat::R32F);
+		m_uniforms.submitChanged();
+		m_multiviewUniforms.submit();
+		bgfx::dispatch(view, m_programs.get(ProgramMultiviewLinearDepth), fullGroupsX, fullGroupsY, _layerCount);
+		++view;
+
+		bgfx::setViewName(view, "multi-view downsample");
+		bgfx::setTexture(0, s_color, targets.m_color);
+		bgfx::setTexture(1, s_depth, targets.m_linearDepth);
+		bgfx::setImage(2, targets.m_downsample, 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA16F);
+		m_uniforms.submitChanged();
+		m_multiviewUniforms.submit();
+		bgfx::dispatch(view, m_programs.get(ProgramMultiviewDownsample), halfGroupsX, halfGroupsY, _layerCount);
+		++view;
+
+		bgfx::setViewName(view, "multi-view gather");
+		bgfx::setTexture(0, s_color, targets.m_downsample);
+		bgfx::setImage(1, targets.m_gather, 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA16F);
+		m_uniforms.submitChanged();
+		m_multiviewUniforms.submit();
+		bgfx::dispatch(view, m_programs.get(ProgramMultiviewGather), halfGroupsX, halfGroupsY, _layerCount);
+		++view;
+
+		bgfx::setViewName(view, "multi-view combine");
+		bgfx::setTexture(0, s_color, targets.m_color);
+		bgfx::setTexture(1, s_blurredColor, targets.m_gather);
+		bgfx::setImage(2, targets.m_output, 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA8);
+		m_uniforms.submitChanged();
+		m_multiviewUniforms.submit();
+		bgfx::dispatch(view, m_programs.get(ProgramMultiviewCombine), fullGroupsX, fullGroupsY, _layerCount);
+		++view;
+
 		return view;
 	}
 
+	// pick up assets that finished loading, placeholders stay bound until then
+	void updateAssets()
+	{
+		m_assetLoader.update();
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+		{
+			m_meshes[ii] = m_assetLoader.getMesh(m_meshAssets[ii]);
+		}
+
+		m_groundTexture = m_assetLoader.getTexture(m_groundTextureAsset, m_groundPlaceholder);
+		m_normalTexture = m_assetLoader.getTexture(m_normalTextureAsset, m_normalPlaceholder);
+	}
+
+	// Scale scene rendering toward a frame time target. Cost follows pixel count, so
+	// step by the square root of the time ratio, damped and with a dead band around
+	// the target to keep scale from hunting every frame.
+	void updateRenderScale(float _deltaTime)
+	{
+		if (m_dynamicResolution)
+		{
+			const bgfx::Stats* stats = bgfx::getStats();
+			const float gpuFrameMs = (0 < stats->gpuTimerFreq)
+				? float(double(stats->gpuTimeEnd - stats->gpuTimeBegin) * 1000.0 / double(stats->gpuTimerFreq) )
+				: 0.0f
+				;
+			m_frameTimeMs = (0.0f < gpuFrameMs) ? gpuFrameMs : _deltaTime * 1000.0f;
+
+			const float ratio = m_targetFrameTimeMs / bx::max(m_frameTimeMs, 0.1f);
+			if (ratio < 0.95f
+			||  ratio > 1.05f)
+			{
+				const float desiredScale = bx::clamp(m_renderScale * bx::sqrt(ratio), m_minRenderScale, 1.0f);
+				m_renderScale = bx::lerp(m_renderScale, desiredScale, 0.1f);
+			}
+		}
+
+		m_renderSize[0] = bx::clamp(int32_t(float(m_size[0]) * m_renderScale + 0.5f), 1, m_size[0]);
+		m_renderSize[1] = bx::clamp(int32_t(float(m_size[1]) * m_renderScale + 0.5f), 1, m_size[1]);
+	}
+
+	bool isTapCountViewActive() const
+	{
+		return true
+			&& m_showDebugVisualization
+			&& BokehDofDebugView::CircleOfConfusion != m_debugView
+			&& m_bokehDof.isTapCountSupported()
+			&& m_tapCountReadbackSupported
+			;
+	}
+
+	// sum the grid of block totals from the newest landed read back
+	void updateTapCountTotals()
+	{
+		const float* data = (const float*)m_tapCountReadback.poll(m_currFrame);
+		if (NULL == data)
+		{
+			return;
+		}
+
+		bx::memSet(m_tapCountTotals, 0, sizeof(m_tapCountTotals) );
+		for (uint32_t ii = 0; ii < BokehDof::TapCountTotalsSize*BokehDof::TapCountTotalsSize; ++ii)
+		{
+			for (uint32_t jj = 0; jj < 4; ++jj)
+			{
+				m_tapCountTotals[jj] += data[ii*4 + jj];
+			}
+		}
+	}
+
+	void updateAutofocus(float _deltaTime)
+	{
+		if (!m_autofocusSupported
+		||  AutofocusMode::Manual == m_autofocusMode)
+		{
+			m_autofocusPoint = m_focusPoint;
+			m_autofocusVelocity = 0.0f;
+			return;
+		}
+
+		// pick up newest reduction that has landed, if any
+		if (UINT32_MAX != m_currFrame)
+		{
+			const float* data = (const float*)m_autofocusReadback.poll(m_currFrame);
+			if (NULL != data)
+			{
+				float weightedInvDepth = 0.0f;
+				float totalWeight = 0.0f;
+				for (uint32_t ii = 0; ii < AUTOFOCUS_GRID_SIZE*AUTOFOCUS_GRID_SIZE; ++ii)
+				{
+					weightedInvDepth += data[ii*2 + 0];
+					totalWeight      += data[ii*2 + 1];
+				}
+
+				if (0.0f < weightedInvDepth)
+				{
+					m_autofocusTarget = totalWeight / weightedInvDepth;
+				}
+			}
+		}
+
+		m_autofocusPoint = smoothCriticallyDamped(m_autofocusPoint, m_autofocusTarget, &m_autofocusVelocity, m_autofocusSmoothTime, _deltaTime);
+
+		// region and points are in screen space, flip to texture space if needed
+		const bool originBottomLeft = bgfx::getCaps()->originBottomLeft;
+		const float halfSize = 0.5f * m_autofocusRegionSize;
+		m_autofocusUniforms.m_regionCenter[0] = 0.5f;
+		m_autofocusUniforms.m_regionCenter[1] = 0.5f;
+		m_autofocusUniforms.m_regionExtent[0] = halfSize;
+		m_autofocusUniforms.m_regionExtent[1] = halfSize;
+		m_autofocusUniforms.m_mode = float(m_autofocusMode);
+		m_autofocusUniforms.m_pointCount = float(m_autofocusPointCount);
+		m_autofocusUniforms.m_regionFalloff = 2.0f;
+
+		for (int32_t ii = 0; ii < m_autofocusPointCount; ++ii)
+		{
+			const AutofocusPoint& point = m_autofocusPoints[ii];
+			m_autofocusUniforms.m_points[ii][0] = point.m_uv[0];
+			m_autofocusUniforms.m_points[ii][1] = originBottomLeft ? 1.0f - point.m_uv[1] : point.m_uv[1];
+			m_autofocusUniforms.m_points[ii][2] = point.m_radius;
+			m_autofocusUniforms.m_points[ii][3] = point.m_weight;
+		}
+	}
+
 	void createFramebuffers()
 	{
 		m_size[0] = m_width;
 		m_size[1] = m_height;
+		m_renderSize[0] = m_width;
+		m_renderSize[1] = m_height;
 
 		const uint64_t bilinearFlags = 0
 			| BGFX_TEXTURE_RT
@@ -797,16 +3858,87 @@ public:
 			| BGFX_SAMPLER_V_CLAMP
 			;
 
-		m_frameBufferTex[FRAMEBUFFER_RT_COLOR] = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::RGBA16F, bilinearFlags);
+		// dof component falls back to rgba16f if hardware can't render to the selected format set
+		if (!m_bokehDof.isCreated()
+		||  m_bokehDofFormat != m_intermediateFormat)
+		{
+			m_bokehDof.destroy();
+
+			BokehDofConfig config;
+			config.m_intermediateFormat = IntermediateFormat::Enum(m_intermediateFormat);
+			config.m_loadProgram = ProgramCache::loadDofProgram;
+			config.m_loadProgramUserData = &m_programs;
+			config.m_mixedResolution = true;
+			config.m_tapCounts = true;
+			m_bokehDof.create(m_size[0], m_size[1], config);
+			m_bokehDofFormat = m_intermediateFormat;
+		}
+		else
+		{
+			m_bokehDof.resize(m_size[0], m_size[1]);
+		}
+
+		m_activeIntermediateFormat = m_bokehDof.getIntermediateFormat();
+		const IntermediateFormatInfo& formats = getIntermediateFormatInfo(IntermediateFormat::Enum(m_activeIntermediateFormat) );
+
+		m_frameBufferTex[FRAMEBUFFER_RT_COLOR] = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, formats.m_color,            bilinearFlags);
 		m_frameBufferTex[FRAMEBUFFER_RT_DEPTH] = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::D32F,    bilinearFlags);
 		m_frameBuffer = bgfx::createFrameBuffer(BX_COUNTOF(m_frameBufferTex), m_frameBufferTex, true);
 
 		m_linearDepth.init(m_size[0], m_size[1], bgfx::TextureFormat::R16F, bilinearFlags);
 
-		unsigned halfWidth = m_size[0]/2;
-		unsigned halfHeight = m_size[1]/2;
-		m_dofQuarterInput.init(halfWidth, halfHeight, bgfx::TextureFormat::RGBA16F, bilinearFlags);
-		m_dofQuarterOutput.init(halfWidth, halfHeight, bgfx::TextureFormat::RGBA16F, bilinearFlags);
+		if (m_autofocusSupported)
+		{
+			const uint64_t pointFlags = 0
+				| BGFX_TEXTURE_RT
+				| BGFX_SAMPLER_POINT
+				| BGFX_SAMPLER_U_CLAMP
+				| BGFX_SAMPLER_V_CLAMP
+				;
+
+			// three reductions by AUTOFOCUS_REDUCE_BLOCK cover targets up to 4096 square
+			const uint32_t maxLevelSize = AUTOFOCUS_GRID_SIZE * AUTOFOCUS_REDUCE_BLOCK;
+			for (uint32_t ii = 0; ii < 2; ++ii)
+			{
+				m_autofocusLevelSize[0][ii] = (uint32_t(m_size[ii]) + AUTOFOCUS_REDUCE_BLOCK - 1) / AUTOFOCUS_REDUCE_BLOCK;
+				m_autofocusLevelSize[1][ii] = bx::min( (m_autofocusLevelSize[0][ii] + AUTOFOCUS_REDUCE_BLOCK - 1) / AUTOFOCUS_REDUCE_BLOCK, maxLevelSize);
+			}
+
+			for (uint32_t ii = 0; ii < BX_COUNTOF(m_autofocusLevels); ++ii)
+			{
+				m_autofocusLevels[ii].init(m_autofocusLevelSize[ii][0], m_autofocusLevelSize[ii][1], bgfx::TextureFormat::RG32F, pointFlags);
+			}
+		}
+
+		if (m_depthPyramidSupported)
+		{
+			m_depthPyramid.init(uint16_t(m_size[0]), uint16_t(m_size[1]) );
+		}
+	}
+
+	// capture target lives and resizes with the capture, not with the other buffers
+	void initCapture(bool _originBottomLeft)
+	{
+		m_capture.releaseMemory();
+		m_capture.init(uint16_t(m_size[0]), uint16_t(m_size[1]), _originBottomLeft);
+
+		const uint64_t bilinearFlags = 0
+			| BGFX_TEXTURE_RT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+
+		// same format as backbuffer so a capture matches what is displayed
+		m_captureTarget.init(m_size[0], m_size[1], bgfx::TextureFormat::RGBA8, bilinearFlags);
+	}
+
+	void shutdownCapture()
+	{
+		if (m_capture.isInitialized() )
+		{
+			m_captureTarget.destroy();
+		}
+		m_capture.shutdown();
 	}
 
 	// all buffers set to destroy their textures
@@ -815,8 +3947,15 @@ public:
 		bgfx::destroy(m_frameBuffer);
 
 		m_linearDepth.destroy();
-		m_dofQuarterInput.destroy();
-		m_dofQuarterOutput.destroy();
+		m_depthPyramid.destroy();
+
+		if (m_autofocusSupported)
+		{
+			for (uint32_t ii = 0; ii < BX_COUNTOF(m_autofocusLevels); ++ii)
+			{
+				m_autofocusLevels[ii].destroy();
+			}
+		}
 	}
 
 	void updateUniforms()
@@ -854,6 +3993,17 @@ public:
 
 		m_uniforms.m_frameIdx = float(m_currFrame % 8);
 
+		// scene is rendered into the top left of max sized targets, which is the
+		// top of texture space when origin is bottom left
+		{
+			const float scaleX = float(m_renderSize[0]) / float(m_size[0]);
+			const float scaleY = float(m_renderSize[1]) / float(m_size[1]);
+			vec2Set(m_uniforms.m_sceneUvScale, scaleX, scaleY);
+			vec2Set(m_uniforms.m_sceneUvOffset, 0.0f, bgfx::getCaps()->originBottomLeft ? 1.0f - scaleY : 0.0f);
+			vec2Set(m_uniforms.m_sceneTexelSize, 1.0f / float(m_size[0]), 1.0f / float(m_size[1]) );
+			m_uniforms.m_renderScale = bx::min(scaleX, scaleY);
+		}
+
 		{
 			float lightPosition[] = { 0.0f, 6.0f, 10.0f };
 			bx::memCopy(m_modelUniforms.m_lightPosition, lightPosition, 3*sizeof(float));
@@ -868,10 +4018,40 @@ public:
 			m_uniforms.m_lobeRadiusMin = (1.0f - m_lobePinch);
 			m_uniforms.m_lobeRadiusDelta2x = 2.0f * m_lobePinch;
 			m_uniforms.m_maxBlurSize = m_maxBlurSize * blurScale;
-			m_uniforms.m_focusPoint = m_focusPoint;
+			m_uniforms.m_focusPoint = m_autofocusPoint;
 			m_uniforms.m_focusScale = m_focusScale;
 			m_uniforms.m_radiusScale = m_radiusScale * blurScale;
 			m_uniforms.m_lobeRotation = m_lobeRotation;
+
+			// the dof component shares u_params, last frame ended with its values
+			m_uniforms.invalidate();
+		}
+
+		// parameters for the dof component, it fills its own uniforms
+		{
+			// debug vis counts the taps of the gather that runs without it
+			const BokehDofMode::Enum gatherMode = m_useMixedResolution ? BokehDofMode::MixedResolution
+				: m_useSinglePassBokehDof ? BokehDofMode::SinglePass
+				: BokehDofMode::MultiPass
+				;
+			m_dofParams.m_mode = m_showDebugVisualization ? BokehDofMode::Debug : gatherMode;
+			m_dofParams.m_debugView = BokehDofDebugView::Enum(m_debugView);
+			m_dofParams.m_tapCountMode = gatherMode;
+			m_dofParams.m_useComputeGather = m_useComputeGather;
+			m_dofParams.m_focusPoint = m_autofocusPoint;
+			m_dofParams.m_focusScale = m_focusScale;
+			m_dofParams.m_maxBlurSize = m_maxBlurSize;
+			m_dofParams.m_radiusScale = m_radiusScale;
+			m_dofParams.m_blurSteps = m_blurSteps;
+			m_dofParams.m_lobeCount = m_lobeCount;
+			m_dofParams.m_lobePinch = m_lobePinch;
+			m_dofParams.m_lobeRotation = m_lobeRotation;
+			m_dofParams.m_frameIdx = m_currFrame;
+			m_dofParams.m_renderWidth = uint32_t(m_renderSize[0]);
+			m_dofParams.m_renderHeight = uint32_t(m_renderSize[1]);
+			m_dofParams.m_mixedHalfThreshold = m_mixedHalfThreshold;
+			m_dofParams.m_mixedQuarterThreshold = m_mixedQuarterThreshold;
+			m_dofParams.m_mixedBlendWidth = m_mixedBlendWidth;
 		}
 	}
 
@@ -979,20 +4159,15 @@ public:
 	entry::MouseState m_mouseState;
 
 	// Resource handles
-	bgfx::ProgramHandle m_forwardProgram;
-	bgfx::ProgramHandle m_gridProgram;
-	bgfx::ProgramHandle m_copyProgram;
-	bgfx::ProgramHandle m_copyLinearToGammaProgram;
-	bgfx::ProgramHandle m_linearDepthProgram;
-	bgfx::ProgramHandle m_dofSinglePassProgram;
-	bgfx::ProgramHandle m_dofDownsampleProgram;
-	bgfx::ProgramHandle m_dofQuarterProgram;
-	bgfx::ProgramHandle m_dofCombineProgram;
-	bgfx::ProgramHandle m_dofDebugProgram;
+	ShaderBundle m_shaderBundle;
+	ProgramCache m_programs;
 
 	// Shader uniforms
 	PassUniforms m_uniforms;
 	ModelUniforms m_modelUniforms;
+	AutofocusUniforms m_autofocusUniforms;
+	MultiviewUniforms m_multiviewUniforms;
+	DepthPyramidUniforms m_depthPyramidUniforms;
 
 	// Uniforms to indentify texture samplers
 	bgfx::UniformHandle s_albedo;
@@ -1000,13 +4175,39 @@ public:
 	bgfx::UniformHandle s_normal;
 	bgfx::UniformHandle s_depth;
 	bgfx::UniformHandle s_blurredColor;
+	bgfx::UniformHandle s_blurSize;
 
 	bgfx::FrameBufferHandle m_frameBuffer;
 	bgfx::TextureHandle m_frameBufferTex[FRAMEBUFFER_RENDER_TARGETS];
 
 	RenderTarget m_linearDepth;
-	RenderTarget m_dofQuarterInput;
-	RenderTarget m_dofQuarterOutput;
+	DepthPyramid m_depthPyramid;
+	BokehDof m_bokehDof;
+	BokehDofParams m_dofParams;
+	int32_t m_bokehDofFormat = IntermediateFormat::Count;
+
+	RenderTarget m_captureTarget;
+	FrameCapture m_capture;
+	bgfx::FrameBufferHandle m_outputFrameBuffer;
+
+	MultiviewTargets m_multiviewTargets;
+
+	RenderTarget m_autofocusReduce;
+	RenderTarget m_autofocusLevels[2];
+	uint32_t m_autofocusLevelSize[2][2];
+	ReadbackRing m_autofocusReadback;
+	ReadbackRing m_tapCountReadback;
+
+	struct AutofocusPoint
+	{
+		float m_uv[2];
+		float m_radius;
+		float m_weight;
+	};
+
+	AutofocusPoint m_autofocusPoints[AUTOFOCUS_MAX_POINTS];
+	int32_t m_autofocusPointCount = 0;
+	bool m_middleButtonDown = false;
 
 	struct Model
 	{
@@ -1014,36 +4215,92 @@ public:
 		float position[3];
 	};
 
+	AssetLoader m_assetLoader;
+	uint32_t m_meshAssets[BX_COUNTOF(s_meshPaths)];
+	uint32_t m_groundTextureAsset;
+	uint32_t m_normalTextureAsset;
+
+	// point at loaded assets, or NULL and placeholders while loading
 	Mesh* m_meshes[BX_COUNTOF(s_meshPaths)];
 	bgfx::TextureHandle m_groundTexture;
 	bgfx::TextureHandle m_normalTexture;
+	bgfx::TextureHandle m_groundPlaceholder;
+	bgfx::TextureHandle m_normalPlaceholder;
 	bgfx::TextureHandle m_bokehTexture;
 
 	uint32_t m_currFrame;
+	int64_t m_startupTime;
+	float m_startupTimeMs = 0.0f;
 	float m_lightRotation = 0.0f;
-	float m_texelHalf = 0.0f;
 	float m_fovY = 60.0f;
 	bool m_recreateFrameBuffers = false;
 	float m_animationTime = 0.0f;
+	int32_t m_activeIntermediateFormat = IntermediateFormat::Rgba16f;
+	bool m_computeGatherSupported = false;
+	bool m_autofocusSupported = false;
+	bool m_depthPyramidSupported = false;
+	bool m_useDepthPyramid = true;
+	float m_autofocusPoint = 5.0f;
+	float m_autofocusTarget = 5.0f;
+	float m_autofocusVelocity = 0.0f;
+	uint32_t m_autofocusSkipped = 0;
+	bool m_tapCountReadbackSupported = false;
+	float m_tapCountTotals[4] = { 0.0f, 0.0f, 0.0f, 0.0f }; // executed, contributing, wasted taps, pixels
+	uint32_t m_tapCountSkipped = 0;
+	bool m_captureSupported = false;
+	bool m_captureSingle = false;
+	bgfx::ViewId m_dofViewBegin = 0;
+	bgfx::ViewId m_dofViewEnd = 0;
 
 	float m_view[16];
 	float m_proj[16];
 	float m_proj2[16];
 	int32_t m_size[2];
+	int32_t m_renderSize[2];
+	float m_frameTimeMs = 0.0f;
 
 	// UI parameters
 	bool m_useBokehDof = true;
 	bool m_useSinglePassBokehDof = false;
+	bool m_useMixedResolution = false;
+	float m_mixedHalfThreshold = 3.0f;
+	float m_mixedQuarterThreshold = 10.0f;
+	float m_mixedBlendWidth = 2.0f;
 	float m_maxBlurSize = 20.0f;
 	float m_focusPoint = 5.0f;
 	float m_focusScale = 3.0f;
 	float m_radiusScale = 0.5f;
 	float m_blurSteps = 50.0f;
 	bool m_showDebugVisualization = false;
+	int32_t m_debugView = BokehDofDebugView::CircleOfConfusion;
 	int32_t m_lobeCount = 6;
 	float m_lobePinch = 0.2f;
 	float m_lobeRotation = 0.0f;
 	int32_t m_sampleCount = 0;
+	int32_t m_intermediateFormat = IntermediateFormat::Rgba16f;
+	bool m_profilePasses = false;
+	bool m_useComputeGather = false;
+	int32_t m_autofocusMode = AutofocusMode::Manual;
+	float m_autofocusRegionSize = 0.3f;
+	float m_autofocusSmoothTime = 0.3f;
+	bool m_captureContinuous = false;
+	bool m_dynamicResolution = false;
+	bool m_multiviewSupported = false;
+	bool m_useMultiview = false;
+	bool m_multiviewIndependent = false;
+	bool m_multiviewRanIndependent = false;
+	int32_t m_multiviewLayerCount = 2;
+	float m_multiviewCameraSpacing = 0.5f;
+	float m_multiviewFocusSpread = 0.0f;
+	float m_multiviewSubmitMs = 0.0f;
+	float m_multiviewGpuMs[2] = { 0.0f, 0.0f }; // batched, independent
+	float m_renderScale = 1.0f;
+	float m_minRenderScale = 0.5f;
+	float m_targetFrameTimeMs = 16.0f;
+	int32_t m_captureFormat = CaptureFormat::Png;
+	bool m_exitAfterInit = false;
+	int32_t m_exitCode = 0;
+	uint32_t m_verifyDepthPyramidFrames = 0;
 };
 
 } // namespace
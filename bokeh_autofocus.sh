@@ -0,0 +1,33 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_AUTOFOCUS_SH
+#define BOKEH_AUTOFOCUS_SH
+
+// Autofocus sums (weight * inverse depth, weight) over every texel of the linear
+// depth target, reduced by blocks of AUTOFOCUS_REDUCE_BLOCK squared texels per pass
+// down to the AUTOFOCUS_GRID_SIZE square target read back. cpu sums those texels.
+#define AUTOFOCUS_GRID_SIZE			8
+#define AUTOFOCUS_MAX_POINTS		8
+#define AUTOFOCUS_REDUCE_BLOCK		8
+
+// struct AutofocusUniforms
+uniform vec4 u_autofocusParams[3 + AUTOFOCUS_MAX_POINTS];
+
+#define u_regionCenter				(u_autofocusParams[0].xy)
+#define u_regionExtent				(u_autofocusParams[0].zw)
+#define u_autofocusMode				(u_autofocusParams[1].x)
+#define u_pointCount				(u_autofocusParams[1].y)
+#define u_regionFalloff				(u_autofocusParams[1].z)
+#define u_reduceSourceSize			(u_autofocusParams[2].xy)
+#define u_reduceOutputSize			(u_autofocusParams[2].zw)
+
+// first source texel of the block summed into this output texel
+vec2 AutofocusBlockBase (vec2 texCoord)
+{
+	return floor(texCoord * u_reduceOutputSize) * float(AUTOFOCUS_REDUCE_BLOCK);
+}
+
+#endif // BOKEH_AUTOFOCUS_SH
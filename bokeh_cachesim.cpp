@@ -0,0 +1,579 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bokeh_cachesim.h"
+#include "bokeh_cpu.h"
+#include "bokeh_sweep.h"
+
+#include <common.h>
+#include <bx/file.h>
+#include <bx/math.h>
+#include <bx/timer.h>
+
+// lanes per warp, as 2x2 quads over an 8x4 pixel block
+#define CACHE_SIM_WARP_WIDTH 8
+#define CACHE_SIM_WARP_HEIGHT 4
+#define CACHE_SIM_WARP_SIZE (CACHE_SIM_WARP_WIDTH*CACHE_SIM_WARP_HEIGHT)
+
+namespace {
+
+struct TraversalOrder
+{
+	enum Enum
+	{
+		Tiles,
+		Warps,
+		Scanline,
+
+		Count
+	};
+};
+
+static const char* s_orderNames[TraversalOrder::Count] =
+{
+	"tiles",
+	"warps",
+	"scanline",
+};
+
+struct LobeSetting
+{
+	int32_t m_lobeCount;
+	float m_lobePinch;
+};
+
+static const LobeSetting s_lobeSettings[] =
+{
+	{ 0, 0.0f }, // round
+	{ 6, 0.2f },
+};
+
+static const float s_radiusScales[] = { 0.5f, 1.0f, 2.0f };
+
+static const BokehDofMode::Enum s_modes[] = { BokehDofMode::SinglePass, BokehDofMode::MultiPass };
+
+static const uint32_t s_defaultSizes[][2] =
+{
+	{ 320, 180 },
+	{ 640, 360 },
+};
+
+// set associative, least recently used way is replaced
+struct CacheModel
+{
+	void create(bx::AllocatorI* _allocator, uint32_t _cacheSize, uint32_t _lineSize, uint32_t _ways)
+	{
+		m_allocator = _allocator;
+		m_ways = bx::max(_ways, 1u);
+		m_setCount = bx::max(_cacheSize / (_lineSize * m_ways), 1u);
+		m_tags = (uint64_t*)BX_ALLOC(_allocator, m_setCount * m_ways * sizeof(uint64_t) );
+		m_lastUse = (uint32_t*)BX_ALLOC(_allocator, m_setCount * m_ways * sizeof(uint32_t) );
+		reset();
+	}
+
+	void destroy()
+	{
+		BX_FREE(m_allocator, m_tags);
+		BX_FREE(m_allocator, m_lastUse);
+	}
+
+	void reset()
+	{
+		for (uint32_t ii = 0, num = m_setCount * m_ways; ii < num; ++ii)
+		{
+			m_tags[ii] = UINT64_MAX;
+			m_lastUse[ii] = 0;
+		}
+		m_clock = 0;
+		m_hits = 0;
+		m_misses = 0;
+	}
+
+	void access(uint64_t _line)
+	{
+		const uint32_t set = uint32_t(_line % m_setCount);
+		uint64_t* tags = &m_tags[set * m_ways];
+		uint32_t* lastUse = &m_lastUse[set * m_ways];
+		++m_clock;
+
+		uint32_t victim = 0;
+		for (uint32_t ii = 0; ii < m_ways; ++ii)
+		{
+			if (_line == tags[ii])
+			{
+				lastUse[ii] = m_clock;
+				++m_hits;
+				return;
+			}
+
+			if (lastUse[ii] < lastUse[victim])
+			{
+				victim = ii;
+			}
+		}
+
+		tags[victim] = _line;
+		lastUse[victim] = m_clock;
+		++m_misses;
+	}
+
+	bx::AllocatorI* m_allocator;
+	uint64_t* m_tags;
+	uint32_t* m_lastUse;
+	uint32_t m_setCount;
+	uint32_t m_ways;
+	uint32_t m_clock;
+	uint64_t m_hits;
+	uint64_t m_misses;
+};
+
+// texture as seen by the cache, each in its own range of line addresses
+struct SimTexture
+{
+	void create(bx::AllocatorI* _allocator, uint32_t _width, uint32_t _height, uint32_t _bytesPerTexel, uint32_t _lineSize, bool _blockLayout, uint64_t _firstLine)
+	{
+		m_allocator = _allocator;
+		m_width = _width;
+		m_height = _height;
+		m_firstLine = _firstLine;
+
+		// blocks as square as a power of two width allows, 8 bytes in 64 is 4x2
+		const uint32_t texelsPerLine = bx::max(_lineSize / _bytesPerTexel, 1u);
+		m_blockWidth = texelsPerLine;
+		m_blockHeight = 1;
+		if (_blockLayout)
+		{
+			m_blockWidth = 1;
+			while (m_blockWidth * m_blockWidth < texelsPerLine)
+			{
+				m_blockWidth *= 2;
+			}
+			m_blockHeight = bx::max(texelsPerLine / m_blockWidth, 1u);
+		}
+		m_linesPerRow = (_width + m_blockWidth - 1) / m_blockWidth;
+		m_lineCount = m_linesPerRow * ( (_height + m_blockHeight - 1) / m_blockHeight);
+
+		m_stamps = (uint32_t*)BX_ALLOC(_allocator, _width * _height * sizeof(uint32_t) );
+	}
+
+	void destroy()
+	{
+		BX_FREE(m_allocator, m_stamps);
+	}
+
+	uint64_t lineOf(uint32_t _x, uint32_t _y) const
+	{
+		return m_firstLine + (_y / m_blockHeight) * m_linesPerRow + _x / m_blockWidth;
+	}
+
+	bx::AllocatorI* m_allocator;
+	uint32_t* m_stamps; // last tile that read each texel
+	uint64_t m_firstLine;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_blockWidth;
+	uint32_t m_blockHeight;
+	uint32_t m_linesPerRow;
+	uint32_t m_lineCount;
+};
+
+struct SimRun
+{
+	CacheModel* m_cache;
+	SimTexture* m_textures;
+	uint32_t m_numTextures;
+	uint32_t m_stamp;
+	uint64_t m_fetches;
+	uint64_t m_unique;
+};
+
+// bilinear fetch of the 2x2 footprint around uv, clamped, from every texture
+void fetch(SimRun& _run, float _u, float _v)
+{
+	const SimTexture& first = _run.m_textures[0];
+	const int32_t maxX = int32_t(first.m_width) - 1;
+	const int32_t maxY = int32_t(first.m_height) - 1;
+	const int32_t x0 = int32_t(bx::floor(_u * float(first.m_width)  - 0.5f) );
+	const int32_t y0 = int32_t(bx::floor(_v * float(first.m_height) - 0.5f) );
+	const uint32_t xs[2] = { uint32_t(bx::clamp(x0, 0, maxX) ), uint32_t(bx::clamp(x0 + 1, 0, maxX) ) };
+	const uint32_t ys[2] = { uint32_t(bx::clamp(y0, 0, maxY) ), uint32_t(bx::clamp(y0 + 1, 0, maxY) ) };
+
+	for (uint32_t ii = 0; ii < _run.m_numTextures; ++ii)
+	{
+		SimTexture& texture = _run.m_textures[ii];
+		for (uint32_t jj = 0; jj < 4; ++jj)
+		{
+			const uint32_t xx = xs[jj & 1];
+			const uint32_t yy = ys[jj >> 1];
+			_run.m_cache->access(texture.lineOf(xx, yy) );
+
+			uint32_t& stamp = texture.m_stamps[yy * texture.m_width + xx];
+			if (_run.m_stamp != stamp)
+			{
+				stamp = _run.m_stamp;
+				++_run.m_unique;
+			}
+		}
+		_run.m_fetches += 4;
+	}
+}
+
+// center tap then the spiral, as uv pairs, returns the number of taps
+uint32_t spiralTaps(float* _uv, uint32_t _width, uint32_t _height, uint32_t _x, uint32_t _y, const CpuGatherUniforms& _uniforms, float _loopEnd)
+{
+	CpuSpiral spiral(_width, _height, _x, _y, _uniforms, _loopEnd);
+	_uv[0] = spiral.m_texCoord[0];
+	_uv[1] = spiral.m_texCoord[1];
+
+	uint32_t num = 1;
+	float radius;
+	while (spiral.next(&_uv[num*2+0], &_uv[num*2+1], &radius) )
+	{
+		++num;
+	}
+	return num;
+}
+
+// 2x2 quads in morton order over the warp block
+void warpLane(uint32_t* _x, uint32_t* _y, uint32_t _lane)
+{
+	const uint32_t quad = _lane / 4;
+	*_x = (_lane & 1)      + 2 * ( (quad & 1) | ( (quad >> 1) & 2) );
+	*_y = ( (_lane >> 1) & 1) + 2 * ( (quad >> 1) & 1);
+}
+
+struct SimResult
+{
+	float m_tapsPerPixel;
+	float m_fetchesPerPixel;
+	float m_hitRate;
+	float m_uniqueTexelsPerTile;
+	float m_bytesPerPixel;
+};
+
+// taps per pixel including the center one, every pixel has the same count since the
+// loop end is fixed
+uint32_t gatherTapCount(uint32_t _width, uint32_t _height, const CpuGatherUniforms& _uniforms, float _loopEnd)
+{
+	CpuSpiral counter(_width, _height, 0, 0, _uniforms, _loopEnd);
+	uint32_t tapCount = 1;
+	float uu, vv, radius;
+	while (counter.next(&uu, &vv, &radius) )
+	{
+		++tapCount;
+	}
+	return tapCount;
+}
+
+// _uv holds tap coordinates of a warp, CACHE_SIM_WARP_SIZE * _tapCount uv pairs
+SimResult simulate(
+	  float* _uv
+	, uint32_t _tapCount
+	, CacheModel& _cache
+	, SimTexture* _textures
+	, uint32_t _numTextures
+	, const CpuGatherUniforms& _uniforms
+	, float _loopEnd
+	, TraversalOrder::Enum _order
+	, uint32_t _tileSize
+	, uint32_t _screenPixels
+	, uint32_t _lineSize
+	)
+{
+	const uint32_t width = _textures[0].m_width;
+	const uint32_t height = _textures[0].m_height;
+
+	_cache.reset();
+	for (uint32_t ii = 0; ii < _numTextures; ++ii)
+	{
+		bx::memSet(_textures[ii].m_stamps, 0, width * height * sizeof(uint32_t) );
+	}
+
+	SimRun run;
+	run.m_cache = &_cache;
+	run.m_textures = _textures;
+	run.m_numTextures = _numTextures;
+	run.m_stamp = 1;
+	run.m_fetches = 0;
+	run.m_unique = 0;
+
+	const uint32_t tapCount = _tapCount;
+	float* uv = _uv;
+
+	if (TraversalOrder::Scanline == _order)
+	{
+		for (uint32_t yy = 0; yy < height; ++yy)
+		{
+			for (uint32_t xx = 0; xx < width; ++xx)
+			{
+				spiralTaps(uv, width, height, xx, yy, _uniforms, _loopEnd);
+				for (uint32_t kk = 0; kk < tapCount; ++kk)
+				{
+					fetch(run, uv[kk*2+0], uv[kk*2+1]);
+				}
+			}
+		}
+	}
+	else
+	{
+		const uint32_t tileSize = bx::max(_tileSize, 1u);
+		for (uint32_t ty = 0; ty < height; ty += tileSize)
+		{
+			for (uint32_t tx = 0; tx < width; tx += tileSize)
+			{
+				const uint32_t tileWidth = bx::min(tileSize, width - tx);
+				const uint32_t tileHeight = bx::min(tileSize, height - ty);
+
+				if (TraversalOrder::Tiles == _order)
+				{
+					for (uint32_t yy = ty; yy < ty + tileHeight; ++yy)
+					{
+						for (uint32_t xx = tx; xx < tx + tileWidth; ++xx)
+						{
+							spiralTaps(uv, width, height, xx, yy, _uniforms, _loopEnd);
+							for (uint32_t kk = 0; kk < tapCount; ++kk)
+							{
+								fetch(run, uv[kk*2+0], uv[kk*2+1]);
+							}
+						}
+					}
+				}
+				else
+				{
+					// each warp fetches tap kk for all its active lanes before tap kk+1
+					for (uint32_t wy = ty; wy < ty + tileHeight; wy += CACHE_SIM_WARP_HEIGHT)
+					{
+						for (uint32_t wx = tx; wx < tx + tileWidth; wx += CACHE_SIM_WARP_WIDTH)
+						{
+							uint32_t numActive = 0;
+							for (uint32_t lane = 0; lane < CACHE_SIM_WARP_SIZE; ++lane)
+							{
+								uint32_t lx, ly;
+								warpLane(&lx, &ly, lane);
+								const uint32_t xx = wx + lx;
+								const uint32_t yy = wy + ly;
+								if (xx < tx + tileWidth && yy < ty + tileHeight)
+								{
+									spiralTaps(&uv[numActive * tapCount * 2], width, height, xx, yy, _uniforms, _loopEnd);
+									++numActive;
+								}
+							}
+
+							for (uint32_t kk = 0; kk < tapCount; ++kk)
+							{
+								for (uint32_t ii = 0; ii < numActive; ++ii)
+								{
+									const float* tap = &uv[(ii * tapCount + kk) * 2];
+									fetch(run, tap[0], tap[1]);
+								}
+							}
+						}
+					}
+				}
+
+				++run.m_stamp;
+			}
+		}
+	}
+
+	const uint32_t tileSize = bx::max(_tileSize, 1u);
+	const uint32_t tileCount = ( (width + tileSize - 1) / tileSize) * ( (height + tileSize - 1) / tileSize);
+	const double pixels = double(width * height);
+	const uint64_t accesses = _cache.m_hits + _cache.m_misses;
+
+	SimResult result;
+	result.m_tapsPerPixel = float(tapCount - 1);
+	result.m_fetchesPerPixel = float(double(run.m_fetches) / pixels);
+	result.m_hitRate = accesses > 0 ? float(double(_cache.m_hits) / double(accesses) ) : 0.0f;
+	result.m_uniqueTexelsPerTile = TraversalOrder::Scanline == _order ? 0.0f : float(double(run.m_unique) / double(tileCount) );
+	result.m_bytesPerPixel = float(double(_cache.m_misses * _lineSize) / double(_screenPixels) );
+	return result;
+}
+
+} // namespace
+
+bool runCacheSim(bx::AllocatorI* _allocator, const CacheSimConfig& _config)
+{
+	const int64_t start = bx::getHPCounter();
+
+	const uint32_t lineSize = bx::max(_config.m_lineSize, 16u);
+	const uint32_t ways = bx::max(_config.m_ways, 1u);
+	const uint32_t cacheSize = bx::max(_config.m_cacheSize, lineSize * ways);
+	const uint32_t tileSize = bx::max(_config.m_tileSize, 1u);
+	const IntermediateFormatInfo& formats = getIntermediateFormatInfo(_config.m_format);
+
+	uint32_t sizes[BX_COUNTOF(s_defaultSizes)][2];
+	uint32_t numSizes = 0;
+	if (0 != _config.m_width && 0 != _config.m_height)
+	{
+		sizes[0][0] = bx::max(_config.m_width, 16u);
+		sizes[0][1] = bx::max(_config.m_height, 16u);
+		numSizes = 1;
+	}
+	else
+	{
+		bx::memCopy(sizes, s_defaultSizes, sizeof(sizes) );
+		numSizes = BX_COUNTOF(s_defaultSizes);
+	}
+
+	CacheModel cache;
+	cache.create(_allocator, cacheSize, lineSize, ways);
+
+	DBG("Cache sim: %u KB, %u byte lines, %u ways, %u sets, %s layout, %u pixel tiles, multi pass %s."
+		, cacheSize / 1024
+		, lineSize
+		, ways
+		, cache.m_setCount
+		, _config.m_blockLayout ? "2d block" : "linear"
+		, tileSize
+		, formats.m_name
+		);
+
+	bx::FileWriter writer;
+	bx::Error err;
+	bool written = bx::open(&writer, _config.m_outputPath, false, &err);
+	if (written)
+	{
+		bx::write(&writer, &err, "width,height,mode,lobe_count,lobe_pinch,radius_scale,order,taps_per_pixel,fetches_per_pixel,hit_rate,unique_texels_per_tile,bytes_per_pixel\n");
+	}
+
+	uint32_t numResults = 0;
+	for (uint32_t ss = 0; ss < numSizes; ++ss)
+	{
+		const uint32_t width = sizes[ss][0];
+		const uint32_t height = sizes[ss][1];
+
+		for (uint32_t mm = 0; mm < BX_COUNTOF(s_modes); ++mm)
+		{
+			// single pass reads scene color and linear depth, multi pass the half res intermediate
+			const bool multiPass = BokehDofMode::MultiPass == s_modes[mm];
+			const float levelScale = multiPass ? 0.5f : 1.0f;
+			const uint32_t levelWidth  = bx::max(uint32_t(float(width)  * levelScale), 1u);
+			const uint32_t levelHeight = bx::max(uint32_t(float(height) * levelScale), 1u);
+
+			SimTexture textures[2];
+			uint32_t numTextures = 0;
+			uint64_t firstLine = 0;
+			const uint32_t bytesPerTexel[2] =
+			{
+				multiPass ? formats.m_colorBytes : 8,
+				multiPass ? formats.m_blurSizeBytes : 2,
+			};
+			for (uint32_t ii = 0; ii < 2; ++ii)
+			{
+				if (0 != bytesPerTexel[ii])
+				{
+					textures[numTextures].create(_allocator, levelWidth, levelHeight, bytesPerTexel[ii], lineSize, _config.m_blockLayout, firstLine);
+					firstLine += textures[numTextures].m_lineCount;
+					++numTextures;
+				}
+			}
+
+			for (uint32_t ll = 0; ll < BX_COUNTOF(s_lobeSettings); ++ll)
+			{
+				for (uint32_t rr = 0; rr < BX_COUNTOF(s_radiusScales); ++rr)
+				{
+					BokehDofParams params;
+					params.m_mode = s_modes[mm];
+					params.m_focusPoint = kSweepFocusPoint;
+					params.m_focusScale = kSweepFocusScale;
+					params.m_maxBlurSize = kSweepMaxBlurSize;
+					params.m_radiusScale = s_radiusScales[rr];
+					params.m_lobeCount = s_lobeSettings[ll].m_lobeCount;
+					params.m_lobePinch = s_lobeSettings[ll].m_lobePinch;
+					params.m_frameIdx = 0;
+
+					const CpuGatherUniforms uniforms = cpuGatherUniforms(params, levelScale);
+
+					// tap coordinates of one warp, shared by every traversal order
+					const uint32_t tapCount = gatherTapCount(levelWidth, levelHeight, uniforms, uniforms.m_maxBlurSize);
+					float* uv = (float*)BX_ALLOC(_allocator, CACHE_SIM_WARP_SIZE * tapCount * 2 * sizeof(float) );
+
+					// unique texels do not depend on order, scanline repeats the tiled count
+					float uniqueTexelsPerTile = 0.0f;
+					for (uint32_t oo = 0; oo < TraversalOrder::Count; ++oo)
+					{
+						const TraversalOrder::Enum order = TraversalOrder::Enum(oo);
+						SimResult result = simulate(
+							  uv
+							, tapCount
+							, cache
+							, textures
+							, numTextures
+							, uniforms
+							, uniforms.m_maxBlurSize
+							, order
+							, tileSize
+							, width * height
+							, lineSize
+							);
+
+						if (TraversalOrder::Tiles == order)
+						{
+							uniqueTexelsPerTile = result.m_uniqueTexelsPerTile;
+						}
+						result.m_uniqueTexelsPerTile = uniqueTexelsPerTile;
+						++numResults;
+
+						if (written)
+						{
+							bx::write(&writer, &err, "%u,%u,%s,%d,%.2f,%.2f,%s,%.1f,%.1f,%.4f,%.1f,%.2f\n"
+								, width
+								, height
+								, multiPass ? "multi_pass" : "single_pass"
+								, params.m_lobeCount
+								, params.m_lobePinch
+								, params.m_radiusScale
+								, s_orderNames[order]
+								, result.m_tapsPerPixel
+								, result.m_fetchesPerPixel
+								, result.m_hitRate
+								, result.m_uniqueTexelsPerTile
+								, result.m_bytesPerPixel
+								);
+						}
+
+						DBG("Cache sim: %ux%u %s, %d lobes, radius scale %.2f, %s, %.1f taps per pixel, %.2f%% hits, %.1f unique texels per tile, %.2f bytes per pixel."
+							, width
+							, height
+							, multiPass ? "multi pass" : "single pass"
+							, params.m_lobeCount
+							, params.m_radiusScale
+							, s_orderNames[order]
+							, result.m_tapsPerPixel
+							, result.m_hitRate * 100.0f
+							, result.m_uniqueTexelsPerTile
+							, result.m_bytesPerPixel
+							);
+					}
+
+					BX_FREE(_allocator, uv);
+				}
+			}
+
+			for (uint32_t ii = 0; ii < numTextures; ++ii)
+			{
+				textures[ii].destroy();
+			}
+		}
+	}
+
+	if (written)
+	{
+		bx::close(&writer);
+		written = err.isOk();
+	}
+
+	DBG("Cache sim: %u configurations, %s %s, %.1f s."
+		, numResults
+		, written ? "wrote" : "failed to write"
+		, _config.m_outputPath
+		, double(bx::getHPCounter() - start) / double(bx::getHPFrequency() )
+		);
+
+	cache.destroy();
+
+	return written;
+}
@@ -0,0 +1,48 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_CACHESIM_H_HEADER_GUARD
+#define BOKEH_CACHESIM_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+#include "bokeh_dof.h"
+
+struct CacheSimConfig
+{
+	CacheSimConfig()
+		: m_outputPath("bokeh_cache.csv")
+		, m_width(0)
+		, m_height(0)
+		, m_cacheSize(16*1024)
+		, m_lineSize(64)
+		, m_ways(4)
+		, m_tileSize(8)
+		, m_format(IntermediateFormat::Rgba16f)
+		, m_blockLayout(true)
+	{
+	}
+
+	const char* m_outputPath;
+	uint32_t m_width;    // full res, 0 runs 320x180 and 640x360
+	uint32_t m_height;
+	uint32_t m_cacheSize; // bytes
+	uint32_t m_lineSize;  // bytes
+	uint32_t m_ways;
+	uint32_t m_tileSize;  // screen tile of the tiled order and of unique texel counts
+	IntermediateFormat::Enum m_format; // of the multi pass intermediate
+	bool m_blockLayout;   // cache lines hold 2d blocks of texels, else runs of a row
+};
+
+// Replays the texel accesses of the dof gather, the spiral of DepthOfField() at
+// each pixel with its noise rotation, lobe shape and texel size, through a set
+// associative LRU cache. Every tap is a bilinear fetch of a 2x2 footprint, from
+// color and depth in single pass or the half res intermediate in multi pass.
+// Pixels go in scanline order, in square screen tiles, or in 32 wide warps of
+// 2x2 quads fetching each tap in lockstep. Hit rate, unique texels per tile
+// and bytes fetched per full res pixel go to a csv per mode, lobe setting,
+// radius scale, order and resolution.
+bool runCacheSim(bx::AllocatorI* _allocator, const CacheSimConfig& _config);
+
+#endif // BOKEH_CACHESIM_H_HEADER_GUARD
@@ -0,0 +1,945 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bokeh_cpu.h"
+
+#include <bx/hash.h>
+#include <bx/math.h>
+#include <bx/timer.h>
+
+namespace {
+
+// same as bokeh_dof.sh and bokeh_mixed.sh
+#define GOLDEN_ANGLE				(2.39996323f)
+#define MIXED_TILE_SIZE				16
+#define MIXED_MAX_DILATE_RADIUS		4
+#define SEQUENCE_TILE_SIZE			16
+
+float smoothStep(float _edge0, float _edge1, float _x)
+{
+	const float tt = bx::clamp( (_x - _edge0) / (_edge1 - _edge0), 0.0f, 1.0f);
+	return tt * tt * (3.0f - 2.0f * tt);
+}
+
+float saturate(float _a)
+{
+	return bx::clamp(_a, 0.0f, 1.0f);
+}
+
+float shadertoyNoise(float _x, float _y)
+{
+	return bx::fract(bx::sin(_x * 12.9898f + _y * 78.233f) * 43758.5453123f);
+}
+
+float getBlurSize(float _depth, float _focusPoint, float _focusScale, float _maxBlurSize)
+{
+	const float circleOfConfusion = bx::clamp( (1.0f/_focusPoint - 1.0f/_depth) * _focusScale, -1.0f, 1.0f);
+	return circleOfConfusion * _maxBlurSize;
+}
+
+float bokehShapeFromAngle(float _lobeCount, float _radiusMin, float _radiusDelta2x, float _rotation, float _angle)
+{
+	// don't shape for 0, 1 blades...
+	if (_lobeCount <= 1.0f)
+	{
+		return 1.0f;
+	}
+
+	// divide edge into some number of lobes
+	const float invPeriod = _lobeCount / (2.0f * 3.1415926f);
+	float periodFraction = bx::fract(_angle * invPeriod + _rotation);
+
+	// apply triangle shape to each lobe to approximate blades of a camera aperture
+	periodFraction = bx::abs(periodFraction - 0.5f);
+	return periodFraction*_radiusDelta2x + _radiusMin;
+}
+
+// GetColorAndBlurSize() in bokeh_dof.sh
+void getColorAndBlurSize(float* _color, float* _blurSize, const CpuImage& _color4, const CpuImage* _depth, float _u, float _v, const CpuGatherUniforms& _uniforms)
+{
+	float sample[4];
+	_color4.sample(sample, _u, _v);
+	_color[0] = sample[0];
+	_color[1] = sample[1];
+	_color[2] = sample[2];
+
+	if (NULL != _depth)
+	{
+		float depth;
+		_depth->sample(&depth, _u, _v);
+		*_blurSize = getBlurSize(depth, _uniforms.m_focusPoint, _uniforms.m_focusScale, _uniforms.m_maxBlurSize);
+	}
+	else
+	{
+		*_blurSize = sample[3];
+	}
+}
+
+void gatherImage(CpuImage& _output, const CpuImage& _color, const CpuImage* _depth, const CpuGatherUniforms& _uniforms, uint64_t* _taps)
+{
+	for (uint32_t yy = 0; yy < _output.m_height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < _output.m_width; ++xx)
+		{
+			cpuDepthOfFieldPixel(_output.at(xx, yy), _color, _depth, xx, yy, _uniforms, _uniforms.m_maxBlurSize, _taps);
+		}
+	}
+}
+
+// same as DOWNSAMPLE_NEAR_DILATE_MIN in bokeh_dof.sh, in pixels of the level written,
+// half res with the uniforms callers pass
+#define DOWNSAMPLE_NEAR_DILATE_MIN	(1.0f)
+
+// fs_bokeh_dof_downsample, DownsampleColorAndBlurSize() in bokeh_dof.sh. Karis
+// weighted color of a 4x4 footprint and signed blur size of the given level. near
+// field texels take the nearest blur size of the footprint, the rest keep their own
+void downsamplePixel(CpuImage& _output, const CpuImage& _color, const CpuImage& _depth, uint32_t _x, uint32_t _y, const CpuGatherUniforms& _uniforms)
+{
+	const float uu = (float(_x) + 0.5f) / float(_output.m_width);
+	const float vv = (float(_y) + 0.5f) / float(_output.m_height);
+	const float texelU = 1.0f / float(_color.m_width);
+	const float texelV = 1.0f / float(_color.m_height);
+
+	float colors[16][4];
+	float blurSizes[16];
+	float centerBlurSize = 0.0f;
+	float nearMax = 0.0f;
+
+	for (uint32_t jj = 0; jj < 4; ++jj)
+	{
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			const uint32_t index = jj * 4 + ii;
+			const float offsetX = float(ii) - 1.5f;
+			const float offsetY = float(jj) - 1.5f;
+			const float sampleU = bx::clamp(uu + offsetX * texelU, 0.5f * texelU, 1.0f - 0.5f * texelU);
+			const float sampleV = bx::clamp(vv + offsetY * texelV, 0.5f * texelV, 1.0f - 0.5f * texelV);
+
+			float depth;
+			_color.sample(colors[index], sampleU, sampleV);
+			_depth.sample(&depth, sampleU, sampleV);
+			const float blurSize = getBlurSize(depth, _uniforms.m_focusPoint, _uniforms.m_focusScale, _uniforms.m_maxBlurSize);
+			blurSizes[index] = blurSize;
+
+			if (bx::abs(offsetX) < 1.0f
+			&&  bx::abs(offsetY) < 1.0f)
+			{
+				centerBlurSize += 0.25f * blurSize;
+			}
+			nearMax = bx::max(nearMax, -blurSize);
+		}
+	}
+
+	float outBlurSize = centerBlurSize;
+	if (-centerBlurSize >= DOWNSAMPLE_NEAR_DILATE_MIN)
+	{
+		outBlurSize = bx::min(outBlurSize, -nearMax);
+	}
+
+	float color[3] = { 0.0f, 0.0f, 0.0f };
+	float totalWeight = 0.0f;
+
+	for (uint32_t jj = 0; jj < 4; ++jj)
+	{
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			const uint32_t index = jj * 4 + ii;
+			const float tentX = 2.0f - bx::abs(float(ii) - 1.5f);
+			const float tentY = 2.0f - bx::abs(float(jj) - 1.5f);
+			const float* sample = colors[index];
+			const float luma = sample[0] * 0.2126f + sample[1] * 0.7152f + sample[2] * 0.0722f;
+			float weight = tentX * tentY / (1.0f + luma);
+			weight /= 1.0f + bx::abs(blurSizes[index] - outBlurSize);
+
+			color[0] += sample[0] * weight;
+			color[1] += sample[1] * weight;
+			color[2] += sample[2] * weight;
+			totalWeight += weight;
+		}
+	}
+
+	float* result = _output.at(_x, _y);
+	result[0] = color[0] / totalWeight;
+	result[1] = color[1] / totalWeight;
+	result[2] = color[2] / totalWeight;
+	result[3] = outBlurSize;
+}
+
+// fs_bokeh_dof_combine, composite lower res gather over sharp color
+void combinePixel(CpuImage& _output, const CpuImage& _color, const CpuImage& _blurred, uint32_t _x, uint32_t _y)
+{
+	const float uu = (float(_x) + 0.5f) / float(_output.m_width);
+	const float vv = (float(_y) + 0.5f) / float(_output.m_height);
+
+	float dof[4];
+	_blurred.sample(dof, uu, vv);
+
+	const float* color = _color.at(_x, _y);
+	const float mm = saturate(dof[3] - 1.0f);
+	float* result = _output.at(_x, _y);
+	result[0] = bx::lerp(color[0], dof[0], mm);
+	result[1] = bx::lerp(color[1], dof[1], mm);
+	result[2] = bx::lerp(color[2], dof[2], mm);
+	result[3] = 1.0f;
+}
+
+void combine(CpuImage& _output, const CpuImage& _color, const CpuImage& _blurred)
+{
+	for (uint32_t yy = 0; yy < _output.m_height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < _output.m_width; ++xx)
+		{
+			combinePixel(_output, _color, _blurred, xx, yy);
+		}
+	}
+}
+
+struct MixedLevels
+{
+	float m_halfThreshold;
+	float m_quarterThreshold;
+	float m_blendWidth;
+
+	// MixedLevelWeights() in bokeh_mixed.sh
+	void weights(float* _weights, float _tileBlurSize) const
+	{
+		const float toHalf = saturate( (_tileBlurSize - m_halfThreshold) / m_blendWidth);
+		const float toQuarter = saturate( (_tileBlurSize - m_quarterThreshold) / m_blendWidth);
+		_weights[0] = 1.0f - toHalf;
+		_weights[1] = toHalf - toQuarter;
+		_weights[2] = toQuarter;
+	}
+
+	// MixedLevelActive()
+	bool active(uint32_t _level, float _tileBlurSize, float _margin) const
+	{
+		const float lo = _tileBlurSize - _margin;
+		const float hi = _tileBlurSize + _margin;
+
+		if (0 == _level)
+		{
+			return lo < m_halfThreshold + m_blendWidth;
+		}
+		else if (1 == _level)
+		{
+			return hi > m_halfThreshold && lo < m_quarterThreshold + m_blendWidth;
+		}
+
+		return hi > m_quarterThreshold;
+	}
+};
+
+void mixedResolution(bx::AllocatorI* _allocator, CpuImage& _output, const CpuImage& _color, const CpuImage& _depth, const BokehDofParams& _params, uint64_t* _taps)
+{
+	const uint32_t width = _color.m_width;
+	const uint32_t height = _color.m_height;
+	const uint32_t tilesX = (width  + MIXED_TILE_SIZE - 1) / MIXED_TILE_SIZE;
+	const uint32_t tilesY = (height + MIXED_TILE_SIZE - 1) / MIXED_TILE_SIZE;
+
+	MixedLevels levels;
+	levels.m_blendWidth = bx::max(_params.m_mixedBlendWidth, 0.01f);
+	levels.m_halfThreshold = bx::max(_params.m_mixedHalfThreshold, 0.0f);
+	levels.m_quarterThreshold = bx::max(_params.m_mixedQuarterThreshold, levels.m_halfThreshold + levels.m_blendWidth);
+
+	const float levelScale[3] = { 1.0f, 0.5f, 0.25f };
+	CpuImage input[3];
+	CpuImage gathered[3];
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		const uint32_t levelWidth  = bx::max(uint32_t(float(width)  * levelScale[ii]), 1u);
+		const uint32_t levelHeight = bx::max(uint32_t(float(height) * levelScale[ii]), 1u);
+		gathered[ii].create(_allocator, levelWidth, levelHeight, 4);
+		if (0 != ii)
+		{
+			input[ii].create(_allocator, levelWidth, levelHeight, 4);
+		}
+	}
+
+	// quarter res from the 2x2 half res texels under each quarter texel, so it covers
+	// its whole 4x4 footprint. fs_bokeh_dof_mixed_downsample, near field kept
+	cpuDownsample(input[1], _color, _depth, cpuGatherUniforms(_params, 0.5f) );
+	for (uint32_t yy = 0; yy < input[2].m_height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < input[2].m_width; ++xx)
+		{
+			const float uu = (float(xx) + 0.5f) / float(input[2].m_width);
+			const float vv = (float(yy) + 0.5f) / float(input[2].m_height);
+			const float offsetU = 0.25f / float(input[2].m_width);
+			const float offsetV = 0.25f / float(input[2].m_height);
+
+			float samples[4][4];
+			input[1].sample(samples[0], uu - offsetU, vv - offsetV);
+			input[1].sample(samples[1], uu + offsetU, vv - offsetV);
+			input[1].sample(samples[2], uu - offsetU, vv + offsetV);
+			input[1].sample(samples[3], uu + offsetU, vv + offsetV);
+
+			float blurSize = 0.0f;
+			float nearMax = 0.0f;
+			for (uint32_t ii = 0; ii < 4; ++ii)
+			{
+				blurSize += 0.25f * samples[ii][3];
+				nearMax = bx::max(nearMax, -samples[ii][3]);
+			}
+
+			if (-blurSize >= DOWNSAMPLE_NEAR_DILATE_MIN)
+			{
+				blurSize = bx::min(blurSize, -nearMax);
+			}
+
+			float* result = input[2].at(xx, yy);
+			float totalWeight = 0.0f;
+			result[0] = result[1] = result[2] = 0.0f;
+			for (uint32_t ii = 0; ii < 4; ++ii)
+			{
+				const float weight = 1.0f / (1.0f + bx::abs(samples[ii][3] - blurSize) );
+				result[0] += samples[ii][0] * weight;
+				result[1] += samples[ii][1] * weight;
+				result[2] += samples[ii][2] * weight;
+				totalWeight += weight;
+			}
+
+			result[0] /= totalWeight;
+			result[1] /= totalWeight;
+			result[2] /= totalWeight;
+			result[3] = blurSize * 0.5f;
+		}
+	}
+
+	// tile max of half res blur size, in full res pixels, then dilate
+	CpuImage tileMax;
+	CpuImage tiles;
+	tileMax.create(_allocator, tilesX, tilesY, 1);
+	tiles.create(_allocator, tilesX, tilesY, 1);
+
+	const CpuImage& half = input[1];
+	for (uint32_t ty = 0; ty < tilesY; ++ty)
+	{
+		for (uint32_t tx = 0; tx < tilesX; ++tx)
+		{
+			float maxBlurSize = 0.0f;
+			for (uint32_t yy = 0; yy < MIXED_TILE_SIZE/2; ++yy)
+			{
+				for (uint32_t xx = 0; xx < MIXED_TILE_SIZE/2; ++xx)
+				{
+					const uint32_t sx = bx::min(tx * MIXED_TILE_SIZE/2 + xx, half.m_width  - 1);
+					const uint32_t sy = bx::min(ty * MIXED_TILE_SIZE/2 + yy, half.m_height - 1);
+					maxBlurSize = bx::max(maxBlurSize, bx::abs(half.at(sx, sy)[3]) );
+				}
+			}
+			*tileMax.at(tx, ty) = maxBlurSize / 0.5f;
+		}
+	}
+
+	const int32_t dilateRadius = int32_t(bx::min(bx::ceil(_params.m_maxBlurSize / float(MIXED_TILE_SIZE) ), float(MIXED_MAX_DILATE_RADIUS) ) );
+	for (int32_t ty = 0; ty < int32_t(tilesY); ++ty)
+	{
+		for (int32_t tx = 0; tx < int32_t(tilesX); ++tx)
+		{
+			float maxBlurSize = 0.0f;
+			for (int32_t yy = -dilateRadius; yy <= dilateRadius; ++yy)
+			{
+				for (int32_t xx = -dilateRadius; xx <= dilateRadius; ++xx)
+				{
+					const uint32_t sx = uint32_t(bx::clamp(tx + xx, 0, int32_t(tilesX) - 1) );
+					const uint32_t sy = uint32_t(bx::clamp(ty + yy, 0, int32_t(tilesY) - 1) );
+					maxBlurSize = bx::max(maxBlurSize, *tileMax.at(sx, sy) );
+				}
+			}
+			*tiles.at(uint32_t(tx), uint32_t(ty) ) = maxBlurSize;
+		}
+	}
+
+	const float tileUvScale[2] =
+	{
+		float(width)  / float(tilesX * MIXED_TILE_SIZE),
+		float(height) / float(tilesY * MIXED_TILE_SIZE),
+	};
+
+	// each level gathers only where it may get weight, spiral ends at the tile max
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		const CpuGatherUniforms uniforms = cpuGatherUniforms(_params, levelScale[ii]);
+		const float margin = _params.m_maxBlurSize * 2.0f / (levelScale[ii] * float(MIXED_TILE_SIZE) );
+		CpuImage& output = gathered[ii];
+
+		for (uint32_t yy = 0; yy < output.m_height; ++yy)
+		{
+			for (uint32_t xx = 0; xx < output.m_width; ++xx)
+			{
+				const float uu = (float(xx) + 0.5f) / float(output.m_width);
+				const float vv = (float(yy) + 0.5f) / float(output.m_height);
+				float tileBlurSize;
+				tiles.sample(&tileBlurSize, uu * tileUvScale[0], vv * tileUvScale[1]);
+
+				float* result = output.at(xx, yy);
+				if (!levels.active(ii, tileBlurSize, margin) )
+				{
+					result[0] = result[1] = result[2] = result[3] = 0.0f;
+					continue;
+				}
+
+				const float loopEnd = bx::min( (tileBlurSize + margin) * levelScale[ii], uniforms.m_maxBlurSize);
+				if (0 == ii)
+				{
+					cpuDepthOfFieldPixel(result, _color, &_depth, xx, yy, uniforms, loopEnd, _taps);
+				}
+				else
+				{
+					cpuDepthOfFieldPixel(result, input[ii], NULL, xx, yy, uniforms, loopEnd, _taps);
+				}
+				result[3] /= levelScale[ii];
+			}
+		}
+	}
+
+	// fs_bokeh_dof_mixed_combine
+	for (uint32_t yy = 0; yy < height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < width; ++xx)
+		{
+			const float uu = (float(xx) + 0.5f) / float(width);
+			const float vv = (float(yy) + 0.5f) / float(height);
+			float tileBlurSize;
+			tiles.sample(&tileBlurSize, uu * tileUvScale[0], vv * tileUvScale[1]);
+
+			float weights[3];
+			levels.weights(weights, tileBlurSize);
+
+			const float* color = _color.at(xx, yy);
+			const float* full = gathered[0].at(xx, yy);
+			float* result = _output.at(xx, yy);
+
+			float lowerColor[3] = { color[0], color[1], color[2] };
+			const float lowerWeight = weights[1] + weights[2];
+			if (lowerWeight > 0.0f)
+			{
+				float halfBlur[4];
+				float quarterBlur[4];
+				gathered[1].sample(halfBlur, uu, vv);
+				gathered[2].sample(quarterBlur, uu, vv);
+
+				float lower[4];
+				for (uint32_t cc = 0; cc < 4; ++cc)
+				{
+					lower[cc] = (halfBlur[cc] * weights[1] + quarterBlur[cc] * weights[2]) / lowerWeight;
+				}
+
+				const float mm = saturate(0.5f*lower[3] - 1.0f);
+				for (uint32_t cc = 0; cc < 3; ++cc)
+				{
+					lowerColor[cc] = bx::lerp(color[cc], lower[cc], mm);
+				}
+			}
+
+			for (uint32_t cc = 0; cc < 3; ++cc)
+			{
+				const float fullColor = weights[0] > 0.0f ? full[cc] : color[cc];
+				result[cc] = fullColor * weights[0] + lowerColor[cc] * lowerWeight;
+			}
+			result[3] = 1.0f;
+		}
+	}
+
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		input[ii].destroy();
+		gathered[ii].destroy();
+	}
+	tileMax.destroy();
+	tiles.destroy();
+}
+
+// pixels of an image at any level covered by a sequence tile, rounded outwards
+void tilePixelRange(uint32_t* _begin, uint32_t* _end, uint32_t _tile, uint32_t _fullSize, uint32_t _levelSize)
+{
+	const uint32_t fullBegin = _tile * SEQUENCE_TILE_SIZE;
+	const uint32_t fullEnd = bx::min(fullBegin + SEQUENCE_TILE_SIZE, _fullSize);
+	*_begin = uint32_t(uint64_t(fullBegin) * _levelSize / _fullSize);
+	*_end = bx::min(uint32_t( (uint64_t(fullEnd) * _levelSize + _fullSize - 1) / _fullSize), _levelSize);
+}
+
+uint32_t dilateTiles(uint8_t* _output, const uint8_t* _input, uint32_t _tilesX, uint32_t _tilesY, int32_t _radius)
+{
+	uint32_t count = 0;
+	for (int32_t ty = 0; ty < int32_t(_tilesY); ++ty)
+	{
+		for (int32_t tx = 0; tx < int32_t(_tilesX); ++tx)
+		{
+			uint8_t set = 0;
+			for (int32_t yy = bx::max(ty - _radius, 0); yy <= bx::min(ty + _radius, int32_t(_tilesY) - 1) && 0 == set; ++yy)
+			{
+				for (int32_t xx = bx::max(tx - _radius, 0); xx <= bx::min(tx + _radius, int32_t(_tilesX) - 1) && 0 == set; ++xx)
+				{
+					set = _input[yy * _tilesX + xx];
+				}
+			}
+			_output[ty * _tilesX + tx] = set;
+			count += set;
+		}
+	}
+	return count;
+}
+
+} // namespace
+
+CpuImage::CpuImage()
+	: m_allocator(NULL)
+	, m_data(NULL)
+	, m_width(0)
+	, m_height(0)
+	, m_channels(0)
+{
+}
+
+void CpuImage::create(bx::AllocatorI* _allocator, uint32_t _width, uint32_t _height, uint32_t _channels)
+{
+	m_allocator = _allocator;
+	m_width = _width;
+	m_height = _height;
+	m_channels = _channels;
+	m_data = (float*)BX_ALLOC(_allocator, _width * _height * _channels * sizeof(float) );
+	bx::memSet(m_data, 0, _width * _height * _channels * sizeof(float) );
+}
+
+void CpuImage::destroy()
+{
+	if (NULL != m_data)
+	{
+		BX_FREE(m_allocator, m_data);
+		m_data = NULL;
+	}
+}
+
+void CpuImage::sample(float* _result, float _u, float _v) const
+{
+	const float xx = _u * float(m_width)  - 0.5f;
+	const float yy = _v * float(m_height) - 0.5f;
+	const float x0f = bx::floor(xx);
+	const float y0f = bx::floor(yy);
+	const float fx = xx - x0f;
+	const float fy = yy - y0f;
+
+	const int32_t maxX = int32_t(m_width)  - 1;
+	const int32_t maxY = int32_t(m_height) - 1;
+	const uint32_t x0 = uint32_t(bx::clamp(int32_t(x0f),     0, maxX) );
+	const uint32_t x1 = uint32_t(bx::clamp(int32_t(x0f) + 1, 0, maxX) );
+	const uint32_t y0 = uint32_t(bx::clamp(int32_t(y0f),     0, maxY) );
+	const uint32_t y1 = uint32_t(bx::clamp(int32_t(y0f) + 1, 0, maxY) );
+
+	const float* t00 = at(x0, y0);
+	const float* t10 = at(x1, y0);
+	const float* t01 = at(x0, y1);
+	const float* t11 = at(x1, y1);
+
+	for (uint32_t ii = 0; ii < m_channels; ++ii)
+	{
+		const float top    = bx::lerp(t00[ii], t10[ii], fx);
+		const float bottom = bx::lerp(t01[ii], t11[ii], fx);
+		_result[ii] = bx::lerp(top, bottom, fy);
+	}
+}
+
+CpuGatherUniforms cpuGatherUniforms(const BokehDofParams& _params, float _levelScale)
+{
+	CpuGatherUniforms uniforms;
+	uniforms.m_maxBlurSize = _params.m_maxBlurSize * _levelScale;
+	uniforms.m_radiusScale = _params.m_radiusScale * _levelScale;
+	uniforms.m_focusPoint = _params.m_focusPoint;
+	uniforms.m_focusScale = _params.m_focusScale;
+	uniforms.m_lobeCount = float(_params.m_lobeCount);
+	uniforms.m_lobeRadiusMin = 1.0f - _params.m_lobePinch;
+	uniforms.m_lobeRadiusDelta2x = 2.0f * _params.m_lobePinch;
+	uniforms.m_lobeRotation = _params.m_lobeRotation;
+	uniforms.m_frameIdx = float(_params.m_frameIdx % 8);
+	return uniforms;
+}
+
+CpuSpiral::CpuSpiral(uint32_t _width, uint32_t _height, uint32_t _x, uint32_t _y, const CpuGatherUniforms& _uniforms, float _loopEnd)
+	: m_uniforms(&_uniforms)
+	, m_loopValue(_uniforms.m_radiusScale)
+	, m_loopEnd(_loopEnd)
+{
+	m_texel[0] = 1.0f / float(_width);
+	m_texel[1] = 1.0f / float(_height);
+	const float pixelX = float(_x) + 0.5f;
+	const float pixelY = float(_y) + 0.5f;
+	m_texCoord[0] = pixelX * m_texel[0];
+	m_texCoord[1] = pixelY * m_texel[1];
+
+	const float random = shadertoyNoise(pixelX + 314.0f*_uniforms.m_frameIdx, pixelY + 159.0f*_uniforms.m_frameIdx);
+	m_theta = random * bx::kPi2;
+}
+
+bool CpuSpiral::next(float* _u, float* _v, float* _radius)
+{
+	if (m_loopValue >= m_loopEnd)
+	{
+		return false;
+	}
+
+	const float radius = m_loopValue;
+	const float shapeScale = bokehShapeFromAngle(
+		  m_uniforms->m_lobeCount
+		, m_uniforms->m_lobeRadiusMin
+		, m_uniforms->m_lobeRadiusDelta2x
+		, m_uniforms->m_lobeRotation
+		, m_theta
+		);
+	*_u = m_texCoord[0] + bx::cos(m_theta) * m_texel[0] * (radius * shapeScale);
+	*_v = m_texCoord[1] + bx::sin(m_theta) * m_texel[1] * (radius * shapeScale);
+	*_radius = radius;
+
+	m_theta += GOLDEN_ANGLE;
+	m_loopValue += (m_uniforms->m_radiusScale/m_loopValue);
+	return true;
+}
+
+void cpuDepthOfFieldPixel(
+	  float* _result
+	, const CpuImage& _color
+	, const CpuImage* _depth
+	, uint32_t _x
+	, uint32_t _y
+	, const CpuGatherUniforms& _uniforms
+	, float _loopEnd
+	, uint64_t* _taps
+	)
+{
+	CpuSpiral spiral(_color.m_width, _color.m_height, _x, _y, _uniforms, _loopEnd);
+
+	float color[3];
+	float centerSize;
+	getColorAndBlurSize(color, &centerSize, _color, _depth, spiral.m_texCoord[0], spiral.m_texCoord[1], _uniforms);
+	const float absCenterSize = bx::abs(centerSize);
+
+	float total = 1.0f;
+	float totalSampleSize = 0.0f;
+	uint64_t taps = 0;
+
+	float spiralX;
+	float spiralY;
+	float radius;
+	while (spiral.next(&spiralX, &spiralY, &radius) )
+	{
+		float sampleColor[3];
+		float sampleSize;
+		getColorAndBlurSize(sampleColor, &sampleSize, _color, _depth, spiralX, spiralY, _uniforms);
+		float absSampleSize = bx::abs(sampleSize);
+
+		// using signed sample size as proxy for depth comparison
+		if (sampleSize > centerSize)
+		{
+			absSampleSize = bx::clamp(absSampleSize, 0.0f, absCenterSize*2.0f);
+		}
+
+		const float mm = smoothStep(radius-0.5f, radius+0.5f, absSampleSize);
+		for (uint32_t ii = 0; ii < 3; ++ii)
+		{
+			color[ii] += bx::lerp(color[ii]/total, sampleColor[ii], mm);
+		}
+		totalSampleSize += absSampleSize;
+		total += 1.0f;
+		++taps;
+	}
+
+	_result[0] = color[0] / total;
+	_result[1] = color[1] / total;
+	_result[2] = color[2] / total;
+	_result[3] = totalSampleSize / bx::max(total-1.0f, 1.0f);
+
+	if (NULL != _taps)
+	{
+		*_taps += taps;
+	}
+}
+
+void cpuDownsample(CpuImage& _output, const CpuImage& _color, const CpuImage& _depth, const CpuGatherUniforms& _uniforms)
+{
+	for (uint32_t yy = 0; yy < _output.m_height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < _output.m_width; ++xx)
+		{
+			downsamplePixel(_output, _color, _depth, xx, yy, _uniforms);
+		}
+	}
+}
+
+void cpuBokehDof(
+	  bx::AllocatorI* _allocator
+	, CpuImage& _output
+	, const CpuImage& _color
+	, const CpuImage& _depth
+	, const BokehDofParams& _params
+	, CpuDofStats* _stats
+	)
+{
+	const int64_t start = bx::getHPCounter();
+	uint64_t taps = 0;
+
+	switch (_params.m_mode)
+	{
+	case BokehDofMode::SinglePass:
+		gatherImage(_output, _color, &_depth, cpuGatherUniforms(_params, 1.0f), &taps);
+		break;
+
+	case BokehDofMode::MixedResolution:
+		mixedResolution(_allocator, _output, _color, _depth, _params, &taps);
+		break;
+
+	default:
+		{
+			const CpuGatherUniforms uniforms = cpuGatherUniforms(_params, 0.5f);
+			const uint32_t halfWidth = bx::max(_color.m_width/2, 1u);
+			const uint32_t halfHeight = bx::max(_color.m_height/2, 1u);
+
+			CpuImage quarterInput;
+			CpuImage quarterOutput;
+			quarterInput.create(_allocator, halfWidth, halfHeight, 4);
+			quarterOutput.create(_allocator, halfWidth, halfHeight, 4);
+
+			cpuDownsample(quarterInput, _color, _depth, uniforms);
+			gatherImage(quarterOutput, quarterInput, NULL, uniforms, &taps);
+			combine(_output, _color, quarterOutput);
+
+			quarterInput.destroy();
+			quarterOutput.destroy();
+		}
+		break;
+	}
+
+	if (NULL != _stats)
+	{
+		_stats->m_taps = taps;
+		_stats->m_timeMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+	}
+}
+
+CpuDofSequence::CpuDofSequence()
+	: m_allocator(NULL)
+	, m_width(0)
+	, m_height(0)
+	, m_tilesX(0)
+	, m_tilesY(0)
+	, m_hashes(NULL)
+	, m_changed(NULL)
+	, m_gather(NULL)
+	, m_combine(NULL)
+	, m_mode(BokehDofMode::Count)
+	, m_valid(false)
+	, m_fullTimeMs(0.0f)
+{
+	bx::memSet(&m_uniforms, 0, sizeof(m_uniforms) );
+}
+
+void CpuDofSequence::create(bx::AllocatorI* _allocator, uint32_t _width, uint32_t _height)
+{
+	m_allocator = _allocator;
+	m_width = _width;
+	m_height = _height;
+	m_tilesX = (_width  + SEQUENCE_TILE_SIZE - 1) / SEQUENCE_TILE_SIZE;
+	m_tilesY = (_height + SEQUENCE_TILE_SIZE - 1) / SEQUENCE_TILE_SIZE;
+
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	m_hashes = (uint32_t*)BX_ALLOC(_allocator, tileCount * sizeof(uint32_t) );
+	m_changed = (uint8_t*)BX_ALLOC(_allocator, tileCount * 3);
+	m_gather = m_changed + tileCount;
+	m_combine = m_gather + tileCount;
+
+	const uint32_t halfWidth = bx::max(_width/2, 1u);
+	const uint32_t halfHeight = bx::max(_height/2, 1u);
+	m_output.create(_allocator, _width, _height, 4);
+	m_halfInput.create(_allocator, halfWidth, halfHeight, 4);
+	m_halfOutput.create(_allocator, halfWidth, halfHeight, 4);
+
+	reset();
+}
+
+void CpuDofSequence::destroy()
+{
+	if (NULL != m_hashes)
+	{
+		BX_FREE(m_allocator, m_hashes);
+		BX_FREE(m_allocator, m_changed);
+		m_hashes = NULL;
+		m_changed = NULL;
+		m_gather = NULL;
+		m_combine = NULL;
+	}
+
+	m_output.destroy();
+	m_halfInput.destroy();
+	m_halfOutput.destroy();
+}
+
+void CpuDofSequence::reset()
+{
+	m_valid = false;
+}
+
+void CpuDofSequence::process(
+	  CpuImage& _output
+	, const CpuImage& _color
+	, const CpuImage& _depth
+	, const BokehDofParams& _params
+	, CpuSequenceStats* _stats
+	)
+{
+	const int64_t start = bx::getHPCounter();
+
+	if (_color.m_width != m_width
+	||  _color.m_height != m_height)
+	{
+		bx::AllocatorI* allocator = m_allocator;
+		destroy();
+		create(allocator, _color.m_width, _color.m_height);
+	}
+
+	const CpuGatherUniforms uniforms = cpuGatherUniforms(_params, 1.0f);
+	const bool full = false
+		|| !m_valid
+		|| _params.m_mode != m_mode
+		|| BokehDofMode::MixedResolution == _params.m_mode
+		|| 0 != bx::memCmp(&uniforms, &m_uniforms, sizeof(uniforms) )
+		;
+	m_valid = true;
+	m_mode = _params.m_mode;
+	m_uniforms = uniforms;
+
+	// hash each tile of color and depth, rows of a tile are contiguous
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	uint32_t changedTiles = 0;
+	for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+	{
+		for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+		{
+			const uint32_t x0 = tx * SEQUENCE_TILE_SIZE;
+			const uint32_t y0 = ty * SEQUENCE_TILE_SIZE;
+			const uint32_t x1 = bx::min(x0 + SEQUENCE_TILE_SIZE, m_width);
+			const uint32_t y1 = bx::min(y0 + SEQUENCE_TILE_SIZE, m_height);
+
+			bx::HashMurmur2A hash;
+			hash.begin();
+			for (uint32_t yy = y0; yy < y1; ++yy)
+			{
+				hash.add(_color.at(x0, yy), int32_t( (x1 - x0) * _color.m_channels * sizeof(float) ) );
+				hash.add(_depth.at(x0, yy), int32_t( (x1 - x0) * _depth.m_channels * sizeof(float) ) );
+			}
+
+			const uint32_t index = ty * m_tilesX + tx;
+			const uint32_t value = hash.end();
+			m_changed[index] = full || value != m_hashes[index] ? 1 : 0;
+			m_hashes[index] = value;
+			changedTiles += m_changed[index];
+		}
+	}
+
+	uint64_t taps = 0;
+	uint32_t recomputedTiles = 0;
+
+	if (BokehDofMode::MixedResolution == _params.m_mode)
+	{
+		CpuDofStats stats;
+		cpuBokehDof(m_allocator, m_output, _color, _depth, _params, &stats);
+		taps = stats.m_taps;
+		recomputedTiles = tileCount;
+	}
+	else if (BokehDofMode::SinglePass == _params.m_mode)
+	{
+		// a changed pixel reaches gathers up to the max blur size away, plus the bilinear tap
+		const int32_t radius = int32_t(bx::ceil( (uniforms.m_maxBlurSize + 2.0f) / float(SEQUENCE_TILE_SIZE) ) );
+		recomputedTiles = dilateTiles(m_gather, m_changed, m_tilesX, m_tilesY, radius);
+
+		for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+		{
+			for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+			{
+				if (0 == m_gather[ty * m_tilesX + tx])
+				{
+					continue;
+				}
+
+				const uint32_t x1 = bx::min( (tx + 1) * SEQUENCE_TILE_SIZE, m_width);
+				const uint32_t y1 = bx::min( (ty + 1) * SEQUENCE_TILE_SIZE, m_height);
+				for (uint32_t yy = ty * SEQUENCE_TILE_SIZE; yy < y1; ++yy)
+				{
+					for (uint32_t xx = tx * SEQUENCE_TILE_SIZE; xx < x1; ++xx)
+					{
+						cpuDepthOfFieldPixel(m_output.at(xx, yy), _color, &_depth, xx, yy, uniforms, uniforms.m_maxBlurSize, &taps);
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		// half res downsample and gather where any input they read may have changed,
+		// the gather footprint is the same in full res pixels. combine reads the
+		// half res result bilinearly, so it runs one tile further out
+		const CpuGatherUniforms halfUniforms = cpuGatherUniforms(_params, 0.5f);
+		const int32_t radius = int32_t(bx::ceil( (uniforms.m_maxBlurSize + 8.0f) / float(SEQUENCE_TILE_SIZE) ) );
+		dilateTiles(m_gather, m_changed, m_tilesX, m_tilesY, radius);
+		recomputedTiles = dilateTiles(m_combine, m_gather, m_tilesX, m_tilesY, 1);
+
+		for (uint32_t pass = 0; pass < 3; ++pass)
+		{
+			const uint8_t* mask = 2 == pass ? m_combine : m_gather;
+
+			for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+			{
+				for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+				{
+					if (0 == mask[ty * m_tilesX + tx])
+					{
+						continue;
+					}
+
+					const CpuImage& level = 2 == pass ? m_output : m_halfInput;
+					uint32_t x0, x1, y0, y1;
+					tilePixelRange(&x0, &x1, tx, m_width,  level.m_width);
+					tilePixelRange(&y0, &y1, ty, m_height, level.m_height);
+
+					for (uint32_t yy = y0; yy < y1; ++yy)
+					{
+						for (uint32_t xx = x0; xx < x1; ++xx)
+						{
+							if (0 == pass)
+							{
+								downsamplePixel(m_halfInput, _color, _depth, xx, yy, halfUniforms);
+							}
+							else if (1 == pass)
+							{
+								cpuDepthOfFieldPixel(m_halfOutput.at(xx, yy), m_halfInput, NULL, xx, yy, halfUniforms, halfUniforms.m_maxBlurSize, &taps);
+							}
+							else
+							{
+								combinePixel(m_output, _color, m_halfOutput, xx, yy);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// tiles left alone keep the previous frame's output
+	bx::memCopy(_output.m_data, m_output.m_data, m_width * m_height * 4 * sizeof(float) );
+
+	const float timeMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+	if (full)
+	{
+		m_fullTimeMs = timeMs;
+	}
+
+	if (NULL != _stats)
+	{
+		_stats->m_tileCount = tileCount;
+		_stats->m_changedTiles = changedTiles;
+		_stats->m_recomputedTiles = recomputedTiles;
+		_stats->m_skippedPercent = 100.0f * float(tileCount - recomputedTiles) / float(tileCount);
+		_stats->m_taps = taps;
+		_stats->m_timeMs = timeMs;
+		_stats->m_speedup = timeMs > 0.0f ? m_fullTimeMs / timeMs : 1.0f;
+	}
+}
@@ -0,0 +1,173 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_CPU_H_HEADER_GUARD
+#define BOKEH_CPU_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+#include "bokeh_dof.h"
+
+// Float image for the cpu versions of the dof passes. Sampling matches the gpu
+// targets: texel centers at half texel offsets, bilinear filter, clamp to edge.
+struct CpuImage
+{
+	CpuImage();
+
+	void create(bx::AllocatorI* _allocator, uint32_t _width, uint32_t _height, uint32_t _channels);
+	void destroy();
+
+	float* at(uint32_t _x, uint32_t _y)
+	{
+		return &m_data[(_y * m_width + _x) * m_channels];
+	}
+
+	const float* at(uint32_t _x, uint32_t _y) const
+	{
+		return &m_data[(_y * m_width + _x) * m_channels];
+	}
+
+	// writes m_channels floats
+	void sample(float* _result, float _u, float _v) const;
+
+	bx::AllocatorI* m_allocator;
+	float* m_data;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_channels;
+};
+
+// u_params of one pass, blur sizes and radius in pixels of the image gathered
+struct CpuGatherUniforms
+{
+	float m_maxBlurSize;
+	float m_radiusScale;
+	float m_focusPoint;
+	float m_focusScale;
+	float m_lobeCount;
+	float m_lobeRadiusMin;
+	float m_lobeRadiusDelta2x;
+	float m_lobeRotation;
+	float m_frameIdx;
+};
+
+CpuGatherUniforms cpuGatherUniforms(const BokehDofParams& _params, float _levelScale);
+
+// Spiral of DepthOfFieldRadius() for one pixel, apart from the image. Taps are in uv
+// of the image gathered, stepped by its texel size as with u_viewTexel, shaped by
+// BokehShapeFromAngle() and rotated by the per pixel noise. Keeps a pointer to the
+// uniforms.
+struct CpuSpiral
+{
+	CpuSpiral(uint32_t _width, uint32_t _height, uint32_t _x, uint32_t _y, const CpuGatherUniforms& _uniforms, float _loopEnd);
+
+	// next tap, false once the radius reaches loop end
+	bool next(float* _u, float* _v, float* _radius);
+
+	float m_texCoord[2]; // center tap
+	float m_texel[2];
+
+	const CpuGatherUniforms* m_uniforms;
+	float m_theta;
+	float m_loopValue;
+	float m_loopEnd;
+};
+
+// One pixel of DepthOfFieldRadius() in bokeh_dof.sh. Blur size is computed from
+// depth when given, else read from alpha of a packed color image. Result is
+// color and average sample size. Adds the number of spiral taps to _taps.
+void cpuDepthOfFieldPixel(
+	  float* _result
+	, const CpuImage& _color
+	, const CpuImage* _depth
+	, uint32_t _x
+	, uint32_t _y
+	, const CpuGatherUniforms& _uniforms
+	, float _loopEnd
+	, uint64_t* _taps
+	);
+
+// fs_bokeh_dof_downsample, packs Karis weighted color of a 4x4 footprint and signed
+// blur size of the given level, dilated by the near field
+void cpuDownsample(CpuImage& _output, const CpuImage& _color, const CpuImage& _depth, const CpuGatherUniforms& _uniforms);
+
+struct CpuDofStats
+{
+	uint64_t m_taps;   // spiral taps over all passes and pixels
+	float m_timeMs;
+};
+
+// Whole dof chain for single pass, multi pass and mixed resolution modes, output
+// is linear color in rgb at the size of the color input. Color is rgba linear,
+// depth holds linear view space depth in its first channel.
+void cpuBokehDof(
+	  bx::AllocatorI* _allocator
+	, CpuImage& _output
+	, const CpuImage& _color
+	, const CpuImage& _depth
+	, const BokehDofParams& _params
+	, CpuDofStats* _stats
+	);
+
+struct CpuSequenceStats
+{
+	uint32_t m_tileCount;
+	uint32_t m_changedTiles;    // color or depth hash differs from the previous frame
+	uint32_t m_recomputedTiles; // output tiles written this frame, the rest are copied
+	float m_skippedPercent;
+	uint64_t m_taps;
+	float m_timeMs;
+	float m_speedup;            // against the last frame that was recomputed in full
+};
+
+// Dof over an image sequence where little changes between frames, like a locked
+// off camera with small moving subjects. Color and depth are hashed per tile and
+// changed tiles are dilated by the footprint of the largest blur, since every
+// spiral runs to the max blur size and the average sample size reads each tap.
+// Only those tiles are gathered again, the rest of the output is copied from
+// the previous frame, so results match cpuBokehDof() exactly.
+//
+// Single pass and multi pass are incremental. Mixed resolution tiles depend on
+// the dilated tile max, those frames are recomputed in full. Any change of
+// params does the same, so keep m_frameIdx fixed over the sequence.
+class CpuDofSequence
+{
+public:
+	CpuDofSequence();
+
+	void create(bx::AllocatorI* _allocator, uint32_t _width, uint32_t _height);
+	void destroy();
+
+	// next frame is recomputed in full, as after a cut
+	void reset();
+
+	// output is rgba at the size of the color input, as for cpuBokehDof()
+	void process(
+		  CpuImage& _output
+		, const CpuImage& _color
+		, const CpuImage& _depth
+		, const BokehDofParams& _params
+		, CpuSequenceStats* _stats
+		);
+
+private:
+	bx::AllocatorI* m_allocator;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	uint32_t* m_hashes;
+	uint8_t* m_changed;
+	uint8_t* m_gather;
+	uint8_t* m_combine;
+	CpuImage m_output;
+	CpuImage m_halfInput;
+	CpuImage m_halfOutput;
+	CpuGatherUniforms m_uniforms;
+	BokehDofMode::Enum m_mode;
+	bool m_valid;
+	float m_fullTimeMs;
+};
+
+#endif // BOKEH_CPU_H_HEADER_GUARD
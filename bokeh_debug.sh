@@ -0,0 +1,40 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_DEBUG_SH
+#define BOKEH_DEBUG_SH
+
+// Tap count debug views. Counts are per full res pixel of the gather being counted,
+// see bokeh_tap_count.sh. Each texel of the reduce passes sums a block of
+// TAP_COUNT_REDUCE_BLOCK squared source texels.
+#define TAP_COUNT_REDUCE_BLOCK		16
+
+// struct DebugUniforms
+uniform vec4 u_debugParams[3];
+
+#define u_debugView					(u_debugParams[0].x)
+#define u_heatmapScale				(u_debugParams[0].y)
+#define u_tapCountShare				(u_debugParams[0].z)
+#define u_reduceSourceSize			(u_debugParams[1].xy)
+#define u_reduceOutputSize			(u_debugParams[1].zw)
+#define u_tapCountLevelSize			(u_debugParams[2].xy)
+
+// dark blue through green and yellow to red, as value goes from 0 to 1
+vec3 HeatmapColor (float value)
+{
+	float t = saturate(value) * 4.0;
+	vec3 c0 = vec3(0.0, 0.0, 0.3);
+	vec3 c1 = vec3(0.0, 0.3, 1.0);
+	vec3 c2 = vec3(0.0, 0.9, 0.2);
+	vec3 c3 = vec3(1.0, 0.9, 0.0);
+	vec3 c4 = vec3(1.0, 0.0, 0.0);
+
+	if (t < 1.0) { return mix(c0, c1, t); }
+	if (t < 2.0) { return mix(c1, c2, t - 1.0); }
+	if (t < 3.0) { return mix(c2, c3, t - 2.0); }
+	return mix(c3, c4, t - 3.0);
+}
+
+#endif // BOKEH_DEBUG_SH
@@ -0,0 +1,20 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_DEPTH_PYRAMID_SH
+#define BOKEH_DEPTH_PYRAMID_SH
+
+// min and max linear depth in rg of each mip. levels cover the rendered part of the
+// depth buffer from texel 0, 0, each level being half the one below, rounded down.
+
+// struct DepthPyramidUniforms
+uniform vec4 u_pyramidParams[2];
+
+#define u_sourceSize				(u_pyramidParams[0].xy)
+#define u_outputSize				(u_pyramidParams[0].zw)
+#define u_sourceOffset				(u_pyramidParams[1].xy)
+#define u_depthTexelSize			(u_pyramidParams[1].zw)
+
+#endif // BOKEH_DEPTH_PYRAMID_SH
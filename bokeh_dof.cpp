@@ -0,0 +1,1002 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bokeh_dof.h"
+
+#include <bx/math.h>
+#include <bgfx_utils.h>
+
+bgfx::VertexLayout PosTexCoord0Vertex::ms_layout;
+
+namespace {
+
+static const IntermediateFormatInfo s_intermediateFormats[] =
+{
+	{ "rgba16f",             bgfx::TextureFormat::RGBA16F,  bgfx::TextureFormat::Count, 8, 0 },
+	{ "rg11b10f + r8 coc",   bgfx::TextureFormat::RG11B10F, bgfx::TextureFormat::R8,    4, 1 },
+	{ "rg11b10f + r16f coc", bgfx::TextureFormat::RG11B10F, bgfx::TextureFormat::R16F,  4, 2 },
+	{ "rgb9e5 + r16f coc",   bgfx::TextureFormat::RGB9E5F,  bgfx::TextureFormat::R16F,  4, 2 },
+};
+BX_STATIC_ASSERT(BX_COUNTOF(s_intermediateFormats) == IntermediateFormat::Count);
+
+// single channel max blur size per screen tile, see bokeh_mixed.sh
+static const IntermediateFormatInfo s_tileFormat =
+	{ "tile max", bgfx::TextureFormat::R16F, bgfx::TextureFormat::Count, 2, 0 };
+
+#define MIXED_TILE_SIZE				16
+#define MIXED_MAX_DILATE_RADIUS		4
+
+// full, half and quarter res levels of mixed resolution
+static const float s_mixedLevelScale[] = { 1.0f, 0.5f, 0.25f };
+
+// per pixel tap counts, then sums over blocks of texels, see fs_bokeh_dof_tap_count_reduce
+static const IntermediateFormatInfo s_tapCountFormat =
+	{ "tap counts", bgfx::TextureFormat::RGBA16F, bgfx::TextureFormat::Count, 8, 0 };
+static const IntermediateFormatInfo s_tapCountSumFormat =
+	{ "tap count sums", bgfx::TextureFormat::RGBA32F, bgfx::TextureFormat::Count, 16, 0 };
+
+#define TAP_COUNT_REDUCE_BLOCK		16
+
+// indexed by BokehDof::DofProgram
+static const char* s_dofFragmentShaders[] =
+{
+	"fs_bokeh_dof_downsample",
+	"fs_bokeh_dof_second_pass",
+	"fs_bokeh_dof_combine",
+	"fs_bokeh_dof_downsample_split",
+	"fs_bokeh_dof_second_pass_split",
+	"fs_bokeh_dof_combine_split",
+	"fs_bokeh_dof_single_pass",
+	"fs_bokeh_dof_debug",
+	"fs_bokeh_dof_tile_max",
+	"fs_bokeh_dof_tile_dilate",
+	"fs_bokeh_dof_mixed_full",
+	"fs_bokeh_dof_mixed_lower",
+	"fs_bokeh_dof_mixed_combine",
+	"fs_bokeh_dof_mixed_downsample",
+	NULL, // compute
+	"fs_bokeh_dof_tap_count",
+	"fs_bokeh_dof_tap_count_lower",
+	"fs_bokeh_dof_tap_count_lower_split",
+	"fs_bokeh_dof_tap_count_mixed_full",
+	"fs_bokeh_dof_tap_count_mixed_lower",
+	"fs_bokeh_dof_tap_count_reduce",
+};
+
+static const char* s_dofViewNames[BokehDof::ViewCount] =
+{
+	"bokeh dof downsample",
+	"bokeh dof mixed downsample",
+	"bokeh dof tile max",
+	"bokeh dof tile dilate",
+	"bokeh dof mixed full",
+	"bokeh dof quarter",
+	"bokeh dof quarter compute",
+	"bokeh dof mixed quarter",
+	"bokeh dof tap count",
+	"bokeh dof tap count reduce",
+	"bokeh dof tap count totals",
+	"bokeh dof output",
+};
+
+#define DOF_VIEW_DOWNSAMPLE			0
+#define DOF_VIEW_MIXED_DOWNSAMPLE	1
+#define DOF_VIEW_TILE_MAX			2
+#define DOF_VIEW_TILE_DILATE		3
+#define DOF_VIEW_MIXED_FULL			4
+#define DOF_VIEW_QUARTER			5
+#define DOF_VIEW_QUARTER_COMPUTE	6
+#define DOF_VIEW_MIXED_QUARTER		7
+#define DOF_VIEW_TAP_COUNT			8
+#define DOF_VIEW_TAP_COUNT_REDUCE	9
+#define DOF_VIEW_TAP_COUNT_TOTALS	10
+#define DOF_VIEW_OUTPUT				11
+
+float getTexelHalf()
+{
+	return bgfx::RendererType::Direct3D9 == bgfx::getRendererType() ? 0.5f : 0.0f;
+}
+
+// invalid when the triangle comes from the vertex id, see setScreenTriangle
+bgfx::VertexBufferHandle createScreenSpaceTriangle(float _textureWidth, float _textureHeight, bool _originBottomLeft)
+{
+	if (isScreenTriangleVertexless() )
+	{
+		bgfx::VertexBufferHandle invalid = BGFX_INVALID_HANDLE;
+		return invalid;
+	}
+
+	PosTexCoord0Vertex vertices[3];
+	fillScreenSpaceTriangle(vertices, _textureWidth, _textureHeight, getTexelHalf(), _originBottomLeft);
+	return bgfx::createVertexBuffer(bgfx::copy(vertices, sizeof(vertices) ), PosTexCoord0Vertex::ms_layout);
+}
+
+void destroyScreenSpaceTriangle(bgfx::VertexBufferHandle _triangle)
+{
+	if (bgfx::isValid(_triangle) )
+	{
+		bgfx::destroy(_triangle);
+	}
+}
+
+// taps of the DepthOfFieldRadius() loop, the same for every pixel
+uint32_t spiralTapCount(float _radiusScale, float _loopEnd)
+{
+	uint32_t count = 0;
+	for (float loopValue = _radiusScale; loopValue < _loopEnd; loopValue += _radiusScale/loopValue)
+	{
+		++count;
+	}
+	return count;
+}
+
+} // namespace
+
+void fillScreenSpaceTriangle(PosTexCoord0Vertex* _vertices, float _textureWidth, float _textureHeight, float _texelHalf, bool _originBottomLeft, float _width, float _height)
+{
+	const float minx = -_width;
+	const float maxx =  _width;
+	const float miny = 0.0f;
+	const float maxy =  _height * 2.0f;
+
+	const float texelHalfW = _texelHalf / _textureWidth;
+	const float texelHalfH = _texelHalf / _textureHeight;
+	const float minu = -1.0f + texelHalfW;
+	const float maxu =  1.0f + texelHalfW;
+
+	const float zz = 0.0f;
+
+	float minv = texelHalfH;
+	float maxv = 2.0f + texelHalfH;
+
+	if (_originBottomLeft)
+	{
+		float temp = minv;
+		minv = maxv;
+		maxv = temp;
+
+		minv -= 1.0f;
+		maxv -= 1.0f;
+	}
+
+	_vertices[0].m_x = minx;
+	_vertices[0].m_y = miny;
+	_vertices[0].m_z = zz;
+	_vertices[0].m_u = minu;
+	_vertices[0].m_v = minv;
+
+	_vertices[1].m_x = maxx;
+	_vertices[1].m_y = miny;
+	_vertices[1].m_z = zz;
+	_vertices[1].m_u = maxu;
+	_vertices[1].m_v = minv;
+
+	_vertices[2].m_x = maxx;
+	_vertices[2].m_y = maxy;
+	_vertices[2].m_z = zz;
+	_vertices[2].m_u = maxu;
+	_vertices[2].m_v = maxv;
+}
+
+bool isScreenTriangleVertexless()
+{
+	return 0 != (bgfx::getCaps()->supported & BGFX_CAPS_VERTEX_ID);
+}
+
+const char* getScreenTriangleVertexShader()
+{
+	return isScreenTriangleVertexless()
+		? "vs_bokeh_fullscreen"
+		: "vs_bokeh_screenquad"
+		;
+}
+
+void setScreenTriangle(bgfx::Encoder* _encoder, bgfx::VertexBufferHandle _fallback)
+{
+	if (isScreenTriangleVertexless() )
+	{
+		_encoder->setVertexCount(3);
+	}
+	else
+	{
+		_encoder->setVertexBuffer(0, _fallback);
+	}
+}
+
+void setScreenTriangle(float _textureWidth, float _textureHeight, bool _originBottomLeft)
+{
+	if (isScreenTriangleVertexless() )
+	{
+		bgfx::setVertexCount(3);
+	}
+	else if (3 == bgfx::getAvailTransientVertexBuffer(3, PosTexCoord0Vertex::ms_layout) )
+	{
+		bgfx::TransientVertexBuffer vb;
+		bgfx::allocTransientVertexBuffer(&vb, 3, PosTexCoord0Vertex::ms_layout);
+		PosTexCoord0Vertex* vertex = (PosTexCoord0Vertex*)vb.data;
+		fillScreenSpaceTriangle(vertex, _textureWidth, _textureHeight, getTexelHalf(), _originBottomLeft);
+		bgfx::setVertexBuffer(0, &vb);
+	}
+}
+
+const IntermediateFormatInfo& getIntermediateFormatInfo(IntermediateFormat::Enum _format)
+{
+	return s_intermediateFormats[_format];
+}
+
+bool isIntermediateFormatSupported(const IntermediateFormatInfo& _formats)
+{
+	const bgfx::Caps* caps = bgfx::getCaps();
+	const uint16_t required = 0
+		| BGFX_CAPS_FORMAT_TEXTURE_2D
+		| BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER
+		;
+
+	if (required != (caps->formats[_formats.m_color] & required) )
+	{
+		return false;
+	}
+
+	if (bgfx::TextureFormat::Count != _formats.m_blurSize
+	&&  required != (caps->formats[_formats.m_blurSize] & required) )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+BokehDof::BokehDof()
+	: m_format(IntermediateFormat::Rgba16f)
+	, m_width(0)
+	, m_height(0)
+	, m_computeGatherSupported(false)
+	, m_mixedSupported(false)
+	, m_tapCountSupported(false)
+	, m_originBottomLeft(false)
+	, m_created(false)
+	, m_firstView(0)
+{
+	m_output.idx = bgfx::kInvalidHandle;
+	m_tileCount[0] = 0;
+	m_tileCount[1] = 0;
+	m_tapCountReduceSize[0] = 0;
+	m_tapCountReduceSize[1] = 0;
+}
+
+bool BokehDof::create(uint32_t _width, uint32_t _height, const BokehDofConfig& _config)
+{
+	const bgfx::Caps* caps = bgfx::getCaps();
+
+	m_config = _config;
+	m_width = _width;
+	m_height = _height;
+	m_originBottomLeft = caps->originBottomLeft;
+	m_output.idx = bgfx::kInvalidHandle;
+
+	// fall back to rgba16f if hardware can't render to the selected format set
+	m_format = isIntermediateFormatSupported(s_intermediateFormats[_config.m_intermediateFormat])
+		? _config.m_intermediateFormat
+		: IntermediateFormat::Rgba16f
+		;
+
+	// compute gather writes blur size packed in alpha of an image writable format
+	m_computeGatherSupported = true
+		&& 0 != (caps->supported & BGFX_CAPS_COMPUTE)
+		&& 0 != (caps->formats[bgfx::TextureFormat::RGBA16F] & BGFX_CAPS_FORMAT_TEXTURE_IMAGE_WRITE)
+		&& IntermediateFormat::Rgba16f == m_format
+		;
+
+	// mixed resolution gathers read blur size packed in alpha
+	m_mixedSupported = true
+		&& _config.m_mixedResolution
+		&& IntermediateFormat::Rgba16f == m_format
+		&& isIntermediateFormatSupported(s_tileFormat)
+		;
+
+	// sums of tap counts overflow half floats
+	m_tapCountSupported = true
+		&& _config.m_tapCounts
+		&& isIntermediateFormatSupported(s_tapCountFormat)
+		&& isIntermediateFormatSupported(s_tapCountSumFormat)
+		;
+
+	PosTexCoord0Vertex::init();
+
+	m_uniforms.init();
+	bx::memSet(m_uniforms.m_params, 0, sizeof(m_uniforms.m_params) );
+	s_color = bgfx::createUniform("s_color", bgfx::UniformType::Sampler);
+	s_depth = bgfx::createUniform("s_depth", bgfx::UniformType::Sampler);
+	s_blurredColor = bgfx::createUniform("s_blurredColor", bgfx::UniformType::Sampler);
+	s_blurSize = bgfx::createUniform("s_blurSize", bgfx::UniformType::Sampler);
+
+	m_mixedUniforms.init();
+	bx::memSet(m_mixedUniforms.m_params, 0, sizeof(m_mixedUniforms.m_params) );
+	s_tiles = bgfx::createUniform("s_tiles", bgfx::UniformType::Sampler);
+	s_fullBlur = bgfx::createUniform("s_fullBlur", bgfx::UniformType::Sampler);
+	s_quarterBlur = bgfx::createUniform("s_quarterBlur", bgfx::UniformType::Sampler);
+
+	m_debugUniforms.init();
+	bx::memSet(m_debugUniforms.m_params, 0, sizeof(m_debugUniforms.m_params) );
+	s_tapCounts = bgfx::createUniform("s_tapCounts", bgfx::UniformType::Sampler);
+
+	// programs load when a pass first needs them, see getProgram
+	for (uint32_t ii = 0; ii < DofProgram::Count; ++ii)
+	{
+		m_programs[ii].idx = bgfx::kInvalidHandle;
+		m_programRequested[ii] = false;
+	}
+
+	createTargets();
+	m_created = true;
+
+	return true;
+}
+
+void BokehDof::destroy()
+{
+	if (!m_created)
+	{
+		return;
+	}
+
+	destroyTargets();
+
+	for (uint32_t ii = 0; ii < DofProgram::Count; ++ii)
+	{
+		if (bgfx::isValid(m_programs[ii]) )
+		{
+			bgfx::destroy(m_programs[ii]);
+		}
+	}
+
+	bgfx::destroy(s_color);
+	bgfx::destroy(s_depth);
+	bgfx::destroy(s_blurredColor);
+	bgfx::destroy(s_blurSize);
+	m_uniforms.destroy();
+	bgfx::destroy(s_tiles);
+	bgfx::destroy(s_fullBlur);
+	bgfx::destroy(s_quarterBlur);
+	m_mixedUniforms.destroy();
+	bgfx::destroy(s_tapCounts);
+	m_debugUniforms.destroy();
+
+	m_created = false;
+}
+
+bgfx::ProgramHandle BokehDof::getProgram(DofProgram::Enum _program)
+{
+	// a program failing to load stays invalid, its passes are dropped by bgfx
+	if (!m_programRequested[_program])
+	{
+		m_programRequested[_program] = true;
+
+		const bool isCompute = DofProgram::QuarterCompute == _program;
+		const char* vsName = isCompute ? "cs_bokeh_dof_second_pass" : getScreenTriangleVertexShader();
+		const char* fsName = isCompute ? NULL : s_dofFragmentShaders[_program];
+		m_programs[_program] = NULL != m_config.m_loadProgram
+			? m_config.m_loadProgram(vsName, fsName, m_config.m_loadProgramUserData)
+			: loadProgram(vsName, fsName)
+			;
+	}
+
+	return m_programs[_program];
+}
+
+void BokehDof::resize(uint32_t _width, uint32_t _height)
+{
+	if (m_width == _width
+	&&  m_height == _height)
+	{
+		return;
+	}
+
+	destroyTargets();
+	m_width = _width;
+	m_height = _height;
+	createTargets();
+
+	// views point at the old frame buffers
+	setupViews(m_firstView, m_output);
+}
+
+void BokehDof::setupViews(bgfx::ViewId _firstView, bgfx::FrameBufferHandle _output)
+{
+	m_firstView = _firstView;
+	m_output = _output;
+
+	const uint16_t halfWidth = uint16_t(m_width/2);
+	const uint16_t halfHeight = uint16_t(m_height/2);
+	const uint16_t quarterWidth = uint16_t(m_width/4);
+	const uint16_t quarterHeight = uint16_t(m_height/4);
+	const uint16_t tilesX = uint16_t(m_tileCount[0]);
+	const uint16_t tilesY = uint16_t(m_tileCount[1]);
+
+	float orthoProj[16];
+	bx::mtxOrtho(orthoProj, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, bgfx::getCaps()->homogeneousDepth);
+
+	for (uint32_t ii = 0; ii < ViewCount; ++ii)
+	{
+		const bgfx::ViewId view = bgfx::ViewId(_firstView + ii);
+		bgfx::setViewName(view, s_dofViewNames[ii]);
+		bgfx::setViewTransform(view, NULL, orthoProj);
+		bgfx::setViewClear(view, BGFX_CLEAR_NONE);
+	}
+
+	bgfx::setViewRect(_firstView + DOF_VIEW_DOWNSAMPLE, 0, 0, halfWidth, halfHeight);
+	bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_DOWNSAMPLE, m_quarterInput.m_buffer);
+
+	bgfx::setViewRect(_firstView + DOF_VIEW_QUARTER, 0, 0, halfWidth, halfHeight);
+	bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_QUARTER, m_quarterOutput.m_buffer);
+
+	// compute writes the output as an image, don't bind it as render target too
+	bgfx::setViewRect(_firstView + DOF_VIEW_QUARTER_COMPUTE, 0, 0, halfWidth, halfHeight);
+	bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_QUARTER_COMPUTE, BGFX_INVALID_HANDLE);
+
+	// mixed resolution views stay empty when not supported
+	if (m_mixedSupported)
+	{
+		bgfx::setViewRect(_firstView + DOF_VIEW_MIXED_DOWNSAMPLE, 0, 0, quarterWidth, quarterHeight);
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_MIXED_DOWNSAMPLE, m_mixedQuarterInput.m_buffer);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_TILE_MAX, 0, 0, tilesX, tilesY);
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_TILE_MAX, m_tileMax.m_buffer);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_TILE_DILATE, 0, 0, tilesX, tilesY);
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_TILE_DILATE, m_tileDilated.m_buffer);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_MIXED_FULL, 0, 0, uint16_t(m_width), uint16_t(m_height) );
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_MIXED_FULL, m_mixedFull.m_buffer);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_MIXED_QUARTER, 0, 0, quarterWidth, quarterHeight);
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_MIXED_QUARTER, m_mixedQuarterOutput.m_buffer);
+	}
+
+	if (m_tapCountSupported)
+	{
+		// count passes of a frame add up, see submitTapCountPass
+		bgfx::setViewRect(_firstView + DOF_VIEW_TAP_COUNT, 0, 0, uint16_t(m_width), uint16_t(m_height) );
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_TAP_COUNT, m_tapCounts.m_buffer);
+		bgfx::setViewClear(_firstView + DOF_VIEW_TAP_COUNT, BGFX_CLEAR_COLOR, 0x00000000, 1.0f, 0);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_TAP_COUNT_REDUCE, 0, 0, uint16_t(m_tapCountReduceSize[0]), uint16_t(m_tapCountReduceSize[1]) );
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_TAP_COUNT_REDUCE, m_tapCountReduce.m_buffer);
+
+		bgfx::setViewRect(_firstView + DOF_VIEW_TAP_COUNT_TOTALS, 0, 0, TapCountTotalsSize, TapCountTotalsSize);
+		bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_TAP_COUNT_TOTALS, m_tapCountTotals.m_buffer);
+	}
+
+	bgfx::setViewRect(_firstView + DOF_VIEW_OUTPUT, 0, 0, uint16_t(m_width), uint16_t(m_height) );
+	bgfx::setViewFrameBuffer(_firstView + DOF_VIEW_OUTPUT, _output);
+}
+
+void BokehDof::submit(bgfx::Encoder* _encoder, bgfx::ViewId _firstView, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params)
+{
+	BX_ASSERT(_firstView == m_firstView, "Views %d are not set up, call setupViews() first.", _firstView);
+	BX_UNUSED(_firstView);
+
+	updateUniforms(_params);
+
+	// u_params is shared with the app, values it left are unknown
+	m_uniforms.invalidate();
+
+	if (BokehDofMode::MixedResolution == _params.m_mode
+	&&  m_mixedSupported)
+	{
+		submitMixedResolution(_encoder, _color, _depth, _params);
+		return;
+	}
+
+	const uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_DEPTH_TEST_ALWAYS
+		;
+
+	if (BokehDofMode::SinglePass == _params.m_mode
+	||  BokehDofMode::Debug == _params.m_mode)
+	{
+		const DofProgram::Enum program = BokehDofMode::Debug == _params.m_mode
+			? DofProgram::Debug
+			: DofProgram::SinglePass
+			;
+
+		const bool tapCounts = true
+			&& BokehDofMode::Debug == _params.m_mode
+			&& BokehDofDebugView::CircleOfConfusion != _params.m_debugView
+			&& m_tapCountSupported
+			;
+
+		if (tapCounts)
+		{
+			submitTapCounts(_encoder, _color, _depth, _params);
+		}
+
+		// debug view 0 tints by blur size, the rest map tap counts to a heatmap scaled by
+		// the full res single pass spiral, so modes compare on the same scale
+		m_debugUniforms.m_debugView = tapCounts ? float(_params.m_debugView) : 0.0f;
+		m_debugUniforms.m_heatmapScale = float(bx::max(spiralTapCount(m_uniforms.m_radiusScale, m_uniforms.m_maxBlurSize), 1u) );
+
+		_encoder->setState(state);
+		_encoder->setTexture(0, s_color, _color);
+		_encoder->setTexture(1, s_depth, _depth);
+		if (tapCounts)
+		{
+			_encoder->setTexture(4, s_tapCounts, m_tapCounts.m_texture);
+		}
+		m_uniforms.submitChanged(_encoder);
+		if (BokehDofMode::Debug == _params.m_mode)
+		{
+			m_debugUniforms.submit(_encoder);
+		}
+		setScreenTriangle(_encoder, m_fullTriangle);
+		_encoder->submit(m_firstView + DOF_VIEW_OUTPUT, getProgram(program));
+		return;
+	}
+
+	// compact formats keep blur size in a second target, see DofRenderTarget
+	const bool splitBlurSize = bgfx::isValid(m_quarterInput.m_blurSizeTexture);
+
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, _color);
+	_encoder->setTexture(1, s_depth, _depth);
+	m_uniforms.submitChanged(_encoder);
+	setScreenTriangle(_encoder, m_halfTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_DOWNSAMPLE, getProgram(splitBlurSize ? DofProgram::DownsampleSplit : DofProgram::Downsample));
+
+	if (isComputeGatherActive(_params) )
+	{
+		// groupshared tile cache version, see cs_bokeh_dof_second_pass.sc
+		const uint32_t tileSize = 8;
+		const uint32_t halfWidth = m_width/2;
+		const uint32_t halfHeight = m_height/2;
+
+		_encoder->setTexture(0, s_color, m_quarterInput.m_texture);
+		_encoder->setImage(1, m_quarterOutput.m_texture, 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA16F);
+		m_uniforms.submitChanged(_encoder);
+		_encoder->dispatch(m_firstView + DOF_VIEW_QUARTER_COMPUTE
+			, getProgram(DofProgram::QuarterCompute)
+			, (halfWidth  + tileSize - 1) / tileSize
+			, (halfHeight + tileSize - 1) / tileSize
+			, 1
+			);
+	}
+	else
+	{
+		_encoder->setState(state);
+		_encoder->setTexture(0, s_color, m_quarterInput.m_texture);
+		if (splitBlurSize)
+		{
+			_encoder->setTexture(1, s_blurSize, m_quarterInput.m_blurSizeTexture);
+		}
+		m_uniforms.submitChanged(_encoder);
+		setScreenTriangle(_encoder, m_halfTriangle);
+		_encoder->submit(m_firstView + DOF_VIEW_QUARTER, getProgram(splitBlurSize ? DofProgram::QuarterSplit : DofProgram::Quarter));
+	}
+
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, _color);
+	_encoder->setTexture(1, s_depth, _depth);
+	_encoder->setTexture(2, s_blurredColor, m_quarterOutput.m_texture);
+	if (splitBlurSize)
+	{
+		_encoder->setTexture(3, s_blurSize, m_quarterOutput.m_blurSizeTexture);
+	}
+	m_uniforms.submitChanged(_encoder);
+	setScreenTriangle(_encoder, m_fullTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_OUTPUT, getProgram(splitBlurSize ? DofProgram::CombineSplit : DofProgram::Combine));
+}
+
+void BokehDof::submitMixedTiles(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params)
+{
+	const uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_DEPTH_TEST_ALWAYS
+		;
+
+	// thresholds must leave room to blend, see MixedLevelWeights
+	const float blendWidth = bx::max(_params.m_mixedBlendWidth, 0.01f);
+	const float halfThreshold = bx::max(_params.m_mixedHalfThreshold, 0.0f);
+	const float quarterThreshold = bx::max(_params.m_mixedQuarterThreshold, halfThreshold + blendWidth);
+
+	MixedResolutionUniforms& mixed = m_mixedUniforms;
+	mixed.m_tileUvScale[0] = float(m_width)  / float(m_tileCount[0] * MIXED_TILE_SIZE);
+	mixed.m_tileUvScale[1] = float(m_height) / float(m_tileCount[1] * MIXED_TILE_SIZE);
+	mixed.m_halfThreshold = halfThreshold;
+	mixed.m_quarterThreshold = quarterThreshold;
+	mixed.m_blendWidth = blendWidth;
+	mixed.m_tileDilateRadius = bx::min(bx::ceil(_params.m_maxBlurSize / float(MIXED_TILE_SIZE) ), float(MIXED_MAX_DILATE_RADIUS) );
+	mixed.m_tileSourceTexel[0] = 1.0f / float(bx::max(m_width/2, 1u) );
+	mixed.m_tileSourceTexel[1] = 1.0f / float(bx::max(m_height/2, 1u) );
+
+	// color and signed blur size at half and quarter res
+	setLevelScale(_params, 0.5f);
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, _color);
+	_encoder->setTexture(1, s_depth, _depth);
+	m_uniforms.submitChanged(_encoder);
+	setScreenTriangle(_encoder, m_halfTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_DOWNSAMPLE, getProgram(DofProgram::Downsample));
+
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, m_quarterInput.m_texture);
+	setScreenTriangle(_encoder, m_quarterTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_MIXED_DOWNSAMPLE, getProgram(DofProgram::MixedDownsample));
+
+	// tile max from the half res blur sizes, then spread to neighbours it can reach
+	mixed.m_levelScale = 0.5f;
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, m_quarterInput.m_texture);
+	mixed.submit(_encoder);
+	setScreenTriangle(_encoder, m_tileTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_TILE_MAX, getProgram(DofProgram::TileMax));
+
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_tiles, m_tileMax.m_texture);
+	mixed.submit(_encoder);
+	setScreenTriangle(_encoder, m_tileTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_TILE_DILATE, getProgram(DofProgram::TileDilate));
+}
+
+void BokehDof::setMixedLevel(const BokehDofParams& _params, uint32_t _level)
+{
+	const float scale = s_mixedLevelScale[_level];
+	setLevelScale(_params, scale);
+
+	MixedResolutionUniforms& mixed = m_mixedUniforms;
+	mixed.m_level = float(_level);
+	mixed.m_levelScale = scale;
+	// tile max changes by at most max blur size per tile, over two texels of this level
+	mixed.m_levelMargin = _params.m_maxBlurSize * 2.0f / (scale * float(MIXED_TILE_SIZE) );
+}
+
+void BokehDof::submitMixedResolution(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params)
+{
+	const uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_DEPTH_TEST_ALWAYS
+		;
+
+	submitMixedTiles(_encoder, _color, _depth, _params);
+
+	// each level skips pixels it can't get weight in, kernel ends at the tile max
+	struct Level
+	{
+		bgfx::ViewId m_view;
+		bgfx::TextureHandle m_input;
+		bgfx::VertexBufferHandle m_triangle;
+	};
+
+	const Level levels[] =
+	{
+		{ bgfx::ViewId(m_firstView + DOF_VIEW_MIXED_FULL),    BGFX_INVALID_HANDLE,              m_fullTriangle    },
+		{ bgfx::ViewId(m_firstView + DOF_VIEW_QUARTER),       m_quarterInput.m_texture,         m_halfTriangle    },
+		{ bgfx::ViewId(m_firstView + DOF_VIEW_MIXED_QUARTER), m_mixedQuarterInput.m_texture,    m_quarterTriangle },
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(levels) == BX_COUNTOF(s_mixedLevelScale) );
+
+	MixedResolutionUniforms& mixed = m_mixedUniforms;
+	for (uint32_t ii = 0; ii < BX_COUNTOF(levels); ++ii)
+	{
+		const Level& level = levels[ii];
+		setMixedLevel(_params, ii);
+
+		_encoder->setState(state);
+		if (0 == ii)
+		{
+			_encoder->setTexture(0, s_color, _color);
+			_encoder->setTexture(1, s_depth, _depth);
+			_encoder->setTexture(2, s_tiles, m_tileDilated.m_texture);
+		}
+		else
+		{
+			_encoder->setTexture(0, s_color, level.m_input);
+			_encoder->setTexture(1, s_tiles, m_tileDilated.m_texture);
+		}
+		m_uniforms.submitChanged(_encoder);
+		mixed.submit(_encoder);
+		setScreenTriangle(_encoder, level.m_triangle);
+		_encoder->submit(level.m_view, getProgram(0 == ii ? DofProgram::MixedFull : DofProgram::MixedLower));
+	}
+
+	// stitch levels with the same weights used to pick them
+	setLevelScale(_params, 1.0f);
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_color, _color);
+	_encoder->setTexture(1, s_depth, _depth);
+	_encoder->setTexture(2, s_tiles, m_tileDilated.m_texture);
+	_encoder->setTexture(3, s_fullBlur, m_mixedFull.m_texture);
+	_encoder->setTexture(4, s_blurredColor, m_quarterOutput.m_texture);
+	_encoder->setTexture(5, s_quarterBlur, m_mixedQuarterOutput.m_texture);
+	m_uniforms.submitChanged(_encoder);
+	mixed.submit(_encoder);
+	setScreenTriangle(_encoder, m_fullTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_OUTPUT, getProgram(DofProgram::MixedCombine));
+}
+
+void BokehDof::submitTapCountPass(bgfx::Encoder* _encoder, DofProgram::Enum _program, uint32_t _levelWidth, uint32_t _levelHeight)
+{
+	// counts add up over the passes of a frame, pixel count in w stays at 1
+	const uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_DEPTH_TEST_ALWAYS
+		| BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ZERO)
+		;
+
+	// a level texel's taps are shared by the full res pixels it covers
+	DebugUniforms& debug = m_debugUniforms;
+	debug.m_tapCountShare = float(_levelWidth * _levelHeight) / float(m_width * m_height);
+	debug.m_tapCountLevelSize[0] = float(_levelWidth);
+	debug.m_tapCountLevelSize[1] = float(_levelHeight);
+
+	_encoder->setState(state);
+	m_uniforms.submitChanged(_encoder);
+	debug.submit(_encoder);
+	setScreenTriangle(_encoder, m_fullTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_TAP_COUNT, getProgram(_program));
+}
+
+void BokehDof::submitTapCounts(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params)
+{
+	const uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_DEPTH_TEST_ALWAYS
+		;
+
+	// executed, contributing and wasted taps per pixel of the gather the counted mode
+	// runs. each of its gather passes is replayed with the uniforms and inputs that pass
+	// gets, so inputs are rendered as that mode renders them
+	switch (getGatherMode(_params) )
+	{
+	case BokehDofMode::MultiPass:
+		{
+			const bool splitBlurSize = bgfx::isValid(m_quarterInput.m_blurSizeTexture);
+
+			setLevelScale(_params, 0.5f);
+			_encoder->setState(state);
+			_encoder->setTexture(0, s_color, _color);
+			_encoder->setTexture(1, s_depth, _depth);
+			m_uniforms.submitChanged(_encoder);
+			setScreenTriangle(_encoder, m_halfTriangle);
+			_encoder->submit(m_firstView + DOF_VIEW_DOWNSAMPLE, getProgram(splitBlurSize ? DofProgram::DownsampleSplit : DofProgram::Downsample));
+
+			// the compute gather runs the same spiral over the same input
+			_encoder->setTexture(0, s_color, m_quarterInput.m_texture);
+			if (splitBlurSize)
+			{
+				_encoder->setTexture(1, s_depth, m_quarterInput.m_blurSizeTexture);
+			}
+			submitTapCountPass(_encoder
+				, splitBlurSize ? DofProgram::TapCountLowerSplit : DofProgram::TapCountLower
+				, m_width/2
+				, m_height/2
+				);
+		}
+		break;
+
+	case BokehDofMode::MixedResolution:
+		submitMixedTiles(_encoder, _color, _depth, _params);
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_mixedLevelScale); ++ii)
+		{
+			setMixedLevel(_params, ii);
+
+			if (0 == ii)
+			{
+				_encoder->setTexture(0, s_color, _color);
+				_encoder->setTexture(1, s_depth, _depth);
+			}
+			else
+			{
+				_encoder->setTexture(0, s_color, 1 == ii ? m_quarterInput.m_texture : m_mixedQuarterInput.m_texture);
+			}
+			_encoder->setTexture(2, s_tiles, m_tileDilated.m_texture);
+			m_mixedUniforms.submit(_encoder);
+			submitTapCountPass(_encoder
+				, 0 == ii ? DofProgram::TapCountMixedFull : DofProgram::TapCountMixedLower
+				, bx::max(uint32_t(float(m_width)  * s_mixedLevelScale[ii]), 1u)
+				, bx::max(uint32_t(float(m_height) * s_mixedLevelScale[ii]), 1u)
+				);
+		}
+		break;
+
+	default:
+		_encoder->setTexture(0, s_color, _color);
+		_encoder->setTexture(1, s_depth, _depth);
+		submitTapCountPass(_encoder, DofProgram::TapCount, m_width, m_height);
+		break;
+	}
+
+	// debug output is full res
+	setLevelScale(_params, 1.0f);
+
+	// sum blocks of counts twice, down to a fixed size grid the app can read back
+	DebugUniforms& debug = m_debugUniforms;
+	debug.m_reduceSourceSize[0] = float(m_width);
+	debug.m_reduceSourceSize[1] = float(m_height);
+	debug.m_reduceOutputSize[0] = float(m_tapCountReduceSize[0]);
+	debug.m_reduceOutputSize[1] = float(m_tapCountReduceSize[1]);
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_tapCounts, m_tapCounts.m_texture);
+	debug.submit(_encoder);
+	setScreenTriangle(_encoder, m_tapCountReduceTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_TAP_COUNT_REDUCE, getProgram(DofProgram::TapCountReduce));
+
+	debug.m_reduceSourceSize[0] = float(m_tapCountReduceSize[0]);
+	debug.m_reduceSourceSize[1] = float(m_tapCountReduceSize[1]);
+	debug.m_reduceOutputSize[0] = float(TapCountTotalsSize);
+	debug.m_reduceOutputSize[1] = float(TapCountTotalsSize);
+	_encoder->setState(state);
+	_encoder->setTexture(0, s_tapCounts, m_tapCountReduce.m_texture);
+	debug.submit(_encoder);
+	setScreenTriangle(_encoder, m_tapCountTotalsTriangle);
+	_encoder->submit(m_firstView + DOF_VIEW_TAP_COUNT_TOTALS, getProgram(DofProgram::TapCountReduce));
+}
+
+uint32_t BokehDof::getGpuMemorySize() const
+{
+	const IntermediateFormatInfo& formats = s_intermediateFormats[m_format];
+	const uint32_t halfPixels = (m_width/2) * (m_height/2);
+	uint32_t targetBytes = 2 * halfPixels * (formats.m_colorBytes + formats.m_blurSizeBytes);
+	// no vertex buffers when the triangle comes from the vertex id
+	const uint32_t triangleBytes = isScreenTriangleVertexless() ? 0 : 3 * sizeof(PosTexCoord0Vertex);
+	uint32_t vertexBytes = 2 * triangleBytes;
+
+	if (m_mixedSupported)
+	{
+		const uint32_t quarterPixels = (m_width/4) * (m_height/4);
+		const uint32_t tiles = m_tileCount[0] * m_tileCount[1];
+		targetBytes += (m_width * m_height + 2 * quarterPixels) * formats.m_colorBytes;
+		targetBytes += 2 * tiles * s_tileFormat.m_colorBytes;
+		vertexBytes += 2 * triangleBytes;
+	}
+
+	if (m_tapCountSupported)
+	{
+		const uint32_t reduceTexels = m_tapCountReduceSize[0] * m_tapCountReduceSize[1];
+		targetBytes += m_width * m_height * s_tapCountFormat.m_colorBytes;
+		targetBytes += (reduceTexels + TapCountTotalsSize * TapCountTotalsSize) * s_tapCountSumFormat.m_colorBytes;
+		vertexBytes += 2 * triangleBytes;
+	}
+
+	return targetBytes + vertexBytes;
+}
+
+void BokehDof::createTargets()
+{
+	const uint64_t bilinearFlags = 0
+		| BGFX_TEXTURE_RT
+		| BGFX_SAMPLER_U_CLAMP
+		| BGFX_SAMPLER_V_CLAMP
+		;
+
+	const IntermediateFormatInfo& formats = s_intermediateFormats[m_format];
+	const uint32_t halfWidth = bx::max(m_width/2, 1u);
+	const uint32_t halfHeight = bx::max(m_height/2, 1u);
+
+	m_quarterInput.init(halfWidth, halfHeight, formats, bilinearFlags);
+	// compute gather writes its output as an image
+	const uint64_t quarterOutputFlags = m_computeGatherSupported
+		? bilinearFlags | BGFX_TEXTURE_COMPUTE_WRITE
+		: bilinearFlags
+		;
+	m_quarterOutput.init(halfWidth, halfHeight, formats, quarterOutputFlags);
+
+	// texel half offset on d3d9 depends on target size
+	m_fullTriangle = createScreenSpaceTriangle(float(m_width), float(m_height), m_originBottomLeft);
+	m_halfTriangle = createScreenSpaceTriangle(float(halfWidth), float(halfHeight), m_originBottomLeft);
+
+	m_tileCount[0] = (m_width  + MIXED_TILE_SIZE - 1) / MIXED_TILE_SIZE;
+	m_tileCount[1] = (m_height + MIXED_TILE_SIZE - 1) / MIXED_TILE_SIZE;
+
+	if (m_mixedSupported)
+	{
+		const uint32_t quarterWidth = bx::max(m_width/4, 1u);
+		const uint32_t quarterHeight = bx::max(m_height/4, 1u);
+
+		m_mixedFull.init(m_width, m_height, formats, bilinearFlags);
+		m_mixedQuarterInput.init(quarterWidth, quarterHeight, formats, bilinearFlags);
+		m_mixedQuarterOutput.init(quarterWidth, quarterHeight, formats, bilinearFlags);
+		m_tileMax.init(m_tileCount[0], m_tileCount[1], s_tileFormat, bilinearFlags);
+		m_tileDilated.init(m_tileCount[0], m_tileCount[1], s_tileFormat, bilinearFlags);
+
+		m_quarterTriangle = createScreenSpaceTriangle(float(quarterWidth), float(quarterHeight), m_originBottomLeft);
+		m_tileTriangle = createScreenSpaceTriangle(float(m_tileCount[0]), float(m_tileCount[1]), m_originBottomLeft);
+	}
+
+	// two reductions by TAP_COUNT_REDUCE_BLOCK cover targets up to 4096 square
+	m_tapCountReduceSize[0] = bx::min( (m_width  + TAP_COUNT_REDUCE_BLOCK - 1) / TAP_COUNT_REDUCE_BLOCK, uint32_t(TapCountTotalsSize * TAP_COUNT_REDUCE_BLOCK) );
+	m_tapCountReduceSize[1] = bx::min( (m_height + TAP_COUNT_REDUCE_BLOCK - 1) / TAP_COUNT_REDUCE_BLOCK, uint32_t(TapCountTotalsSize * TAP_COUNT_REDUCE_BLOCK) );
+
+	if (m_tapCountSupported)
+	{
+		const uint64_t pointFlags = 0
+			| BGFX_TEXTURE_RT
+			| BGFX_SAMPLER_POINT
+			| BGFX_SAMPLER_U_CLAMP
+			| BGFX_SAMPLER_V_CLAMP
+			;
+
+		m_tapCounts.init(m_width, m_height, s_tapCountFormat, pointFlags);
+		m_tapCountReduce.init(m_tapCountReduceSize[0], m_tapCountReduceSize[1], s_tapCountSumFormat, pointFlags);
+		m_tapCountTotals.init(TapCountTotalsSize, TapCountTotalsSize, s_tapCountSumFormat, pointFlags);
+
+		m_tapCountReduceTriangle = createScreenSpaceTriangle(float(m_tapCountReduceSize[0]), float(m_tapCountReduceSize[1]), m_originBottomLeft);
+		m_tapCountTotalsTriangle = createScreenSpaceTriangle(float(TapCountTotalsSize), float(TapCountTotalsSize), m_originBottomLeft);
+	}
+}
+
+void BokehDof::destroyTargets()
+{
+	m_quarterInput.destroy();
+	m_quarterOutput.destroy();
+	destroyScreenSpaceTriangle(m_fullTriangle);
+	destroyScreenSpaceTriangle(m_halfTriangle);
+
+	if (m_mixedSupported)
+	{
+		m_mixedFull.destroy();
+		m_mixedQuarterInput.destroy();
+		m_mixedQuarterOutput.destroy();
+		m_tileMax.destroy();
+		m_tileDilated.destroy();
+		destroyScreenSpaceTriangle(m_quarterTriangle);
+		destroyScreenSpaceTriangle(m_tileTriangle);
+	}
+
+	if (m_tapCountSupported)
+	{
+		m_tapCounts.destroy();
+		m_tapCountReduce.destroy();
+		m_tapCountTotals.destroy();
+		destroyScreenSpaceTriangle(m_tapCountReduceTriangle);
+		destroyScreenSpaceTriangle(m_tapCountTotalsTriangle);
+	}
+}
+
+void BokehDof::updateUniforms(const BokehDofParams& _params)
+{
+	// reduce dimensions by half to go along with smaller render target
+	// debug views run at full res, tap counts set the scale of each pass they replay
+	const bool fullRes = false
+		|| BokehDofMode::SinglePass == _params.m_mode
+		|| BokehDofMode::Debug == _params.m_mode
+		;
+	setLevelScale(_params, fullRes ? 1.0f : 0.5f);
+	m_uniforms.m_frameIdx = float(_params.m_frameIdx % 8);
+	m_uniforms.m_lobeRotation = _params.m_lobeRotation;
+	m_uniforms.m_blurSteps = _params.m_blurSteps;
+	m_uniforms.m_lobeCount = float(_params.m_lobeCount);
+	m_uniforms.m_lobeRadiusMin = (1.0f - _params.m_lobePinch);
+	m_uniforms.m_lobeRadiusDelta2x = 2.0f * _params.m_lobePinch;
+	m_uniforms.m_focusPoint = _params.m_focusPoint;
+	m_uniforms.m_focusScale = _params.m_focusScale;
+
+	// scene is rendered into the top left of max sized targets, which is the
+	// top of texture space when origin is bottom left
+	const uint32_t renderWidth = 0 != _params.m_renderWidth ? _params.m_renderWidth : m_width;
+	const uint32_t renderHeight = 0 != _params.m_renderHeight ? _params.m_renderHeight : m_height;
+	const float scaleX = float(renderWidth) / float(m_width);
+	const float scaleY = float(renderHeight) / float(m_height);
+	m_uniforms.m_sceneUvScale[0] = scaleX;
+	m_uniforms.m_sceneUvScale[1] = scaleY;
+	m_uniforms.m_sceneUvOffset[0] = 0.0f;
+	m_uniforms.m_sceneUvOffset[1] = m_originBottomLeft ? 1.0f - scaleY : 0.0f;
+	m_uniforms.m_sceneTexelSize[0] = 1.0f / float(m_width);
+	m_uniforms.m_sceneTexelSize[1] = 1.0f / float(m_height);
+	m_uniforms.m_renderScale = bx::min(scaleX, scaleY);
+}
+
+void BokehDof::setLevelScale(const BokehDofParams& _params, float _scale)
+{
+	// blur sizes and spiral steps in pixels of the target being rendered
+	m_uniforms.m_maxBlurSize = _params.m_maxBlurSize * _scale;
+	m_uniforms.m_radiusScale = _params.m_radiusScale * _scale;
+}
@@ -0,0 +1,531 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_DOF_H_HEADER_GUARD
+#define BOKEH_DOF_H_HEADER_GUARD
+
+#include <bx/bx.h>
+#include <bgfx/bgfx.h>
+
+// Vertex decl for our screen space quad (used in deferred rendering)
+struct PosTexCoord0Vertex
+{
+	float m_x;
+	float m_y;
+	float m_z;
+	float m_u;
+	float m_v;
+
+	static void init()
+	{
+		ms_layout
+			.begin()
+			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+			.end();
+	}
+
+	static bgfx::VertexLayout ms_layout;
+};
+
+// Single triangle covering the unit square of an ortho projection, see setScreenTriangle
+void fillScreenSpaceTriangle(PosTexCoord0Vertex* _vertices, float _textureWidth, float _textureHeight, float _texelHalf, bool _originBottomLeft, float _width = 1.0f, float _height = 1.0f);
+
+// Full screen passes draw one triangle over the view. With BGFX_CAPS_VERTEX_ID it is
+// made from gl_VertexID in vs_bokeh_fullscreen and no vertex buffer is bound. Other
+// renderers, like d3d9, draw the fillScreenSpaceTriangle one through vs_bokeh_screenquad.
+bool isScreenTriangleVertexless();
+
+// vertex shader to pair with full screen fragment shaders
+const char* getScreenTriangleVertexShader();
+
+// before submit. fallback is a static triangle made for the size of the target
+void setScreenTriangle(bgfx::Encoder* _encoder, bgfx::VertexBufferHandle _fallback);
+
+// same through the bgfx API, fallback is a transient triangle for the target size
+void setScreenTriangle(float _textureWidth, float _textureHeight, bool _originBottomLeft);
+
+// Sets of formats used for scene color and the lower res dof intermediates. With
+// RGBA16F the blur size rides along in alpha. The compact color formats have no
+// alpha, so the signed blur size goes to a second, single channel target instead.
+struct IntermediateFormat
+{
+	enum Enum
+	{
+		Rgba16f,
+		Rg11b10fR8,
+		Rg11b10fR16f,
+		Rgb9e5R16f,
+
+		Count
+	};
+};
+
+struct IntermediateFormatInfo
+{
+	const char* m_name;
+	bgfx::TextureFormat::Enum m_color;
+	bgfx::TextureFormat::Enum m_blurSize; // TextureFormat::Count when packed into color alpha
+	uint32_t m_colorBytes;
+	uint32_t m_blurSizeBytes;
+};
+
+const IntermediateFormatInfo& getIntermediateFormatInfo(IntermediateFormat::Enum _format);
+
+bool isIntermediateFormatSupported(const IntermediateFormatInfo& _formats);
+
+struct PassUniforms
+{
+	enum { NumVec4 = 6 };
+
+	void init() {
+		u_params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4, NumVec4);
+		invalidate();
+	};
+
+	void submit() const {
+		bgfx::setUniform(u_params, m_params, NumVec4);
+	}
+
+	void submit(bgfx::Encoder* _encoder) const {
+		_encoder->setUniform(u_params, m_params, NumVec4);
+	}
+
+	// Upload only when values differ from the last upload made here. bgfx keeps
+	// uniform values between draws in execution order, which is submission order
+	// while each pass goes to a later view. Call invalidate() at the start of such a
+	// sequence and after anything else set u_params, as other instances share it.
+	void submitChanged() {
+		if (takeChanged() ) {
+			bgfx::setUniform(u_params, m_params, NumVec4);
+		}
+	}
+
+	void submitChanged(bgfx::Encoder* _encoder) {
+		if (takeChanged() ) {
+			_encoder->setUniform(u_params, m_params, NumVec4);
+		}
+	}
+
+	void invalidate() {
+		m_uploadValid = false;
+	}
+
+	void destroy() {
+		bgfx::destroy(u_params);
+	}
+
+	bool takeChanged() {
+		if (m_uploadValid
+		&&  0 == bx::memCmp(m_uploaded, m_params, sizeof(m_params) ) ) {
+			return false;
+		}
+
+		bx::memCopy(m_uploaded, m_params, sizeof(m_params) );
+		m_uploadValid = true;
+		return true;
+	}
+
+	union
+	{
+		struct
+		{
+			/* 0    */ struct { float m_depthUnpackConsts[2]; float m_frameIdx; float m_lobeRotation; };
+			/* 1    */ struct { float m_ndcToViewMul[2]; float m_ndcToViewAdd[2]; };
+			/* 2    */ struct { float m_blurSteps; float m_lobeCount; float m_lobeRadiusMin; float m_lobeRadiusDelta2x; };
+			/* 3    */ struct { float m_maxBlurSize; float m_focusPoint; float m_focusScale; float m_radiusScale; };
+			/* 4    */ struct { float m_sceneUvScale[2]; float m_sceneUvOffset[2]; };
+			/* 5    */ struct { float m_sceneTexelSize[2]; float m_renderScale; float m_unused5; };
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	float m_uploaded[NumVec4 * 4];
+	bool m_uploadValid;
+
+	bgfx::UniformHandle u_params;
+};
+
+struct MixedResolutionUniforms
+{
+	enum { NumVec4 = 3 };
+
+	void init() {
+		u_params = bgfx::createUniform("u_mixedParams", bgfx::UniformType::Vec4, NumVec4);
+	};
+
+	void submit(bgfx::Encoder* _encoder) const {
+		_encoder->setUniform(u_params, m_params, NumVec4);
+	}
+
+	void destroy() {
+		bgfx::destroy(u_params);
+	}
+
+	union
+	{
+		struct
+		{
+			/* 0    */ struct { float m_tileUvScale[2]; float m_halfThreshold; float m_quarterThreshold; };
+			/* 1    */ struct { float m_blendWidth; float m_levelScale; float m_levelMargin; float m_tileDilateRadius; };
+			/* 2    */ struct { float m_tileSourceTexel[2]; float m_level; float m_unused2; };
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	bgfx::UniformHandle u_params;
+};
+
+struct DebugUniforms
+{
+	enum { NumVec4 = 3 };
+
+	void init() {
+		u_params = bgfx::createUniform("u_debugParams", bgfx::UniformType::Vec4, NumVec4);
+	};
+
+	void submit(bgfx::Encoder* _encoder) const {
+		_encoder->setUniform(u_params, m_params, NumVec4);
+	}
+
+	void destroy() {
+		bgfx::destroy(u_params);
+	}
+
+	union
+	{
+		struct
+		{
+			/* 0    */ struct { float m_debugView; float m_heatmapScale; float m_tapCountShare; float m_unused0; };
+			/* 1    */ struct { float m_reduceSourceSize[2]; float m_reduceOutputSize[2]; };
+			/* 2    */ struct { float m_tapCountLevelSize[2]; float m_unused2[2]; };
+		};
+
+		float m_params[NumVec4 * 4];
+	};
+
+	bgfx::UniformHandle u_params;
+};
+
+// Render target for dof intermediates, color plus optional separate blur size
+struct DofRenderTarget
+{
+	void init(uint32_t _width, uint32_t _height, const IntermediateFormatInfo& _formats, uint64_t _flags)
+	{
+		bgfx::TextureHandle textures[2];
+		uint8_t numTextures = 0;
+
+		m_texture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, _formats.m_color, _flags);
+		textures[numTextures++] = m_texture;
+
+		m_blurSizeTexture.idx = bgfx::kInvalidHandle;
+		if (bgfx::TextureFormat::Count != _formats.m_blurSize)
+		{
+			m_blurSizeTexture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, _formats.m_blurSize, _flags);
+			textures[numTextures++] = m_blurSizeTexture;
+		}
+
+		const bool destroyTextures = true;
+		m_buffer = bgfx::createFrameBuffer(numTextures, textures, destroyTextures);
+	}
+
+	void destroy()
+	{
+		// also responsible for destroying textures
+		bgfx::destroy(m_buffer);
+	}
+
+	bgfx::TextureHandle m_texture;
+	bgfx::TextureHandle m_blurSizeTexture;
+	bgfx::FrameBufferHandle m_buffer;
+};
+
+struct BokehDofMode
+{
+	enum Enum
+	{
+		MultiPass,	// lower res gather, then combine at full res
+		SinglePass,	// gather at full res
+		MixedResolution, // full, half or quarter res gather per tile by blur size
+		Debug,		// color by signed blur size, or a tap count heatmap
+
+		Count
+	};
+};
+
+// What BokehDofMode::Debug shows. Tap counts are of the gather BokehDofParams::m_tapCountMode
+// runs, per full res pixel. A lower res texel's taps are shared by the full res pixels it
+// covers. Wasted taps have a radius the largest blur size among the texel's own samples
+// can't reach, so a loop ending there gives the same result.
+struct BokehDofDebugView
+{
+	enum Enum
+	{
+		CircleOfConfusion,
+		ExecutedTaps,
+		ContributingTaps,	// smoothstep weight above zero
+		WastedTaps,
+
+		Count
+	};
+};
+
+typedef bgfx::ProgramHandle (*BokehDofLoadProgramFn)(const char* _vsName, const char* _fsName, void* _userData);
+
+struct BokehDofConfig
+{
+	BokehDofConfig()
+		: m_intermediateFormat(IntermediateFormat::Rgba16f)
+		, m_loadProgram(NULL)
+		, m_loadProgramUserData(NULL)
+		, m_mixedResolution(false)
+		, m_tapCounts(false)
+	{
+	}
+
+	IntermediateFormat::Enum m_intermediateFormat; // falls back to rgba16f when unsupported
+	BokehDofLoadProgramFn m_loadProgram;           // NULL loads separate files with loadProgram
+	void* m_loadProgramUserData;
+	bool m_mixedResolution;                        // allocate targets for BokehDofMode::MixedResolution
+	bool m_tapCounts;                              // allocate targets for the tap count debug views
+};
+
+struct BokehDofParams
+{
+	BokehDofParams()
+		: m_mode(BokehDofMode::MultiPass)
+		, m_debugView(BokehDofDebugView::CircleOfConfusion)
+		, m_tapCountMode(BokehDofMode::SinglePass)
+		, m_useComputeGather(true)
+		, m_focusPoint(1.0f)
+		, m_focusScale(2.0f)
+		, m_maxBlurSize(20.0f)
+		, m_radiusScale(0.5f)
+		, m_blurSteps(50.0f)
+		, m_lobeCount(6)
+		, m_lobePinch(0.2f)
+		, m_lobeRotation(0.0f)
+		, m_frameIdx(0)
+		, m_renderWidth(0)
+		, m_renderHeight(0)
+		, m_mixedHalfThreshold(3.0f)
+		, m_mixedQuarterThreshold(10.0f)
+		, m_mixedBlendWidth(2.0f)
+	{
+	}
+
+	BokehDofMode::Enum m_mode;
+	BokehDofDebugView::Enum m_debugView; // with BokehDofMode::Debug
+	BokehDofMode::Enum m_tapCountMode;   // gather counted by the tap count debug views
+	bool m_useComputeGather; // when supported, needs rgba16f format set
+
+	float m_focusPoint;      // view space distance to focus plane
+	float m_focusScale;      // larger is tighter focus
+	float m_maxBlurSize;     // in full res pixels
+	float m_radiusScale;     // spiral step, in full res pixels
+	float m_blurSteps;       // single pass sample count
+	int32_t m_lobeCount;     // aperture blades, 0 or 1 for round
+	float m_lobePinch;
+	float m_lobeRotation;
+	uint32_t m_frameIdx;     // rotates sample noise
+
+	// part of color and depth rendered this frame with dynamic resolution, 0 for all
+	uint32_t m_renderWidth;
+	uint32_t m_renderHeight;
+
+	// mixed resolution, tile max blur sizes in full res pixels where gather moves
+	// from full to half and from half to quarter res, crossfading over blend width
+	float m_mixedHalfThreshold;
+	float m_mixedQuarterThreshold;
+	float m_mixedBlendWidth;
+};
+
+// Bokeh depth of field as a standalone post process. All gpu resources, including
+// uniforms and a full screen triangle, are created up front so submitting a frame
+// allocates nothing. View state persists in bgfx, so views are configured once on
+// the API thread with setupViews() and submit() only records into an encoder.
+class BokehDof
+{
+public:
+	enum { ViewCount = 12, TapCountTotalsSize = 16 };
+
+	BokehDof();
+
+	// API thread. width and height are the full output resolution
+	bool create(uint32_t _width, uint32_t _height, const BokehDofConfig& _config);
+	void destroy();
+	void resize(uint32_t _width, uint32_t _height);
+
+	// API thread, when first view, size or output change. uses views
+	// [_firstView, _firstView + ViewCount), invalid output renders to backbuffer
+	void setupViews(bgfx::ViewId _firstView, bgfx::FrameBufferHandle _output);
+
+	// any thread with its own encoder, one submitting thread per instance. color is
+	// linear scene color, depth is linear view space depth as from fs_bokeh_linear_depth.
+	// programs of a pass are created the first time it's submitted, which needs the API
+	// thread, submit each mode used once from there before handing off to other threads
+	void submit(bgfx::Encoder* _encoder, bgfx::ViewId _firstView, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params);
+
+	bool isCreated() const
+	{
+		return m_created;
+	}
+
+	// format set in use after falling back from an unsupported request
+	IntermediateFormat::Enum getIntermediateFormat() const
+	{
+		return m_format;
+	}
+
+	bool isComputeGatherSupported() const
+	{
+		return m_computeGatherSupported;
+	}
+
+	// gather these params run, with BokehDofMode::Debug the one its tap counts replay.
+	// mixed resolution falls back to multi pass when not supported
+	BokehDofMode::Enum getGatherMode(const BokehDofParams& _params) const
+	{
+		const BokehDofMode::Enum mode = BokehDofMode::Debug == _params.m_mode
+			? _params.m_tapCountMode
+			: _params.m_mode
+			;
+
+		return BokehDofMode::MixedResolution == mode && !m_mixedSupported
+			? BokehDofMode::MultiPass
+			: mode
+			;
+	}
+
+	// whether these params run the compute gather, which limits max blur size
+	bool isComputeGatherActive(const BokehDofParams& _params) const
+	{
+		return true
+			&& BokehDofMode::MultiPass == getGatherMode(_params)
+			&& _params.m_useComputeGather
+			&& m_computeGatherSupported
+			;
+	}
+
+	// needs config.m_mixedResolution and the rgba16f format set, else multi pass is used
+	bool isMixedResolutionSupported() const
+	{
+		return m_mixedSupported;
+	}
+
+	// needs config.m_tapCounts and float render targets, else tap count views show blur size
+	bool isTapCountSupported() const
+	{
+		return m_tapCountSupported;
+	}
+
+	// TapCountTotalsSize squared rgba32f texels, summing to executed, contributing and
+	// wasted taps and pixel count in xyzw. written by submit() in tap count debug views,
+	// read back after the last dof view
+	bgfx::TextureHandle getTapCountTotals() const
+	{
+		return m_tapCountTotals.m_texture;
+	}
+
+	// bytes of textures and vertex buffers owned by this instance
+	uint32_t getGpuMemorySize() const;
+
+private:
+	struct DofProgram
+	{
+		enum Enum
+		{
+			Downsample,
+			Quarter,
+			Combine,
+			DownsampleSplit,
+			QuarterSplit,
+			CombineSplit,
+			SinglePass,
+			Debug,
+			TileMax,
+			TileDilate,
+			MixedFull,
+			MixedLower,
+			MixedCombine,
+			MixedDownsample,
+			QuarterCompute,
+			TapCount,
+			TapCountLower,
+			TapCountLowerSplit,
+			TapCountMixedFull,
+			TapCountMixedLower,
+			TapCountReduce,
+
+			Count
+		};
+	};
+
+	void createTargets();
+	void destroyTargets();
+	bgfx::ProgramHandle getProgram(DofProgram::Enum _program);
+	void updateUniforms(const BokehDofParams& _params);
+	void setLevelScale(const BokehDofParams& _params, float _scale);
+	void submitMixedResolution(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params);
+	void submitMixedTiles(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params);
+	void setMixedLevel(const BokehDofParams& _params, uint32_t _level);
+	void submitTapCounts(bgfx::Encoder* _encoder, bgfx::TextureHandle _color, bgfx::TextureHandle _depth, const BokehDofParams& _params);
+	void submitTapCountPass(bgfx::Encoder* _encoder, DofProgram::Enum _program, uint32_t _levelWidth, uint32_t _levelHeight);
+
+	BokehDofConfig m_config;
+	IntermediateFormat::Enum m_format;
+	uint32_t m_width;
+	uint32_t m_height;
+	bool m_computeGatherSupported;
+	bool m_mixedSupported;
+	bool m_tapCountSupported;
+	bool m_originBottomLeft;
+	bool m_created;
+
+	bgfx::ViewId m_firstView;
+	bgfx::FrameBufferHandle m_output;
+
+	PassUniforms m_uniforms;
+	bgfx::UniformHandle s_color;
+	bgfx::UniformHandle s_depth;
+	bgfx::UniformHandle s_blurredColor;
+	bgfx::UniformHandle s_blurSize;
+	MixedResolutionUniforms m_mixedUniforms;
+	bgfx::UniformHandle s_tiles;
+	bgfx::UniformHandle s_fullBlur;
+	bgfx::UniformHandle s_quarterBlur;
+
+	bgfx::ProgramHandle m_programs[DofProgram::Count];
+	bool m_programRequested[DofProgram::Count];
+	bgfx::VertexBufferHandle m_fullTriangle;
+	bgfx::VertexBufferHandle m_halfTriangle;
+	DofRenderTarget m_quarterInput;
+	DofRenderTarget m_quarterOutput;
+
+	// mixed resolution. unlike the half res m_quarter* targets, these quarter targets
+	// are a quarter of width and height
+	bgfx::VertexBufferHandle m_quarterTriangle;
+	bgfx::VertexBufferHandle m_tileTriangle;
+	uint32_t m_tileCount[2];
+	DofRenderTarget m_mixedFull;
+	DofRenderTarget m_mixedQuarterInput;
+	DofRenderTarget m_mixedQuarterOutput;
+	DofRenderTarget m_tileMax;
+	DofRenderTarget m_tileDilated;
+
+	// tap count debug views, per pixel counts then sums over blocks of them
+	DebugUniforms m_debugUniforms;
+	bgfx::UniformHandle s_tapCounts;
+	bgfx::VertexBufferHandle m_tapCountReduceTriangle;
+	bgfx::VertexBufferHandle m_tapCountTotalsTriangle;
+	uint32_t m_tapCountReduceSize[2];
+	DofRenderTarget m_tapCounts;
+	DofRenderTarget m_tapCountReduce;
+	DofRenderTarget m_tapCountTotals;
+};
+
+#endif // BOKEH_DOF_H_HEADER_GUARD
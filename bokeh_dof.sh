@@ -28,6 +28,33 @@ float GetBlurSize (float depth, float focusPoint, float focusScale)
 	return circleOfConfusion * u_maxBlurSize;
 }
 
+// Compact intermediate formats have no alpha channel for blur size, so it is stored
+// in a separate unorm (or half) target. Signed blur size in [-u_maxBlurSize, u_maxBlurSize]
+// maps to [0, 254/255] so that zero, in focus, lands exactly on code 127 of an 8 bit
+// target. Mirrored on the cpu by encodeBlurSize/decodeBlurSize in bokeh.cpp.
+#define BLUR_SIZE_ENCODE_ZERO	(127.0/255.0)
+
+float EncodeBlurSize (float blurSize)
+{
+	return saturate(blurSize / u_maxBlurSize * BLUR_SIZE_ENCODE_ZERO + BLUR_SIZE_ENCODE_ZERO);
+}
+
+float DecodeBlurSize (float encoded)
+{
+	return (encoded - BLUR_SIZE_ENCODE_ZERO) * (u_maxBlurSize / BLUR_SIZE_ENCODE_ZERO);
+}
+
+// average sample size is never negative, use full range
+float EncodeSampleSize (float sampleSize)
+{
+	return saturate(sampleSize / u_maxBlurSize);
+}
+
+float DecodeSampleSize (float encoded)
+{
+	return encoded * u_maxBlurSize;
+}
+
 // this is the function at bottom of blog post...
 //vec3 OriginalDepthOfField (vec2 texCoord, float focusPoint, float focusScale)
 //{
@@ -73,9 +100,16 @@ void GetColorAndBlurSize (
 
 	outColor = color;
 	outBlurSize = blurSize;
-#else
+#elif USE_SPLIT_COLOR_AND_BLUR
+	// samplerDepth holds encoded blur size instead of depth here
 	vec3 color = texture2DLod(samplerColor, texCoord, 0).xyz;
-	float depth = texture2DLod(samplerDepth, texCoord, 0).x;
+	float blurSize = DecodeBlurSize(texture2DLod(samplerDepth, texCoord, 0).x);
+
+	outColor = color;
+	outBlurSize = blurSize;
+#else
+	vec3 color = texture2DLod(samplerColor, SceneUv(texCoord), 0).xyz;
+	float depth = texture2DLod(samplerDepth, SceneUv(texCoord), 0).x;
 	float blurSize = GetBlurSize(depth, focusPoint, focusScale);
 
 	outColor = color;
@@ -83,6 +117,135 @@ void GetColorAndBlurSize (
 #endif
 }
 
+// Upscale sharp scene color from a lower render scale. Bilinear weights of the 2x2
+// footprint are reduced for texels whose depth differs from the nearest texel, so
+// foreground and background colors don't bleed into each other across edges.
+vec3 UpscaleSceneColor (sampler2D samplerColor, sampler2D samplerDepth, vec2 texCoord)
+{
+	vec2 uv = SceneUv(texCoord);
+	if (u_renderScale >= 1.0)
+	{
+		return texture2D(samplerColor, uv).xyz;
+	}
+
+	vec2 texelPosition = uv / u_sceneTexelSize - 0.5;
+	vec2 base = floor(texelPosition);
+	vec2 weight = texelPosition - base;
+
+	vec2 uvMin = u_sceneUvOffset + 0.5 * u_sceneTexelSize;
+	vec2 uvMax = u_sceneUvOffset + u_sceneUvScale - 0.5 * u_sceneTexelSize;
+	vec2 uv00 = clamp((base + 0.5) * u_sceneTexelSize, uvMin, uvMax);
+	vec2 uv11 = clamp((base + 1.5) * u_sceneTexelSize, uvMin, uvMax);
+	vec2 uv10 = vec2(uv11.x, uv00.y);
+	vec2 uv01 = vec2(uv00.x, uv11.y);
+
+	vec4 depths = vec4(
+		texture2DLod(samplerDepth, uv00, 0).x,
+		texture2DLod(samplerDepth, uv10, 0).x,
+		texture2DLod(samplerDepth, uv01, 0).x,
+		texture2DLod(samplerDepth, uv11, 0).x);
+
+	vec4 bilinear = vec4(
+		(1.0 - weight.x) * (1.0 - weight.y),
+		weight.x * (1.0 - weight.y),
+		(1.0 - weight.x) * weight.y,
+		weight.x * weight.y);
+
+	// nearest texel is the one with largest bilinear weight
+	float referenceDepth = depths.x;
+	float largest = bilinear.x;
+	if (bilinear.y > largest) { largest = bilinear.y; referenceDepth = depths.y; }
+	if (bilinear.z > largest) { largest = bilinear.z; referenceDepth = depths.z; }
+	if (bilinear.w > largest) { largest = bilinear.w; referenceDepth = depths.w; }
+
+	vec4 relativeDifference = abs(depths - referenceDepth) / max(referenceDepth, 0.001);
+	vec4 weights = bilinear / (1.0 + 64.0 * relativeDifference);
+
+	vec3 color = texture2DLod(samplerColor, uv00, 0).xyz * weights.x
+		+ texture2DLod(samplerColor, uv10, 0).xyz * weights.y
+		+ texture2DLod(samplerColor, uv01, 0).xyz * weights.z
+		+ texture2DLod(samplerColor, uv11, 0).xyz * weights.w;
+
+	return color / dot(weights, vec4_splat(1.0));
+}
+
+// Half res color and signed blur size from a 4x4 footprint of scene texels, tent
+// weighted. Each texel is also weighted by 1/(1+luma), Karis' average, so a bright
+// sub-pixel highlight can't flicker a whole half res texel as it moves. Blur size
+// is that of the center 2x2. Only when that is in the near field itself does it take
+// the nearest blur size of the footprint, which keeps the blurred foreground solid up
+// to its edge. Background next to it keeps its own blur size, the gather spreads the
+// foreground over it. Color is weighted towards texels with a blur size close to the
+// one written, keeping it to the same layer. Mirrored by downsamplePixel in
+// bokeh_cpu.cpp.
+// Blur sizes are in pixels of the level written. Downsamples run with u_maxBlurSize
+// scaled to half res, so GetBlurSize() returns half res pixels there.
+#define DOWNSAMPLE_NEAR_DILATE_MIN	(1.0)
+
+vec4 DownsampleColorAndBlurSize (
+	sampler2D samplerColor,
+	sampler2D samplerDepth,
+	vec2 texCoord,
+	float focusPoint,
+	float focusScale
+) {
+	vec2 center = texCoord * u_sceneUvScale + u_sceneUvOffset;
+	vec2 uvMin = u_sceneUvOffset + 0.5 * u_sceneTexelSize;
+	vec2 uvMax = u_sceneUvOffset + u_sceneUvScale - 0.5 * u_sceneTexelSize;
+
+	vec3 colors[16];
+	float blurSizes[16];
+	float centerBlurSize = 0.0;
+	float nearMax = 0.0;
+
+	for (int jj = 0; jj < 4; ++jj)
+	{
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			int index = jj * 4 + ii;
+			vec2 offset = vec2(float(ii), float(jj)) - 1.5;
+			vec2 uv = clamp(center + offset * u_sceneTexelSize, uvMin, uvMax);
+
+			colors[index] = texture2DLod(samplerColor, uv, 0).xyz;
+			float depth = texture2DLod(samplerDepth, uv, 0).x;
+			float blurSize = GetBlurSize(depth, focusPoint, focusScale);
+			blurSizes[index] = blurSize;
+
+			if (abs(offset.x) < 1.0 && abs(offset.y) < 1.0)
+			{
+				centerBlurSize += 0.25 * blurSize;
+			}
+			nearMax = max(nearMax, -blurSize);
+		}
+	}
+
+	float outBlurSize = centerBlurSize;
+	if (-centerBlurSize >= DOWNSAMPLE_NEAR_DILATE_MIN)
+	{
+		outBlurSize = min(outBlurSize, -nearMax);
+	}
+
+	vec3 color = vec3_splat(0.0);
+	float totalWeight = 0.0;
+
+	for (int jj = 0; jj < 4; ++jj)
+	{
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			int index = jj * 4 + ii;
+			vec2 tent = 2.0 - abs(vec2(float(ii), float(jj)) - 1.5);
+			float luma = dot(colors[index], vec3(0.2126, 0.7152, 0.0722));
+			float weight = tent.x * tent.y / (1.0 + luma);
+			weight /= 1.0 + abs(blurSizes[index] - outBlurSize);
+
+			color += colors[index] * weight;
+			totalWeight += weight;
+		}
+	}
+
+	return vec4(color / totalWeight, outBlurSize);
+}
+
 float BokehShapeFromAngle (float lobeCount, float radiusMin, float radiusDelta2x, float rotation, float angle)
 {
 	// don't shape for 0, 1 blades...
@@ -100,77 +263,96 @@ float BokehShapeFromAngle (float lobeCount, float radiusMin, float radiusDelta2x
 	return periodFraction*radiusDelta2x + radiusMin;
 }
 
-vec4 DepthOfField(
+// Spiral gather of every gather pass: DepthOfFieldRadius below, the compute and layered
+// versions and the tap count replay, so they stay in step. Expanded in place, _fetch can
+// use the caller's samplers and locals. _fetch(_offset, _outColor, _outBlurSize) gets
+// color and signed blur size at _offset from the center, in texels of the level being
+// gathered. _pixelCoord seeds the noise, _loopEnd is the largest spiral radius. Signed
+// blur size stands in for depth when comparing a tap to the center.
+// Declares color, blended and normalized, averageSampleSize, and tapsExecuted,
+// tapsContributing and largestSampleSize for the tap count views. Counts a gather
+// doesn't read are optimized out.
+#define SPIRAL_GATHER(_fetch, _pixelCoord, _loopEnd)                                    \
+	vec3 color;                                                                         \
+	float centerSize;                                                                   \
+	_fetch(vec2_splat(0.0), color, centerSize);                                         \
+	float absCenterSize = abs(centerSize);                                              \
+	float theta = ShadertoyNoise(_pixelCoord + vec2(314.0, 159.0)*u_frameIdx) * TWO_PI; \
+	float total = 1.0;                                                                  \
+	float totalSampleSize = 0.0;                                                        \
+	float tapsContributing = 0.0;                                                       \
+	float largestSampleSize = 0.0;                                                      \
+	float loopValue = u_radiusScale;                                                    \
+	while (loopValue < (_loopEnd) )                                                     \
+	{                                                                                   \
+		float radius = loopValue;                                                       \
+		float shapeScale = BokehShapeFromAngle(                                         \
+			u_lobeCount,                                                                \
+			u_lobeRadiusMin,                                                            \
+			u_lobeRadiusDelta2x,                                                        \
+			u_lobeRotation,                                                             \
+			theta);                                                                     \
+		vec3 sampleColor;                                                               \
+		float sampleSize;                                                               \
+		_fetch(                                                                         \
+			vec2(cos(theta), sin(theta)) * (radius * shapeScale),                       \
+			sampleColor,                                                                \
+			sampleSize);                                                                \
+		float absSampleSize = abs(sampleSize);                                          \
+		if (sampleSize > centerSize)                                                    \
+		{                                                                               \
+			absSampleSize = clamp(absSampleSize, 0.0, absCenterSize*2.0);               \
+		}                                                                               \
+		float m = smoothstep(radius-0.5, radius+0.5, absSampleSize);                    \
+		color += mix(color/total, sampleColor, m);                                      \
+		totalSampleSize += absSampleSize;                                               \
+		tapsContributing += (m > 0.0) ? 1.0 : 0.0;                                      \
+		largestSampleSize = max(largestSampleSize, absSampleSize);                      \
+		total += 1.0;                                                                   \
+		theta += GOLDEN_ANGLE;                                                          \
+		loopValue += (u_radiusScale/loopValue);                                         \
+	}                                                                                   \
+	color *= 1.0/total;                                                                 \
+	float tapsExecuted = total - 1.0;                                                   \
+	float averageSampleSize = totalSampleSize / max(tapsExecuted, 1.0)
+
+// fetch of DepthOfFieldRadius, from its samplers in view texels
+#define DOF_FETCH(_offset, _outColor, _outBlurSize)                                     \
+	GetColorAndBlurSize(                                                                \
+		samplerColor,                                                                   \
+		samplerDepth,                                                                   \
+		texCoord + (_offset) * u_viewTexel.xy,                                          \
+		focusPoint,                                                                     \
+		focusScale,                                                                     \
+		_outColor,                                                                      \
+		_outBlurSize)
+
+// loopEnd is the largest spiral radius, u_maxBlurSize unless the caller knows no
+// larger blur can reach this pixel
+vec4 DepthOfFieldRadius(
 	sampler2D samplerColor,
 	sampler2D samplerDepth,
 	vec2 texCoord,
 	float focusPoint,
-	float focusScale
+	float focusScale,
+	float loopEnd
 ) {
-	vec3 color;
-	float centerSize;
-	GetColorAndBlurSize(
-		samplerColor,
-		samplerDepth,
-		texCoord,
-		focusPoint,
-		focusScale,
-		/*out*/color,
-		/*out*/centerSize);
-	float absCenterSize = abs(centerSize);
-
 	// as sample count gets lower, visible banding. disrupt with noise.
 	// use a better random/noise/dither function than this..
 	vec2 pixelCoord = texCoord.xy * u_viewRect.zw;
-	float random = ShadertoyNoise(pixelCoord + vec2(314.0, 159.0)*u_frameIdx);
-	float theta = random * TWO_PI;
-	float thetaStep = GOLDEN_ANGLE;
-
-	float total = 1.0;
-	float totalSampleSize = 0.0;
-	float loopValue = u_radiusScale;
-	float loopEnd = u_maxBlurSize;
-
-	while (loopValue < loopEnd)
-	{
-		float radius = loopValue;
-		float shapeScale = BokehShapeFromAngle(
-			u_lobeCount,
-			u_lobeRadiusMin,
-			u_lobeRadiusDelta2x,
-			u_lobeRotation,
-			theta);
-		vec2 spiralCoord = texCoord + vec2(cos(theta), sin(theta)) * u_viewTexel.xy * (radius * shapeScale);
-
-		vec3 sampleColor;
-		float sampleSize;
-		GetColorAndBlurSize(
-			samplerColor,
-			samplerDepth,
-			spiralCoord,
-			focusPoint,
-			focusScale,
-			/*out*/sampleColor,
-			/*out*/sampleSize);
-		float absSampleSize = abs(sampleSize);
-
-		// using signed sample size as proxy for depth comparison
-		if (sampleSize > centerSize)
-		{
-			absSampleSize = clamp(absSampleSize, 0.0, absCenterSize*2.0);
-		}
-		float m = smoothstep(radius-0.5, radius+0.5, absSampleSize);
-		color += mix(color/total, sampleColor, m);
-		totalSampleSize += absSampleSize;
-		total += 1.0;
-		theta += thetaStep;
-
-		loopValue += (u_radiusScale/loopValue);
-	}
 
-	color *= 1.0/total;
-	float averageSampleSize = totalSampleSize / (total-1.0);
+	SPIRAL_GATHER(DOF_FETCH, pixelCoord, loopEnd);
 	return vec4(color, averageSampleSize);
 }
 
+vec4 DepthOfField(
+	sampler2D samplerColor,
+	sampler2D samplerDepth,
+	vec2 texCoord,
+	float focusPoint,
+	float focusScale
+) {
+	return DepthOfFieldRadius(samplerColor, samplerDepth, texCoord, focusPoint, focusScale, u_maxBlurSize);
+}
+
 #endif
@@ -0,0 +1,69 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_MIXED_SH
+#define BOKEH_MIXED_SH
+
+// Mixed resolution gather picks full, half or quarter resolution per screen tile from
+// the largest blur size that can reach into it. Level weights come from the bilinear
+// filtered tile max, so neighbouring tiles of different levels crossfade over a few
+// pixels instead of meeting at a seam. Blur sizes here are in full res pixels.
+#define MIXED_TILE_SIZE				16
+#define MIXED_MAX_DILATE_RADIUS		4
+
+// struct MixedResolutionUniforms
+uniform vec4 u_mixedParams[3];
+
+#define u_tileUvScale				(u_mixedParams[0].xy)
+#define u_halfThreshold				(u_mixedParams[0].z)
+#define u_quarterThreshold			(u_mixedParams[0].w)
+#define u_blendWidth				(u_mixedParams[1].x)
+#define u_levelScale				(u_mixedParams[1].y)
+#define u_levelMargin				(u_mixedParams[1].z)
+#define u_tileDilateRadius			(u_mixedParams[1].w)
+#define u_tileSourceTexel			(u_mixedParams[2].xy)
+#define u_level						(u_mixedParams[2].z)
+
+float MixedTileBlurSize (sampler2D samplerTiles, vec2 texCoord)
+{
+	return texture2DLod(samplerTiles, texCoord * u_tileUvScale, 0).x;
+}
+
+// weights of full, half and quarter res, thresholds are at least blend width apart
+vec3 MixedLevelWeights (float tileBlurSize)
+{
+	float toHalf = saturate((tileBlurSize - u_halfThreshold) / u_blendWidth);
+	float toQuarter = saturate((tileBlurSize - u_quarterThreshold) / u_blendWidth);
+	return vec3(1.0 - toHalf, toHalf - toQuarter, toQuarter);
+}
+
+// a level is gathered wherever the combine pass may give it weight. margin covers
+// the tile max changing across the footprint of one texel of this level and its
+// bilinear neighbours, so combine never blends in a texel that was skipped.
+bool MixedLevelActive (float tileBlurSize)
+{
+	float lo = tileBlurSize - u_levelMargin;
+	float hi = tileBlurSize + u_levelMargin;
+
+	if (u_level < 0.5)
+	{
+		return lo < u_halfThreshold + u_blendWidth;
+	}
+	else if (u_level < 1.5)
+	{
+		return hi > u_halfThreshold && lo < u_quarterThreshold + u_blendWidth;
+	}
+
+	return hi > u_quarterThreshold;
+}
+
+// no sample further than the largest blur size reaching this tile can contribute,
+// end the spiral there. in pixels of the level being gathered
+float MixedLoopEnd (float tileBlurSize)
+{
+	return min((tileBlurSize + u_levelMargin) * u_levelScale, u_maxBlurSize);
+}
+
+#endif // BOKEH_MIXED_SH
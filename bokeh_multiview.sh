@@ -0,0 +1,32 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_MULTIVIEW_SH
+#define BOKEH_MULTIVIEW_SH
+
+// several cameras are kept in layers of 2d array targets. passes run over all layers
+// in one dispatch, gl_GlobalInvocationID.z picks the layer, offset by u_firstLayer
+// so the same shaders can also run one layer at a time for comparison.
+#define MULTIVIEW_MAX_LAYERS		8
+
+// struct MultiviewUniforms
+uniform vec4 u_multiviewParams[1 + MULTIVIEW_MAX_LAYERS];
+
+#define u_firstLayer				(u_multiviewParams[0].x)
+#define u_layerCount				(u_multiviewParams[0].y)
+#define u_gridColumns				(u_multiviewParams[0].z)
+#define u_gridRows					(u_multiviewParams[0].w)
+
+float LayerFocusPoint (int layer)
+{
+	return u_multiviewParams[1 + layer].x;
+}
+
+float LayerFocusScale (int layer)
+{
+	return u_multiviewParams[1 + layer].y;
+}
+
+#endif // BOKEH_MULTIVIEW_SH
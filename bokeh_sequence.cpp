@@ -0,0 +1,166 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bokeh_sequence.h"
+#include "bokeh_cpu.h"
+#include "bokeh_sweep.h"
+
+#include <common.h>
+#include <bx/math.h>
+#include <bx/timer.h>
+
+namespace {
+
+// small ball a little in front of the focus card, crossing the frame once
+void drawSubject(CpuImage& _color, CpuImage& _depth, uint32_t _frame, uint32_t _frameCount)
+{
+	const float width = float(_color.m_width);
+	const float height = float(_color.m_height);
+	const float tt = float(_frame) / float(bx::max(_frameCount - 1, 1u) );
+	const float centerX = bx::lerp(0.1f, 0.9f, tt) * width;
+	const float centerY = 0.62f * height;
+	const float radius = 8.0f * height / 180.0f;
+
+	const uint32_t x0 = uint32_t(bx::max(centerX - radius, 0.0f) );
+	const uint32_t y0 = uint32_t(bx::max(centerY - radius, 0.0f) );
+	const uint32_t x1 = bx::min(uint32_t(centerX + radius) + 1, _color.m_width);
+	const uint32_t y1 = bx::min(uint32_t(centerY + radius) + 1, _color.m_height);
+
+	for (uint32_t yy = y0; yy < y1; ++yy)
+	{
+		for (uint32_t xx = x0; xx < x1; ++xx)
+		{
+			const float dx = float(xx) + 0.5f - centerX;
+			const float dy = float(yy) + 0.5f - centerY;
+			if (dx*dx + dy*dy < radius * radius)
+			{
+				float* color = _color.at(xx, yy);
+				color[0] = 0.1f;
+				color[1] = 0.8f;
+				color[2] = 0.4f;
+				*_depth.at(xx, yy) = 6.0f;
+			}
+		}
+	}
+}
+
+float maxDifference(const CpuImage& _image, const CpuImage& _reference)
+{
+	float result = 0.0f;
+	for (uint32_t ii = 0, num = _image.m_width * _image.m_height * _image.m_channels; ii < num; ++ii)
+	{
+		result = bx::max(result, bx::abs(_image.m_data[ii] - _reference.m_data[ii]) );
+	}
+	return result;
+}
+
+} // namespace
+
+bool runSequenceDof(bx::AllocatorI* _allocator, const SequenceDofConfig& _config)
+{
+	const uint32_t width = bx::max(_config.m_width, 16u);
+	const uint32_t height = bx::max(_config.m_height, 16u);
+	const uint32_t frameCount = bx::max(_config.m_frameCount, 1u);
+
+	CpuImage background;
+	CpuImage backgroundDepth;
+	CpuImage color;
+	CpuImage depth;
+	CpuImage output;
+	CpuImage reference;
+	background.create(_allocator, width, height, 4);
+	backgroundDepth.create(_allocator, width, height, 1);
+	color.create(_allocator, width, height, 4);
+	depth.create(_allocator, width, height, 1);
+	output.create(_allocator, width, height, 4);
+	reference.create(_allocator, width, height, 4);
+	createSweepScene(background, backgroundDepth);
+
+	// noise stays fixed, it would otherwise change every tile every frame
+	BokehDofParams params;
+	params.m_mode = _config.m_mode;
+	params.m_focusPoint = kSweepFocusPoint;
+	params.m_focusScale = kSweepFocusScale;
+	params.m_maxBlurSize = kSweepMaxBlurSize;
+	params.m_frameIdx = 0;
+
+	CpuDofSequence sequence;
+	sequence.create(_allocator, width, height);
+
+	bool match = true;
+	double totalMs = 0.0;
+	double totalFullMs = 0.0;
+	double totalSkipped = 0.0;
+
+	for (uint32_t ii = 0; ii < frameCount; ++ii)
+	{
+		bx::memCopy(color.m_data, background.m_data, width * height * 4 * sizeof(float) );
+		bx::memCopy(depth.m_data, backgroundDepth.m_data, width * height * sizeof(float) );
+		drawSubject(color, depth, ii, frameCount);
+
+		CpuSequenceStats stats;
+		sequence.process(output, color, depth, params, &stats);
+		totalMs += double(stats.m_timeMs);
+		totalSkipped += double(stats.m_skippedPercent);
+
+		if (_config.m_verify)
+		{
+			CpuDofStats fullStats;
+			cpuBokehDof(_allocator, reference, color, depth, params, &fullStats);
+			totalFullMs += double(fullStats.m_timeMs);
+
+			const float difference = maxDifference(output, reference);
+			match = match && 0.0f == difference;
+
+			DBG("Sequence frame %u: %u of %u tiles changed, %.1f%% skipped, %.2f ms, %.1fx measured speedup, max difference %g."
+				, ii
+				, stats.m_changedTiles
+				, stats.m_tileCount
+				, stats.m_skippedPercent
+				, stats.m_timeMs
+				, stats.m_timeMs > 0.0f ? fullStats.m_timeMs / stats.m_timeMs : 1.0f
+				, difference
+				);
+		}
+		else
+		{
+			DBG("Sequence frame %u: %u of %u tiles changed, %.1f%% skipped, %.2f ms, %.1fx speedup."
+				, ii
+				, stats.m_changedTiles
+				, stats.m_tileCount
+				, stats.m_skippedPercent
+				, stats.m_timeMs
+				, stats.m_speedup
+				);
+		}
+	}
+
+	DBG("Sequence dof: %u frames at %ux%u, %.1f%% tiles skipped on average, %.1f ms total%s."
+		, frameCount
+		, width
+		, height
+		, totalSkipped / double(frameCount)
+		, totalMs
+		, !_config.m_verify ? "" : match ? ", matches full recompute" : ", DIFFERS from full recompute"
+		);
+
+	if (_config.m_verify)
+	{
+		DBG("Sequence dof: full recompute %.1f ms total, %.1fx speedup."
+			, totalFullMs
+			, totalMs > 0.0 ? totalFullMs / totalMs : 1.0
+			);
+	}
+
+	sequence.destroy();
+	background.destroy();
+	backgroundDepth.destroy();
+	color.destroy();
+	depth.destroy();
+	output.destroy();
+	reference.destroy();
+
+	return match;
+}
@@ -0,0 +1,35 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_SEQUENCE_H_HEADER_GUARD
+#define BOKEH_SEQUENCE_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+#include "bokeh_dof.h"
+
+struct SequenceDofConfig
+{
+	SequenceDofConfig()
+		: m_frameCount(48)
+		, m_width(320)
+		, m_height(180)
+		, m_mode(BokehDofMode::SinglePass)
+		, m_verify(false)
+	{
+	}
+
+	uint32_t m_frameCount;
+	uint32_t m_width;
+	uint32_t m_height;
+	BokehDofMode::Enum m_mode;
+	bool m_verify; // also run the whole chain each frame, compare and time it
+};
+
+// Runs CpuDofSequence over a locked off shot of the sweep scene with a small
+// subject crossing it. Logs changed and skipped tiles and the speedup per frame.
+// Returns false when verifying and any frame differs from cpuBokehDof().
+bool runSequenceDof(bx::AllocatorI* _allocator, const SequenceDofConfig& _config);
+
+#endif // BOKEH_SEQUENCE_H_HEADER_GUARD
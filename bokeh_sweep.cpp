@@ -0,0 +1,388 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bokeh_sweep.h"
+#include "bokeh_cpu.h"
+
+#include <common.h>
+#include <bx/file.h>
+#include <bx/math.h>
+#include <bx/timer.h>
+
+namespace {
+
+struct LobeSetting
+{
+	int32_t m_lobeCount;
+	float m_lobePinch;
+};
+
+static const LobeSetting s_lobeSettings[] =
+{
+	{ 0, 0.0f }, // round
+	{ 6, 0.2f },
+	{ 5, 0.4f },
+};
+
+static const float s_radiusScales[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+
+struct MixedPreset
+{
+	float m_halfThreshold;
+	float m_quarterThreshold;
+};
+
+static const MixedPreset s_mixedPresets[] =
+{
+	{ 2.0f,  6.0f },
+	{ 3.0f, 10.0f },
+	{ 5.0f, 16.0f },
+};
+
+static const char* s_modeNames[BokehDofMode::Count] =
+{
+	"multi_pass",
+	"single_pass",
+	"mixed_resolution",
+	"debug",
+};
+
+struct SweepResult
+{
+	BokehDofParams m_params;
+	float m_tapsPerPixel;
+	float m_timeMs;
+	float m_psnr;
+	float m_ssim;
+	bool m_pareto;
+};
+
+uint32_t hashPixel(uint32_t _x, uint32_t _y)
+{
+	uint32_t hash = _x * 73856093u ^ _y * 19349663u;
+	hash ^= hash >> 13;
+	hash *= 0x5bd1e995u;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+float toGamma(float _linear)
+{
+	return bx::pow(bx::clamp(_linear, 0.0f, 1.0f), 1.0f/2.2f);
+}
+
+// compared as displayed, after clamping and the linear to gamma conversion
+float computePsnr(const CpuImage& _image, const CpuImage& _reference)
+{
+	double sum = 0.0;
+	for (uint32_t yy = 0; yy < _image.m_height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < _image.m_width; ++xx)
+		{
+			const float* aa = _image.at(xx, yy);
+			const float* bb = _reference.at(xx, yy);
+			for (uint32_t cc = 0; cc < 3; ++cc)
+			{
+				const float diff = toGamma(aa[cc]) - toGamma(bb[cc]);
+				sum += double(diff * diff);
+			}
+		}
+	}
+
+	const double mse = sum / double(_image.m_width * _image.m_height * 3);
+	return mse > 0.0
+		? float(10.0 * bx::log(float(1.0 / mse) ) / bx::log(10.0f) )
+		: 99.0f
+		;
+}
+
+float luma(const float* _color)
+{
+	return toGamma(_color[0]) * 0.299f + toGamma(_color[1]) * 0.587f + toGamma(_color[2]) * 0.114f;
+}
+
+// mean SSIM of luma over 8x8 windows with a stride of 4
+float computeSsim(const CpuImage& _image, const CpuImage& _reference)
+{
+	const float c1 = 0.01f * 0.01f;
+	const float c2 = 0.03f * 0.03f;
+	const uint32_t window = 8;
+	const uint32_t stride = 4;
+
+	double sum = 0.0;
+	uint32_t count = 0;
+	for (uint32_t wy = 0; wy + window <= _image.m_height; wy += stride)
+	{
+		for (uint32_t wx = 0; wx + window <= _image.m_width; wx += stride)
+		{
+			float meanA = 0.0f, meanB = 0.0f;
+			float varA = 0.0f, varB = 0.0f, covar = 0.0f;
+			for (uint32_t yy = wy; yy < wy + window; ++yy)
+			{
+				for (uint32_t xx = wx; xx < wx + window; ++xx)
+				{
+					meanA += luma(_image.at(xx, yy) );
+					meanB += luma(_reference.at(xx, yy) );
+				}
+			}
+
+			const float invCount = 1.0f / float(window * window);
+			meanA *= invCount;
+			meanB *= invCount;
+
+			for (uint32_t yy = wy; yy < wy + window; ++yy)
+			{
+				for (uint32_t xx = wx; xx < wx + window; ++xx)
+				{
+					const float da = luma(_image.at(xx, yy) ) - meanA;
+					const float db = luma(_reference.at(xx, yy) ) - meanB;
+					varA += da * da;
+					varB += db * db;
+					covar += da * db;
+				}
+			}
+
+			varA *= invCount;
+			varB *= invCount;
+			covar *= invCount;
+
+			sum += double( ( (2.0f * meanA * meanB + c1) * (2.0f * covar + c2) )
+				/ ( (meanA * meanA + meanB * meanB + c1) * (varA + varB + c2) ) );
+			++count;
+		}
+	}
+
+	return 0 != count ? float(sum / double(count) ) : 1.0f;
+}
+
+// lower cost and higher quality, within the same lobe setting
+void markParetoFrontier(SweepResult* _results, uint32_t _count)
+{
+	for (uint32_t ii = 0; ii < _count; ++ii)
+	{
+		SweepResult& result = _results[ii];
+		result.m_pareto = true;
+
+		for (uint32_t jj = 0; jj < _count && result.m_pareto; ++jj)
+		{
+			const SweepResult& other = _results[jj];
+			const bool dominates = true
+				&& ii != jj
+				&& other.m_params.m_lobeCount == result.m_params.m_lobeCount
+				&& other.m_params.m_lobePinch == result.m_params.m_lobePinch
+				&& other.m_tapsPerPixel <= result.m_tapsPerPixel
+				&& other.m_ssim >= result.m_ssim
+				&& (other.m_tapsPerPixel < result.m_tapsPerPixel || other.m_ssim > result.m_ssim)
+				;
+			result.m_pareto = !dominates;
+		}
+	}
+}
+
+} // namespace
+
+bool runParetoSweep(bx::AllocatorI* _allocator, const ParetoSweepConfig& _config)
+{
+	const uint32_t width = bx::max(_config.m_width, 16u);
+	const uint32_t height = bx::max(_config.m_height, 16u);
+	const int64_t start = bx::getHPCounter();
+
+	CpuImage color;
+	CpuImage depth;
+	CpuImage reference;
+	CpuImage output;
+	color.create(_allocator, width, height, 4);
+	depth.create(_allocator, width, height, 1);
+	reference.create(_allocator, width, height, 4);
+	output.create(_allocator, width, height, 4);
+	createSweepScene(color, depth);
+
+	const uint32_t configsPerLobe = 2 * BX_COUNTOF(s_radiusScales) + BX_COUNTOF(s_radiusScales) * BX_COUNTOF(s_mixedPresets);
+	const uint32_t maxResults = BX_COUNTOF(s_lobeSettings) * configsPerLobe;
+	SweepResult* results = (SweepResult*)BX_ALLOC(_allocator, maxResults * sizeof(SweepResult) );
+	uint32_t numResults = 0;
+
+	const float pixelCount = float(width * height);
+
+	for (uint32_t ll = 0; ll < BX_COUNTOF(s_lobeSettings); ++ll)
+	{
+		BokehDofParams base;
+		base.m_focusPoint = kSweepFocusPoint;
+		base.m_focusScale = kSweepFocusScale;
+		base.m_maxBlurSize = kSweepMaxBlurSize;
+		base.m_lobeCount = s_lobeSettings[ll].m_lobeCount;
+		base.m_lobePinch = s_lobeSettings[ll].m_lobePinch;
+		base.m_frameIdx = 0;
+
+		// aperture shape is a look, not a quality knob, so each has its own reference
+		BokehDofParams referenceParams = base;
+		referenceParams.m_mode = BokehDofMode::SinglePass;
+		referenceParams.m_radiusScale = _config.m_referenceRadiusScale;
+
+		CpuDofStats stats;
+		cpuBokehDof(_allocator, reference, color, depth, referenceParams, &stats);
+		DBG("Pareto sweep reference, %d lobes: %.0f taps per pixel, %.1f ms."
+			, base.m_lobeCount
+			, double(stats.m_taps) / double(pixelCount)
+			, stats.m_timeMs
+			);
+
+		for (uint32_t rr = 0; rr < BX_COUNTOF(s_radiusScales); ++rr)
+		{
+			for (uint32_t mm = 0; mm < 2 + BX_COUNTOF(s_mixedPresets); ++mm)
+			{
+				BokehDofParams params = base;
+				params.m_radiusScale = s_radiusScales[rr];
+				params.m_mode = 0 == mm ? BokehDofMode::SinglePass
+					: 1 == mm ? BokehDofMode::MultiPass
+					: BokehDofMode::MixedResolution
+					;
+
+				if (mm >= 2)
+				{
+					params.m_mixedHalfThreshold = s_mixedPresets[mm-2].m_halfThreshold;
+					params.m_mixedQuarterThreshold = s_mixedPresets[mm-2].m_quarterThreshold;
+				}
+
+				cpuBokehDof(_allocator, output, color, depth, params, &stats);
+
+				SweepResult& result = results[numResults++];
+				result.m_params = params;
+				result.m_tapsPerPixel = float(stats.m_taps) / pixelCount;
+				result.m_timeMs = stats.m_timeMs;
+				result.m_psnr = computePsnr(output, reference);
+				result.m_ssim = computeSsim(output, reference);
+			}
+		}
+	}
+
+	markParetoFrontier(results, numResults);
+
+	bx::FileWriter writer;
+	bx::Error err;
+	bool written = bx::open(&writer, _config.m_outputPath, false, &err);
+	if (written)
+	{
+		bx::write(&writer, &err, "lobe_count,lobe_pinch,mode,radius_scale,half_threshold,quarter_threshold,taps_per_pixel,cpu_ms,psnr_db,ssim,pareto\n");
+		for (uint32_t ii = 0; ii < numResults; ++ii)
+		{
+			const SweepResult& result = results[ii];
+			const BokehDofParams& params = result.m_params;
+			const bool mixed = BokehDofMode::MixedResolution == params.m_mode;
+
+			bx::write(&writer, &err, "%d,%.2f,%s,%.3f,%.1f,%.1f,%.1f,%.2f,%.3f,%.5f,%d\n"
+				, params.m_lobeCount
+				, params.m_lobePinch
+				, s_modeNames[params.m_mode]
+				, params.m_radiusScale
+				, mixed ? params.m_mixedHalfThreshold : 0.0f
+				, mixed ? params.m_mixedQuarterThreshold : 0.0f
+				, result.m_tapsPerPixel
+				, result.m_timeMs
+				, result.m_psnr
+				, result.m_ssim
+				, result.m_pareto ? 1 : 0
+				);
+
+			if (result.m_pareto)
+			{
+				DBG("Pareto: %d lobes, %s, radius scale %.2f, %.1f taps per pixel, %.2f dB, ssim %.4f."
+					, params.m_lobeCount
+					, s_modeNames[params.m_mode]
+					, params.m_radiusScale
+					, result.m_tapsPerPixel
+					, result.m_psnr
+					, result.m_ssim
+					);
+			}
+		}
+
+		bx::close(&writer);
+		written = err.isOk();
+	}
+
+	DBG("Pareto sweep: %u configurations at %ux%u, %s %s, %.1f s."
+		, numResults
+		, width
+		, height
+		, written ? "wrote" : "failed to write"
+		, _config.m_outputPath
+		, double(bx::getHPCounter() - start) / double(bx::getHPFrequency() )
+		);
+
+	BX_FREE(_allocator, results);
+	color.destroy();
+	depth.destroy();
+	reference.destroy();
+	output.destroy();
+
+	return written;
+}
+
+void createSweepScene(CpuImage& _color, CpuImage& _depth)
+{
+	const uint32_t width = _color.m_width;
+	const uint32_t height = _color.m_height;
+	const float scale = float(height) / 180.0f;
+
+	for (uint32_t yy = 0; yy < height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < width; ++xx)
+		{
+			const float fx = float(xx) + 0.5f;
+			const float fy = float(yy) + 0.5f;
+			float* color = _color.at(xx, yy);
+			float depth = 40.0f;
+
+			const float stripe = bx::fract( (fx + fy) / (12.0f * scale) ) < 0.5f ? 1.0f : 0.0f;
+			color[0] = 0.1f + 0.3f * stripe;
+			color[1] = 0.15f;
+			color[2] = 0.3f - 0.2f * stripe;
+			if (0 == hashPixel(xx, yy) % 97)
+			{
+				color[0] = color[1] = color[2] = 16.0f;
+			}
+
+			const float floorStart = float(height) * 0.7f;
+			if (fy > floorStart)
+			{
+				const float tt = (fy - floorStart) / (float(height) - floorStart);
+				depth = bx::lerp(30.0f, 4.0f, tt);
+				const float checker = float( (uint32_t(fx / (8.0f * scale) ) + uint32_t(fy / (8.0f * scale) ) ) & 1);
+				color[0] = color[1] = color[2] = 0.05f + 0.4f * checker;
+			}
+
+			if (bx::abs(fx - float(width) * 0.5f) < float(width) * 0.15f
+			&&  bx::abs(fy - float(height) * 0.45f) < float(height) * 0.2f)
+			{
+				depth = kSweepFocusPoint;
+				const float checker = float( ( (xx / 2) + (yy / 2) ) & 1);
+				color[0] = color[1] = color[2] = 0.02f + 0.8f * checker;
+			}
+
+			const float discs[2][3] =
+			{
+				{ float(width) * 0.15f, float(height) * 0.35f, 30.0f * scale },
+				{ float(width) * 0.8f,  float(height) * 0.75f, 22.0f * scale },
+			};
+
+			for (uint32_t ii = 0; ii < BX_COUNTOF(discs); ++ii)
+			{
+				const float dx = fx - discs[ii][0];
+				const float dy = fy - discs[ii][1];
+				if (dx*dx + dy*dy < discs[ii][2] * discs[ii][2])
+				{
+					depth = 3.0f;
+					color[0] = 0.9f;
+					color[1] = 0.35f + 0.3f * float(ii);
+					color[2] = 0.05f;
+				}
+			}
+
+			color[3] = 1.0f;
+			*_depth.at(xx, yy) = depth;
+		}
+	}
+}
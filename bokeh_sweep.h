@@ -0,0 +1,45 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_SWEEP_H_HEADER_GUARD
+#define BOKEH_SWEEP_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+
+struct CpuImage;
+
+// camera for the synthetic scene, focused on the card in the middle
+static const float kSweepFocusPoint = 8.0f;
+static const float kSweepFocusScale = 4.0f;
+static const float kSweepMaxBlurSize = 20.0f;
+
+struct ParetoSweepConfig
+{
+	ParetoSweepConfig()
+		: m_outputPath("bokeh_pareto.csv")
+		, m_width(320)
+		, m_height(180)
+		, m_referenceRadiusScale(0.05f)
+	{
+	}
+
+	const char* m_outputPath;
+	uint32_t m_width;
+	uint32_t m_height;
+	float m_referenceRadiusScale; // spiral step of the reference, in full res pixels
+};
+
+// Renders a synthetic color and depth input with the cpu dof at a very small
+// spiral step as reference, then every mode, tap budget, mixed resolution
+// preset and lobe setting. Writes cost, PSNR and SSIM per configuration to csv,
+// flagging those on the Pareto frontier of taps against SSIM per lobe setting.
+bool runParetoSweep(bx::AllocatorI* _allocator, const ParetoSweepConfig& _config);
+
+// Far striped wall with sparse sub pixel highlights, a receding checkered floor,
+// a fine checker card at the focus distance and two near discs. Color is rgba,
+// depth is linear view space depth, both at any size.
+void createSweepScene(CpuImage& _color, CpuImage& _depth);
+
+#endif // BOKEH_SWEEP_H_HEADER_GUARD
@@ -0,0 +1,127 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_TAIL_SH
+#define BOKEH_TAIL_SH
+
+// Per pixel steps at the end of the chain, fused into the one pass writing the
+// output. Each fragment shader including this defines which ones it runs:
+//   TAIL_COMBINE           blurred color over sharp scene color by sample size
+//   TAIL_SPLIT_BLUR_SIZE   with TAIL_COMBINE, sample size is in its own target
+//   TAIL_LINEAR_TO_GAMMA   output is the backbuffer or the capture target
+//   TAIL_DEBUG_TINT        desaturate, then tint by circle of confusion or tap counts
+// Sampler stages are the same for every variant.
+
+#ifndef TAIL_COMBINE
+#	define TAIL_COMBINE				0
+#endif
+#ifndef TAIL_SPLIT_BLUR_SIZE
+#	define TAIL_SPLIT_BLUR_SIZE		0
+#endif
+#ifndef TAIL_LINEAR_TO_GAMMA
+#	define TAIL_LINEAR_TO_GAMMA		1
+#endif
+#ifndef TAIL_DEBUG_TINT
+#	define TAIL_DEBUG_TINT			0
+#endif
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_debug.sh"
+
+SAMPLER2D(s_color,			0);
+#if TAIL_COMBINE || TAIL_DEBUG_TINT
+SAMPLER2D(s_depth,			1);
+#endif
+#if TAIL_COMBINE
+SAMPLER2D(s_blurredColor,	2);
+#endif
+#if TAIL_SPLIT_BLUR_SIZE
+SAMPLER2D(s_blurSize,		3);
+#endif
+#if TAIL_DEBUG_TINT
+SAMPLER2D(s_tapCounts,		4);
+#endif
+
+#if TAIL_DEBUG_TINT
+vec3 DebugTint (vec3 color, vec2 texCoord)
+{
+	// desaturate color to make tinted color stand out
+	color = vec3_splat(dot(color, vec3(0.33, 0.34, 0.33)));
+
+	if (u_debugView > 0.5)
+	{
+		// executed, contributing or wasted taps, relative to the full res single pass spiral
+		vec3 tapCounts = texture2D(s_tapCounts, texCoord).xyz;
+		float count = (u_debugView < 1.5) ? tapCounts.x
+			: (u_debugView < 2.5) ? tapCounts.y
+			: tapCounts.z
+			;
+		color = mix(color, HeatmapColor(count / u_heatmapScale), 0.75);
+	}
+	else
+	{
+		// get circle of confusion from depth
+		float depth = texture2D(s_depth, SceneUv(texCoord)).x;
+		float circleOfConfusion = GetCircleOfConfusion(depth, u_focusPoint, u_focusScale);
+
+		// apply tint color to debug where blur applied
+		vec3 tintColor;
+		if (circleOfConfusion < 0.0)
+		{
+			// tint foreground orange
+			tintColor = vec3(187.0, 61.0, 7.0) / 255.0;
+		}
+		else
+		{
+			// tint background blue
+			tintColor = vec3(11.0, 89.0, 138.0) / 255.0;
+		}
+		tintColor *= color;
+		color = mix(color, tintColor, abs(circleOfConfusion));
+	}
+
+	return color;
+}
+#endif // TAIL_DEBUG_TINT
+
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+
+#if TAIL_COMBINE
+	// sharp layer may come from a lower render scale, blurred layer is already lower res
+	vec3 color = UpscaleSceneColor(s_color, s_depth, texCoord);
+	vec4 dofColorSize = texture2D(s_blurredColor, texCoord);
+#	if TAIL_SPLIT_BLUR_SIZE
+	float sampleSize = DecodeSampleSize(texture2D(s_blurSize, texCoord).x);
+#	else
+	float sampleSize = dofColorSize.w;
+#	endif // TAIL_SPLIT_BLUR_SIZE
+
+	float m = saturate(sampleSize-1.0);
+	color = mix(color, dofColorSize.xyz, m);
+	float alpha = 1.0;
+#else
+	vec4 linearColor = texture2D(s_color, SceneUv(texCoord));
+	vec3 color = linearColor.xyz;
+	float alpha = linearColor.w;
+#endif // TAIL_COMBINE
+
+#if TAIL_LINEAR_TO_GAMMA
+	// writing directly out to backbuffer, convert from linear to gamma
+	color = toGamma(color);
+#endif // TAIL_LINEAR_TO_GAMMA
+
+#if TAIL_DEBUG_TINT
+	color = DebugTint(color, texCoord);
+	alpha = 1.0;
+#endif // TAIL_DEBUG_TINT
+
+	gl_FragColor = vec4(color, alpha);
+}
+
+#endif // BOKEH_TAIL_SH
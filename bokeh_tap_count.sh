@@ -0,0 +1,95 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef BOKEH_TAP_COUNT_SH
+#define BOKEH_TAP_COUNT_SH
+
+// Tap counts of one gather pass, replayed at full res with the uniforms of that pass.
+// Each fragment shader including this matches the gather it counts:
+//   USE_PACKED_COLOR_AND_BLUR  lower res gather of the packed downsample
+//   USE_SPLIT_COLOR_AND_BLUR   lower res gather, blur size in its own target
+//   TAP_COUNT_MIXED            mixed resolution level, counts nothing where
+//                              MixedLevelActive() skips the gather and ends the
+//                              spiral at MixedLoopEnd()
+// A full res pixel gets the counts of the level texel covering it times that texel's
+// share of full res pixels, so summing a frame gives the taps the pass executed. Passes
+// of one frame add up, with the pixel count written once in w.
+// Sampler stages are the same for every variant.
+
+#ifndef TAP_COUNT_MIXED
+#	define TAP_COUNT_MIXED			0
+#endif
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_debug.sh"
+#if TAP_COUNT_MIXED
+#	include "bokeh_mixed.sh"
+#endif
+
+SAMPLER2D(s_color,			0);
+#if USE_PACKED_COLOR_AND_BLUR
+#	define s_depth s_color
+#else
+SAMPLER2D(s_depth,			1); // encoded blur size with USE_SPLIT_COLOR_AND_BLUR
+#endif
+#if TAP_COUNT_MIXED
+SAMPLER2D(s_tiles,			2);
+#endif
+
+// SPIRAL_GATHER fetch, as DepthOfFieldRadius() does for the level being replayed
+#define TAP_COUNT_FETCH(_offset, _outColor, _outBlurSize)                                 \
+	GetColorAndBlurSize(                                                                \
+		s_color,                                                                        \
+		s_depth,                                                                        \
+		texCoord + (_offset) / levelSize,                                               \
+		u_focusPoint,                                                                   \
+		u_focusScale,                                                                   \
+		_outColor,                                                                      \
+		_outBlurSize)
+
+// taps of the gather, its color is optimized out. Executed taps in x, taps with weight
+// in y and wasted taps in z. texCoord is the center of a level texel, levelSize is the
+// size of the target the gather renders
+vec3 TapCountsRadius (vec2 texCoord, vec2 levelSize, float loopEnd)
+{
+	vec2 pixelCoord = texCoord.xy * levelSize;
+	SPIRAL_GATHER(TAP_COUNT_FETCH, pixelCoord, loopEnd);
+
+	// weight is zero once radius-0.5 reaches the largest sample size, so a loop ending
+	// there gives the same color. count the taps after that point
+	float wasted = 0.0;
+	float radius = u_radiusScale;
+	while (radius < loopEnd)
+	{
+		wasted += (radius - 0.5 >= largestSampleSize) ? 1.0 : 0.0;
+		radius += (u_radiusScale/radius);
+	}
+
+	return vec3(tapsExecuted, tapsContributing, wasted);
+}
+
+void main()
+{
+	// level texel covering this full res pixel, as the gather of that level sees it
+	vec2 levelSize = u_tapCountLevelSize;
+	vec2 texCoord = (floor(v_texcoord0.xy * levelSize) + 0.5) / levelSize;
+
+	vec3 counts = vec3_splat(0.0);
+#if TAP_COUNT_MIXED
+	float tileBlurSize = MixedTileBlurSize(s_tiles, texCoord);
+	if (MixedLevelActive(tileBlurSize) )
+	{
+		counts = TapCountsRadius(texCoord, levelSize, MixedLoopEnd(tileBlurSize) );
+	}
+#else
+	counts = TapCountsRadius(texCoord, levelSize, u_maxBlurSize);
+#endif
+
+	gl_FragColor = vec4(counts * u_tapCountShare, 1.0);
+}
+
+#endif // BOKEH_TAP_COUNT_SH
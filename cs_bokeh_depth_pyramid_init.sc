@@ -0,0 +1,29 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+#include "bokeh_depth_pyramid.sh"
+
+// level 0 of the depth pyramid, one texel per rendered depth texel. point sampled,
+// source offset moves to the rendered part when origin is bottom left
+
+SAMPLER2D(s_depth, 0);
+IMAGE2D_WR(s_output, rg32f, 1);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x >= int(u_outputSize.x) || coord.y >= int(u_outputSize.y))
+	{
+		return;
+	}
+
+	vec2 texCoord = (vec2(coord) + u_sourceOffset + 0.5) * u_depthTexelSize;
+	float depth = texture2DLod(s_depth, texCoord, 0).x;
+	float linearDepth = ScreenSpaceToViewSpaceDepth(depth);
+	imageStore(s_output, coord, vec4(linearDepth, linearDepth, 0.0, 0.0));
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "bokeh_depth_pyramid.sh"
+
+// next level of the depth pyramid. each output texel covers every source texel it
+// overlaps, up to 3x3 where the source size is odd, so nothing is skipped. must
+// match reduceDepthBounds() in bokeh.cpp, which verifies it.
+
+IMAGE2D_RO(s_input, rg32f, 0);
+IMAGE2D_WR(s_output, rg32f, 1);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 sourceSize = ivec2(u_sourceSize);
+	ivec2 outputSize = ivec2(u_outputSize);
+	if (coord.x >= outputSize.x || coord.y >= outputSize.y)
+	{
+		return;
+	}
+
+	ivec2 begin = (coord * sourceSize) / outputSize;
+	ivec2 end = ((coord + 1) * sourceSize + outputSize - 1) / outputSize;
+
+	vec2 bounds = vec2(3.4e38, 0.0);
+	for (int yy = 0; yy < 3; ++yy)
+	{
+		for (int xx = 0; xx < 3; ++xx)
+		{
+			ivec2 source = begin + ivec2(xx, yy);
+			if (source.x < end.x && source.y < end.y)
+			{
+				vec2 value = imageLoad(s_input, source).xy;
+				bounds.x = min(bounds.x, value.x);
+				bounds.y = max(bounds.y, value.y);
+			}
+		}
+	}
+
+	imageStore(s_output, coord, vec4(bounds, 0.0, 0.0));
+}
@@ -0,0 +1,117 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+
+#define USE_PACKED_COLOR_AND_BLUR	1
+#include "bokeh_dof.sh"
+
+// compute version of fs_bokeh_dof_second_pass.sc. neighbouring pixels share almost
+// all of their spiral taps, so each workgroup loads its tile plus a halo of color and
+// blur size into groupshared memory once, and gathers from there. taps that land
+// outside of the cached region fall back to regular texture fetches.
+
+// halo covers half res blur up to 17 texels plus the bilinear footprint, larger blur
+// sizes fetch their outer taps from the texture
+#define TILE_SIZE	8
+#define HALO_SIZE	18
+#define CACHE_SIZE	(TILE_SIZE + 2*HALO_SIZE)
+
+SAMPLER2D(s_color, 0);
+IMAGE2D_WR(s_output, rgba16f, 1);
+
+// 44x44 texels of rgba16f data packed as half pairs, about 15KB
+SHARED uvec2 s_cache[CACHE_SIZE*CACHE_SIZE];
+
+vec4 LoadCached (ivec2 cacheCoord)
+{
+	uvec2 packed = s_cache[cacheCoord.y*CACHE_SIZE + cacheCoord.x];
+	return vec4(unpackHalf2x16(packed.x), unpackHalf2x16(packed.y) );
+}
+
+void StoreCached (ivec2 cacheCoord, vec4 value)
+{
+	s_cache[cacheCoord.y*CACHE_SIZE + cacheCoord.x] = uvec2(packHalf2x16(value.xy), packHalf2x16(value.zw) );
+}
+
+// bilinear filtered color and blur size at texel space position, matches what
+// texture2DLod returns for the same position in the fragment shader version
+void SampleColorAndBlurSize (
+	vec2 texelPosition,
+	ivec2 cacheOrigin,
+	int cacheMin,
+	int cacheMax,
+	vec2 texelSize,
+	out vec3 outColor,
+	out float outBlurSize
+) {
+	vec2 basePosition = texelPosition - 0.5;
+	vec2 base = floor(basePosition);
+	vec2 weight = basePosition - base;
+	ivec2 cacheCoord = ivec2(base) - cacheOrigin;
+
+	vec4 colorAndBlurSize;
+	if (cacheMin <= cacheCoord.x && cacheCoord.x < cacheMax
+	&&  cacheMin <= cacheCoord.y && cacheCoord.y < cacheMax)
+	{
+		vec4 c00 = LoadCached(cacheCoord);
+		vec4 c10 = LoadCached(cacheCoord + ivec2(1, 0));
+		vec4 c01 = LoadCached(cacheCoord + ivec2(0, 1));
+		vec4 c11 = LoadCached(cacheCoord + ivec2(1, 1));
+		colorAndBlurSize = mix(mix(c00, c10, weight.x), mix(c01, c11, weight.x), weight.y);
+	}
+	else
+	{
+		colorAndBlurSize = texture2DLod(s_color, texelPosition * texelSize, 0);
+	}
+
+	outColor = colorAndBlurSize.xyz;
+	outBlurSize = colorAndBlurSize.w;
+}
+
+// SPIRAL_GATHER fetch, the spiral is in texel units here
+#define CACHED_FETCH(_offset, _outColor, _outBlurSize) \
+	SampleColorAndBlurSize(pixelCoord + (_offset), cacheOrigin, cacheMin, cacheMax, texelSize, _outColor, _outBlurSize)
+
+NUM_THREADS(TILE_SIZE, TILE_SIZE, 1)
+void main()
+{
+	ivec2 outputSize = imageSize(s_output);
+	vec2 texelSize = vec2_splat(1.0) / vec2(outputSize);
+
+	// only load as much halo as the largest blur can reach, up to what fits
+	int loadHalo = min(int(ceil(u_maxBlurSize)) + 1, HALO_SIZE);
+	int loadSize = TILE_SIZE + 2*loadHalo;
+
+	ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * TILE_SIZE;
+	ivec2 cacheOrigin = tileOrigin - ivec2(HALO_SIZE, HALO_SIZE);
+	int cacheMin = HALO_SIZE - loadHalo;
+	// bilinear footprint reads one texel past the base
+	int cacheMax = cacheMin + loadSize - 1;
+
+	for (int ii = int(gl_LocalInvocationIndex); ii < loadSize*loadSize; ii += TILE_SIZE*TILE_SIZE)
+	{
+		ivec2 loadOffset = ivec2(ii - (ii / loadSize) * loadSize, ii / loadSize);
+		ivec2 cacheCoord = loadOffset + ivec2(cacheMin, cacheMin);
+
+		// clamp sampler takes care of texels outside of the image
+		vec2 texCoord = (vec2(cacheOrigin + cacheCoord) + 0.5) * texelSize;
+		StoreCached(cacheCoord, texture2DLod(s_color, texCoord, 0) );
+	}
+
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	vec2 pixelCoord = vec2(pixel) + 0.5;
+
+	// same spiral and noise as DepthOfField() in bokeh_dof.sh
+	SPIRAL_GATHER(CACHED_FETCH, pixelCoord, u_maxBlurSize);
+
+	if (pixel.x < outputSize.x && pixel.y < outputSize.y)
+	{
+		imageStore(s_output, pixel, vec4(color, averageSampleSize));
+	}
+}
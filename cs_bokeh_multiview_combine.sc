@@ -0,0 +1,42 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "../common/shaderlib.sh"
+#include "parameters.sh"
+#include "bokeh_multiview.sh"
+
+// layered version of fs_bokeh_dof_combine.sc, layers are always rendered at full scale
+
+SAMPLER2DARRAY(s_color,			0);
+SAMPLER2DARRAY(s_blurredColor,	1);
+IMAGE2D_ARRAY_WR(s_output, rgba8, 2);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec3 outputSize = imageSize(s_output);
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x >= outputSize.x || coord.y >= outputSize.y)
+	{
+		return;
+	}
+
+	int layer = int(u_firstLayer) + int(gl_GlobalInvocationID.z);
+	vec3 texCoord = vec3((vec2(coord) + 0.5) / vec2(outputSize.xy), float(layer));
+
+	vec3 color = texture2DArrayLod(s_color, texCoord, 0).xyz;
+	vec4 dofColorSize = texture2DArrayLod(s_blurredColor, texCoord, 0);
+	vec3 dofColor = dofColorSize.xyz;
+	float sampleSize = dofColorSize.w;
+
+	float m = saturate(sampleSize-1.0);
+	color = mix(color, dofColor, m);
+
+	// output is displayed directly
+	color = toGamma(color);
+
+	imageStore(s_output, ivec3(coord, layer), vec4(color, 1.0));
+}
@@ -0,0 +1,36 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_multiview.sh"
+
+// layered version of fs_bokeh_dof_downsample.sc, focus comes from each layer's camera
+
+SAMPLER2DARRAY(s_color, 0);
+SAMPLER2DARRAY(s_depth, 1);
+IMAGE2D_ARRAY_WR(s_output, rgba16f, 2);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec3 outputSize = imageSize(s_output);
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x >= outputSize.x || coord.y >= outputSize.y)
+	{
+		return;
+	}
+
+	int layer = int(u_firstLayer) + int(gl_GlobalInvocationID.z);
+	// half res texel center sits between 4 full res texels, bilinear averages them
+	vec3 texCoord = vec3((vec2(coord) + 0.5) / vec2(outputSize.xy), float(layer));
+
+	vec3 color = texture2DArrayLod(s_color, texCoord, 0).xyz;
+	float depth = texture2DArrayLod(s_depth, texCoord, 0).x;
+	float blurSize = GetBlurSize(depth, LayerFocusPoint(layer), LayerFocusScale(layer));
+
+	imageStore(s_output, ivec3(coord, layer), vec4(color, blurSize));
+}
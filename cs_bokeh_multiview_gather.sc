@@ -0,0 +1,50 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_multiview.sh"
+
+// layered version of fs_bokeh_dof_second_pass.sc. same spiral gather as DepthOfField
+// in bokeh_dof.sh, reading color and blur size packed in each layer of the array.
+
+SAMPLER2DARRAY(s_color, 0);
+IMAGE2D_ARRAY_WR(s_output, rgba16f, 1);
+
+void GetLayerColorAndBlurSize (vec2 texCoord, float layer, out vec3 outColor, out float outBlurSize)
+{
+	vec4 colorAndBlurSize = texture2DArrayLod(s_color, vec3(texCoord, layer), 0);
+	outColor = colorAndBlurSize.xyz;
+	outBlurSize = colorAndBlurSize.w;
+}
+
+// SPIRAL_GATHER fetch, from the layer being gathered
+#define LAYER_FETCH(_offset, _outColor, _outBlurSize) \
+	GetLayerColorAndBlurSize(texCoord + (_offset) * texelSize, layer, _outColor, _outBlurSize)
+
+vec4 DepthOfFieldLayer (vec2 texCoord, float layer, vec2 texelSize, vec2 pixelCoord)
+{
+	SPIRAL_GATHER(LAYER_FETCH, pixelCoord, u_maxBlurSize);
+	return vec4(color, averageSampleSize);
+}
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec3 outputSize = imageSize(s_output);
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x >= outputSize.x || coord.y >= outputSize.y)
+	{
+		return;
+	}
+
+	int layer = int(u_firstLayer) + int(gl_GlobalInvocationID.z);
+	vec2 texelSize = vec2_splat(1.0) / vec2(outputSize.xy);
+	vec2 texCoord = (vec2(coord) + 0.5) * texelSize;
+
+	vec4 result = DepthOfFieldLayer(texCoord, float(layer), texelSize, vec2(coord));
+	imageStore(s_output, ivec3(coord, layer), result);
+}
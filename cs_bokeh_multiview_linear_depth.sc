@@ -0,0 +1,31 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+#include "bokeh_multiview.sh"
+
+// layered version of fs_bokeh_linear_depth.sc
+
+SAMPLER2DARRAY(s_depth, 0);
+IMAGE2D_ARRAY_WR(s_output, r32f, 1);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec3 outputSize = imageSize(s_output);
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x >= outputSize.x || coord.y >= outputSize.y)
+	{
+		return;
+	}
+
+	int layer = int(u_firstLayer) + int(gl_GlobalInvocationID.z);
+	vec2 texCoord = (vec2(coord) + 0.5) / vec2(outputSize.xy);
+
+	float depth = texture2DArrayLod(s_depth, vec3(texCoord, float(layer)), 0).x;
+	float linearDepth = ScreenSpaceToViewSpaceDepth(depth);
+	imageStore(s_output, ivec3(coord, layer), vec4_splat(linearDepth));
+}
@@ -0,0 +1,76 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_autofocus.sh"
+
+SAMPLER2D(s_depth, 0);
+
+// weight of a pixel at scene uv, texture space when origin is bottom left
+float AutofocusWeight (vec2 uv)
+{
+	float weight = 0.0;
+
+	if (u_autofocusMode < 1.5)
+	{
+		// weighted center, falls off with distance from center of region
+		vec2 offset = (uv - u_regionCenter) / u_regionExtent;
+		if (abs(offset.x) <= 1.0 && abs(offset.y) <= 1.0)
+		{
+			weight = exp(-u_regionFalloff * dot(offset, offset));
+		}
+	}
+	else
+	{
+		// points of interest, weight is spread over the area so each point's
+		// average counts by its own weight whatever its size
+		for (int ii = 0; ii < AUTOFOCUS_MAX_POINTS; ++ii)
+		{
+			vec4 point = u_autofocusParams[3 + ii];
+			vec2 offset = abs(uv - point.xy);
+			if (float(ii) < u_pointCount
+			&&  offset.x <= point.z
+			&&  offset.y <= point.z)
+			{
+				weight += point.w / max(4.0 * point.z * point.z, 0.0001);
+			}
+		}
+	}
+
+	return weight;
+}
+
+// circle of confusion is linear in 1/depth, so average inverse depth. first pass
+// of the reduction, every texel of the rendered part of linear depth is weighted
+// and summed in blocks. texels outside it hold a previous frame, they add nothing.
+void main()
+{
+	vec2 blockBase = AutofocusBlockBase(v_texcoord0.xy);
+
+	vec2 total = vec2_splat(0.0);
+	for (int yy = 0; yy < AUTOFOCUS_REDUCE_BLOCK; ++yy)
+	{
+		for (int xx = 0; xx < AUTOFOCUS_REDUCE_BLOCK; ++xx)
+		{
+			vec2 texel = blockBase + vec2(float(xx), float(yy));
+			vec2 uv = (texel + 0.5) / u_reduceSourceSize;
+			vec2 sceneUv = (uv - u_sceneUvOffset) / u_sceneUvScale;
+			if (texel.x < u_reduceSourceSize.x
+			&&  texel.y < u_reduceSourceSize.y
+			&&  sceneUv.x >= 0.0 && sceneUv.x <= 1.0
+			&&  sceneUv.y >= 0.0 && sceneUv.y <= 1.0)
+			{
+				float weight = AutofocusWeight(sceneUv);
+				float depth = texture2DLod(s_depth, uv, 0).x;
+				total += weight * vec2(1.0 / max(depth, 0.001), 1.0);
+			}
+		}
+	}
+
+	gl_FragColor = vec4(total, 0.0, 0.0);
+}
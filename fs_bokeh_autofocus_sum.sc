@@ -0,0 +1,34 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "bokeh_autofocus.sh"
+
+// partial sums of the previous reduction pass
+SAMPLER2D(s_depth, 0);
+
+// sum of a block of source texels, those past the edge of the source add nothing
+void main()
+{
+	vec2 blockBase = AutofocusBlockBase(v_texcoord0.xy);
+
+	vec2 total = vec2_splat(0.0);
+	for (int yy = 0; yy < AUTOFOCUS_REDUCE_BLOCK; ++yy)
+	{
+		for (int xx = 0; xx < AUTOFOCUS_REDUCE_BLOCK; ++xx)
+		{
+			vec2 texel = blockBase + vec2(float(xx), float(yy));
+			if (texel.x < u_reduceSourceSize.x
+			&&  texel.y < u_reduceSourceSize.y)
+			{
+				total += texture2DLod(s_depth, (texel + 0.5) / u_reduceSourceSize, 0).xy;
+			}
+		}
+	}
+
+	gl_FragColor = vec4(total, 0.0, 0.0);
+}
@@ -0,0 +1,12 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// blurred layer with sample size in its own target over scene color, see bokeh_tail.sh
+#define TAIL_COMBINE			1
+#define TAIL_SPLIT_BLUR_SIZE	1
+#define TAIL_LINEAR_TO_GAMMA	1
+#include "bokeh_tail.sh"
@@ -16,9 +16,5 @@ void main()
 {
 	vec2 texCoord = v_texcoord0.xy;
 
-	vec3 color = texture2D(s_color, texCoord).xyz;
-	float depth = texture2D(s_depth, texCoord).x;
-	float blurSize = GetBlurSize(depth, u_focusPoint, u_focusScale);
-
-	gl_FragColor = vec4(color, blurSize);
+	gl_FragColor = DownsampleColorAndBlurSize(s_color, s_depth, texCoord, u_focusPoint, u_focusScale);
 }
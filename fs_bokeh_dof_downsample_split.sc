@@ -0,0 +1,24 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+
+SAMPLER2D(s_color, 0);
+SAMPLER2D(s_depth, 1);
+
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+
+	vec4 colorAndBlurSize = DownsampleColorAndBlurSize(s_color, s_depth, texCoord, u_focusPoint, u_focusScale);
+
+	// color target has no alpha, write blur size to its own target
+	gl_FragData[0] = vec4(colorAndBlurSize.xyz, 1.0);
+	gl_FragData[1] = vec4_splat(EncodeBlurSize(colorAndBlurSize.w));
+}
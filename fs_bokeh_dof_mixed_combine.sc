@@ -0,0 +1,50 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_mixed.sh"
+
+SAMPLER2D(s_color,			0);
+SAMPLER2D(s_depth,			1);
+SAMPLER2D(s_tiles,			2);
+SAMPLER2D(s_fullBlur,		3);
+SAMPLER2D(s_blurredColor,	4);
+SAMPLER2D(s_quarterBlur,	5);
+
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+	vec3 color = UpscaleSceneColor(s_color, s_depth, texCoord);
+
+	float tileBlurSize = MixedTileBlurSize(s_tiles, texCoord);
+	vec3 weights = MixedLevelWeights(tileBlurSize);
+
+	// full res gather already includes the sharp center, use as is
+	vec3 fullColor = color;
+	if (weights.x > 0.0)
+	{
+		fullColor = texture2D(s_fullBlur, texCoord).xyz;
+	}
+
+	// lower res gathers composite over scene color like the multi pass combine
+	vec3 lowerColor = color;
+	float lowerWeight = weights.y + weights.z;
+	if (lowerWeight > 0.0)
+	{
+		vec4 lower = (texture2D(s_blurredColor, texCoord) * weights.y
+			+ texture2D(s_quarterBlur, texCoord) * weights.z) / lowerWeight;
+		float m = saturate(0.5*lower.w - 1.0);
+		lowerColor = mix(color, lower.xyz, m);
+	}
+
+	color = fullColor * weights.x + lowerColor * lowerWeight;
+
+	// this pass is writing directly out to backbuffer, convert from linear to gamma
+	gl_FragColor = vec4(toGamma(color), 1.0);
+}
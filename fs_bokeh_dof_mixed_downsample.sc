@@ -0,0 +1,55 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+
+SAMPLER2D(s_color, 0);
+
+// quarter res from the packed half res downsample instead of one tap into full res,
+// which skipped three quarters of the pixels. the 2x2 half res texels under a quarter
+// texel cover its whole 4x4 footprint. blur sizes, in half res pixels, are averaged.
+// a near field average takes the nearest of them like the half res downsample does,
+// and color leans toward texels whose blur size matches the result so neither side of
+// a near field edge picks up color of the other.
+void main()
+{
+	// half res texel centers sit a quarter of a quarter res texel from its center
+	vec2 offset = 0.25 * u_viewTexel.xy;
+
+	vec4 samples[4];
+	samples[0] = texture2D(s_color, v_texcoord0.xy + vec2(-offset.x, -offset.y));
+	samples[1] = texture2D(s_color, v_texcoord0.xy + vec2( offset.x, -offset.y));
+	samples[2] = texture2D(s_color, v_texcoord0.xy + vec2(-offset.x,  offset.y));
+	samples[3] = texture2D(s_color, v_texcoord0.xy + vec2( offset.x,  offset.y));
+
+	float blurSize = 0.0;
+	float nearMax = 0.0;
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		blurSize += 0.25 * samples[ii].w;
+		nearMax = max(nearMax, -samples[ii].w);
+	}
+
+	if (-blurSize >= DOWNSAMPLE_NEAR_DILATE_MIN)
+	{
+		blurSize = min(blurSize, -nearMax);
+	}
+
+	vec3 color = vec3_splat(0.0);
+	float totalWeight = 0.0;
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		float weight = 1.0 / (1.0 + abs(samples[ii].w - blurSize));
+		color += samples[ii].xyz * weight;
+		totalWeight += weight;
+	}
+
+	// blur size from half res to quarter res pixels
+	gl_FragColor = vec4(color / totalWeight, blurSize * 0.5);
+}
@@ -0,0 +1,31 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_dof.sh"
+#include "bokeh_mixed.sh"
+
+SAMPLER2D(s_color,			0);
+SAMPLER2D(s_depth,			1);
+SAMPLER2D(s_tiles,			2);
+
+// full res gather for tiles with small blur, spiral ends at the tile max
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+	float tileBlurSize = MixedTileBlurSize(s_tiles, texCoord);
+
+	vec4 outColor = vec4_splat(0.0);
+	if (MixedLevelActive(tileBlurSize) )
+	{
+		outColor = DepthOfFieldRadius(s_color, s_depth, texCoord, u_focusPoint, u_focusScale, MixedLoopEnd(tileBlurSize) );
+		outColor.w /= u_levelScale;
+	}
+
+	gl_FragColor = outColor;
+}
@@ -0,0 +1,33 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+
+#define USE_PACKED_COLOR_AND_BLUR	1
+#include "bokeh_dof.sh"
+#include "bokeh_mixed.sh"
+
+SAMPLER2D(s_color,			0);
+SAMPLER2D(s_tiles,			1);
+
+// half or quarter res gather, kernel scaled with the level. writes average sample
+// size in full res pixels so combine can mix levels directly
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+	float tileBlurSize = MixedTileBlurSize(s_tiles, texCoord);
+
+	vec4 outColor = vec4_splat(0.0);
+	if (MixedLevelActive(tileBlurSize) )
+	{
+		outColor = DepthOfFieldRadius(s_color, s_color, texCoord, u_focusPoint, u_focusScale, MixedLoopEnd(tileBlurSize) );
+		outColor.w /= u_levelScale;
+	}
+
+	gl_FragColor = outColor;
+}
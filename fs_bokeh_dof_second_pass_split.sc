@@ -0,0 +1,27 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+
+#define USE_SPLIT_COLOR_AND_BLUR	1
+#include "bokeh_dof.sh"
+
+SAMPLER2D(s_color,			0);
+SAMPLER2D(s_blurSize,		1);
+
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+
+	vec4 outColor = DepthOfField(s_color, s_blurSize, texCoord, u_focusPoint, u_focusScale);
+
+	// this pass isn't writing final output, leave in linear space for combining with scene color
+
+	gl_FragData[0] = vec4(outColor.xyz, 1.0);
+	gl_FragData[1] = vec4_splat(EncodeSampleSize(outColor.w));
+}
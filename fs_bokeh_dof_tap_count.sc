@@ -0,0 +1,9 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// taps of the full res single pass gather, see bokeh_tap_count.sh
+#include "bokeh_tap_count.sh"
@@ -0,0 +1,10 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// taps of the half res multi pass gather, see bokeh_tap_count.sh
+#define USE_PACKED_COLOR_AND_BLUR	1
+#include "bokeh_tap_count.sh"
@@ -0,0 +1,10 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// taps of the mixed resolution full res level, see bokeh_tap_count.sh
+#define TAP_COUNT_MIXED				1
+#include "bokeh_tap_count.sh"
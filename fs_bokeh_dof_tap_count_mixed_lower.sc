@@ -0,0 +1,11 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// taps of a mixed resolution half or quarter res level, see bokeh_tap_count.sh
+#define USE_PACKED_COLOR_AND_BLUR	1
+#define TAP_COUNT_MIXED				1
+#include "bokeh_tap_count.sh"
@@ -0,0 +1,33 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "bokeh_debug.sh"
+
+SAMPLER2D(s_tapCounts, 0);
+
+// sum of a block of source texels, those past the edge of the source add nothing
+void main()
+{
+	vec2 blockBase = floor(v_texcoord0.xy * u_reduceOutputSize) * float(TAP_COUNT_REDUCE_BLOCK);
+
+	vec4 total = vec4_splat(0.0);
+	for (int yy = 0; yy < TAP_COUNT_REDUCE_BLOCK; ++yy)
+	{
+		for (int xx = 0; xx < TAP_COUNT_REDUCE_BLOCK; ++xx)
+		{
+			vec2 texel = blockBase + vec2(float(xx), float(yy));
+			if (texel.x < u_reduceSourceSize.x
+			&&  texel.y < u_reduceSourceSize.y)
+			{
+				total += texture2DLod(s_tapCounts, (texel + 0.5) / u_reduceSourceSize, 0);
+			}
+		}
+	}
+
+	gl_FragColor = total;
+}
@@ -0,0 +1,35 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_mixed.sh"
+
+SAMPLER2D(s_tiles, 0);
+
+// spread each tile max over neighbours within max blur size, a large blur in one
+// tile gathers into pixels of the next tile over
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+
+	float maxBlurSize = 0.0;
+	for (int yy = -MIXED_MAX_DILATE_RADIUS; yy <= MIXED_MAX_DILATE_RADIUS; ++yy)
+	{
+		for (int xx = -MIXED_MAX_DILATE_RADIUS; xx <= MIXED_MAX_DILATE_RADIUS; ++xx)
+		{
+			vec2 offset = vec2(float(xx), float(yy) );
+			if (max(abs(offset.x), abs(offset.y) ) <= u_tileDilateRadius)
+			{
+				vec2 tileCoord = texCoord + offset * u_viewTexel.xy;
+				maxBlurSize = max(maxBlurSize, texture2DLod(s_tiles, tileCoord, 0).x);
+			}
+		}
+	}
+
+	gl_FragColor = vec4(maxBlurSize, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,32 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "bokeh_mixed.sh"
+
+SAMPLER2D(s_color, 0);
+
+// largest absolute blur size per tile, read from alpha of the half res downsample
+void main()
+{
+	vec2 texCoord = v_texcoord0.xy;
+	vec2 tileBase = floor(texCoord * u_viewRect.zw) * float(MIXED_TILE_SIZE/2);
+
+	float maxBlurSize = 0.0;
+	for (int yy = 0; yy < MIXED_TILE_SIZE/2; ++yy)
+	{
+		for (int xx = 0; xx < MIXED_TILE_SIZE/2; ++xx)
+		{
+			vec2 sourceCoord = (tileBase + vec2(float(xx), float(yy)) + 0.5) * u_tileSourceTexel;
+			maxBlurSize = max(maxBlurSize, abs(texture2DLod(s_color, sourceCoord, 0).w) );
+		}
+	}
+
+	// downsample wrote half res pixels
+	gl_FragColor = vec4(maxBlurSize / u_levelScale, 0.0, 0.0, 1.0);
+}
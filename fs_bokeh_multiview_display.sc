@@ -0,0 +1,28 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "bokeh_multiview.sh"
+
+SAMPLER2DARRAY(s_color, 0);
+
+void main()
+{
+	// lay out layers in a grid, one camera per cell
+	vec2 grid = vec2(u_gridColumns, u_gridRows);
+	vec2 gridCoord = v_texcoord0 * grid;
+	vec2 cell = min(floor(gridCoord), grid - 1.0);
+	float layer = cell.y * grid.x + cell.x;
+
+	if (layer >= u_layerCount)
+	{
+		gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	gl_FragColor = texture2DArray(s_color, vec3(gridCoord - cell, layer) );
+}
@@ -7,7 +7,7 @@
 #define PARAMETERS_SH
 
 // struct PassUniforms
-uniform vec4 u_params[4];
+uniform vec4 u_params[6];
 
 #define u_depthUnpackConsts			(u_params[0].xy)
 #define u_frameIdx					(u_params[0].z)
@@ -25,4 +25,36 @@ uniform vec4 u_params[4];
 #define u_focusScale				(u_params[3].z)
 #define u_radiusScale				(u_params[3].w)
 
+#define u_sceneUvScale				(u_params[4].xy)
+#define u_sceneUvOffset				(u_params[4].zw)
+#define u_sceneTexelSize			(u_params[5].xy)
+#define u_renderScale				(u_params[5].z)
+
+// scene color and linear depth are rendered into part of a max sized target when
+// using dynamic resolution. map full screen uv to that part, staying half a texel
+// inside so bilinear filtering never reads outside of what was rendered this frame.
+vec2 SceneUv (vec2 uv)
+{
+	vec2 halfTexel = 0.5 * u_sceneTexelSize;
+	return clamp(uv * u_sceneUvScale + u_sceneUvOffset
+		, u_sceneUvOffset + halfTexel
+		, u_sceneUvOffset + u_sceneUvScale - halfTexel
+		);
+}
+
+// from assao sample, cs_assao_prepare_depths.sc
+float ScreenSpaceToViewSpaceDepth( float screenDepth )
+{
+	float depthLinearizeMul = u_depthUnpackConsts.x;
+	float depthLinearizeAdd = u_depthUnpackConsts.y;
+
+	// Optimised version of "-cameraClipNear / (cameraClipFar - projDepth * (cameraClipFar - cameraClipNear)) * cameraClipFar"
+
+	// Set your depthLinearizeMul and depthLinearizeAdd to:
+	// depthLinearizeMul = ( cameraClipFar * cameraClipNear) / ( cameraClipFar - cameraClipNear );
+	// depthLinearizeAdd = cameraClipFar / ( cameraClipFar - cameraClipNear );
+
+	return depthLinearizeMul / ( depthLinearizeAdd - screenDepth );
+}
+
 #endif // PARAMETERS_SH
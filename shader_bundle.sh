@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Copyright 2021 elven cache. All rights reserved.
+# License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+#
+# Pack compiled bokeh shaders of one renderer into a single indexed bundle,
+# read by ShaderBundle in bokeh.cpp. Layout, all integers little endian:
+#
+#   header  'BKSB', version, entry count, reserved     (4 x uint32)
+#   entries name[56], offset, size                     (64 bytes each)
+#   data    shader binaries, each followed by at least one zero byte and
+#           padded to 16 byte alignment
+#
+# usage: shader_bundle.sh <shader dir> <bundle file>
+
+set -e
+
+SHADER_DIR=$1
+BUNDLE_FILE=$2
+NAME_SIZE=56
+
+if [ -z "$SHADER_DIR" ] || [ -z "$BUNDLE_FILE" ]; then
+	echo "usage: $0 <shader dir> <bundle file>" >&2
+	exit 1
+fi
+
+u32le()
+{
+	printf "$(printf '\\%03o\\%03o\\%03o\\%03o' \
+		$(( $1 & 255 )) \
+		$(( ($1 >> 8) & 255 )) \
+		$(( ($1 >> 16) & 255 )) \
+		$(( ($1 >> 24) & 255 )) )"
+}
+
+zeros()
+{
+	if [ "$1" -gt 0 ]; then
+		head -c "$1" /dev/zero
+	fi
+}
+
+SHADERS=$(ls "$SHADER_DIR"/*_bokeh_*.bin 2>/dev/null || true)
+if [ -z "$SHADERS" ]; then
+	echo "$0: no compiled bokeh shaders in $SHADER_DIR" >&2
+	exit 1
+fi
+
+COUNT=$(echo "$SHADERS" | wc -l)
+OFFSET=$(( 16 + 64 * COUNT ))
+TMP_FILE="$BUNDLE_FILE.tmp"
+
+{
+	printf 'BKSB'
+	u32le 1
+	u32le "$COUNT"
+	u32le 0
+
+	for SHADER in $SHADERS; do
+		NAME=$(basename "$SHADER" .bin)
+		if [ ${#NAME} -ge $NAME_SIZE ]; then
+			echo "$0: shader name too long: $NAME" >&2
+			exit 1
+		fi
+		SIZE=$(wc -c < "$SHADER")
+		printf '%s' "$NAME"
+		zeros $(( NAME_SIZE - ${#NAME} ))
+		u32le "$OFFSET"
+		u32le "$SIZE"
+		OFFSET=$(( OFFSET + SIZE + 16 - SIZE % 16 ))
+	done
+
+	for SHADER in $SHADERS; do
+		SIZE=$(wc -c < "$SHADER")
+		cat "$SHADER"
+		zeros $(( 16 - SIZE % 16 ))
+	done
+} > "$TMP_FILE"
+
+mv "$TMP_FILE" "$BUNDLE_FILE"
+echo "$BUNDLE_FILE: $COUNT shaders"
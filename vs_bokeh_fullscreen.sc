@@ -0,0 +1,29 @@
+$output v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+
+// one triangle over the whole view from the vertex id, drawn without a vertex
+// buffer, see setScreenTriangle
+void main()
+{
+	// corners (0,0), (2,0) and (0,2) cover the unit square
+	float vertexId = float(gl_VertexID);
+	vec2 corner = vec2(
+		  (vertexId == 1.0) ? 2.0 : 0.0
+		, (vertexId == 2.0) ? 2.0 : 0.0
+		);
+
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+
+#if BGFX_SHADER_LANGUAGE_GLSL
+	// texture origin is bottom left, same as clip space
+	v_texcoord0 = corner;
+#else
+	v_texcoord0 = vec2(corner.x, 1.0 - corner.y);
+#endif
+}